@@ -0,0 +1,167 @@
+#include "AnimationTimeline.h"
+#include "Easing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+
+static inline float Phase(const float& time, const float& offset, const float& duration)
+{
+    return (time - offset) / duration;
+}
+
+
+void AnimationTimeline::Build(const AnimationKeys& keys, const uint32_t& fps, const uint32_t& frameCount)
+{
+    m_FrameCount = frameCount;
+    m_FPS = fps;
+
+    const size_t n = frameCount;
+    m_Time.resize(n);
+    m_WindowX.assign(n, keys.midSizeX);
+    m_WindowY.assign(n, keys.midSizeY);
+    m_WindowScale.assign(n, 1.0f);
+    m_HeaderScale.assign(n, 1.0f);
+    m_HeaderOpacity.assign(n, 1.0f);
+    m_PrevHeaderScale.assign(n, 0.0f);
+    m_PrevHeaderOpacity.assign(n, 0.0f);
+    m_CodeProgress.resize(n);
+
+    for (size_t i = 0; i < n; ++i)
+        m_Time[i] = static_cast<float>(i + 1) / static_cast<float>(fps);
+
+    // The window opens while t <= 0.5 and closes from duration - 0.5 on; both are contiguous
+    // ranges of frames, and the opening wins where they overlap.
+    const size_t openEnd = std::upper_bound(m_Time.begin(), m_Time.end(), 0.5f) - m_Time.begin();
+    const size_t closeBegin = std::max(openEnd,
+        (size_t)(std::lower_bound(m_Time.begin(), m_Time.end(), keys.duration - 0.5f) - m_Time.begin()));
+    const size_t closeCount = n - closeBegin;
+
+    std::vector<float> ease(n);
+    for (size_t i = 0; i < openEnd; ++i)
+        ease[i] = Phase(m_Time[i], 0, 0.5f);
+    for (size_t i = closeBegin; i < n; ++i)
+        ease[i] = Phase(m_Time[i], keys.duration - 0.5f, 0.5f);
+
+    EaseOutAEDoubleBack(ease.data(), ease.data(), openEnd);
+    EaseInAEDoubleBack(ease.data() + closeBegin, ease.data() + closeBegin, closeCount);
+
+    Lerp(keys.startSizeX, keys.midSizeX, ease.data(), m_WindowX.data(), openEnd);
+    Lerp(keys.startSizeY, keys.midSizeY, ease.data(), m_WindowY.data(), openEnd);
+    Lerp(keys.startScale, 1.0f, ease.data(), m_WindowScale.data(), openEnd);
+
+    Lerp(keys.midSizeX, keys.endSizeX, ease.data() + closeBegin, m_WindowX.data() + closeBegin, closeCount);
+    Lerp(keys.midSizeY, keys.endSizeY, ease.data() + closeBegin, m_WindowY.data() + closeBegin, closeCount);
+    Lerp(1.0f, keys.endScale, ease.data() + closeBegin, m_WindowScale.data() + closeBegin, closeCount);
+
+    // A new header grows in over the old one during the first half second.
+    if (keys.bHeaderChanged)
+    {
+        for (size_t i = 0; i < n; ++i)
+            ease[i] = std::min(Phase(m_Time[i], 0, 0.5f), 1.0f);
+        EaseInOutSine(ease.data(), ease.data(), n);
+
+        Lerp(1.0f, 0.0f, ease.data(), m_PrevHeaderScale.data(), n);
+        Lerp(0.0f, 1.0f, ease.data(), m_HeaderScale.data(), n);
+        Lerp(1.0f, 0.0f, ease.data(), m_PrevHeaderOpacity.data(), n);
+        Lerp(0.0f, 1.0f, ease.data(), m_HeaderOpacity.data(), n);
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const float time = m_Time[i];
+        if (time <= 0.5f || time >= keys.duration - 0.5f)
+            m_CodeProgress[i] = 0;
+        else if (time >= 0.5f && time <= keys.codeDuration + 0.5f)
+            m_CodeProgress[i] = EaseInOutSine(Phase(time, 0.5f, keys.codeDuration));
+        else if (time >= keys.duration - 1.5f && time <= keys.duration - 0.5f)
+            m_CodeProgress[i] = 1 - EaseInOutSine(Phase(time, keys.duration - 1.5f, 1));
+        else
+            m_CodeProgress[i] = 1;
+    }
+
+    FindStaticSpans();
+}
+
+void AnimationTimeline::FindStaticSpans()
+{
+    // Time itself only feeds the shader's unused Time constant, so it does not count.
+    const size_t n = m_FrameCount;
+    m_Repeat.assign(n, 0);
+    m_StaticSpans.clear();
+    m_RepeatCount = 0;
+
+    for (size_t i = 1; i < n; ++i)
+    {
+        m_Repeat[i] = m_WindowX[i] == m_WindowX[i - 1]
+            && m_WindowY[i] == m_WindowY[i - 1]
+            && m_WindowScale[i] == m_WindowScale[i - 1]
+            && m_HeaderScale[i] == m_HeaderScale[i - 1]
+            && m_HeaderOpacity[i] == m_HeaderOpacity[i - 1]
+            && m_PrevHeaderScale[i] == m_PrevHeaderScale[i - 1]
+            && m_PrevHeaderOpacity[i] == m_PrevHeaderOpacity[i - 1]
+            && m_CodeProgress[i] == m_CodeProgress[i - 1];
+
+        if (!m_Repeat[i])
+            continue;
+
+        ++m_RepeatCount;
+        const uint32_t frame = (uint32_t)i + 1;
+        if (!m_StaticSpans.empty() && m_StaticSpans.back().last == frame - 1)
+            m_StaticSpans.back().last = frame;
+        else
+            m_StaticSpans.push_back(StaticSpan { frame - 1, frame });
+    }
+}
+
+void AnimationTimeline::Lerp(const float& a, const float& b, const float* t, float* out, const size_t& count)
+{
+    for (size_t i = 0; i < count; ++i)
+        out[i] = std::lerp(a, b, t[i]);
+}
+
+
+FrameState AnimationTimeline::GetFrame(const uint32_t& frame) const
+{
+    FrameState state {};
+    if (m_FrameCount == 0)
+        return state;
+
+    const size_t i = std::clamp(frame, 1u, m_FrameCount) - 1;
+    state.time                  = m_Time[i];
+    state.window.scale          = m_WindowScale[i];
+    state.window.sizeX          = m_WindowX[i];
+    state.window.sizeY          = m_WindowY[i];
+    state.headerScale           = m_HeaderScale[i];
+    state.headerOpacity         = m_HeaderOpacity[i];
+    state.prevHeaderScale       = m_PrevHeaderScale[i];
+    state.prevHeaderOpacity     = m_PrevHeaderOpacity[i];
+    state.codeProgress          = m_CodeProgress[i];
+    return state;
+}
+
+bool AnimationTimeline::Dump(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for the animation timeline\n";
+        return false;
+    }
+
+    file << "frame,time,windowX,windowY,windowScale,headerScale,headerOpacity,"
+        << "prevHeaderScale,prevHeaderOpacity,codeProgress,repeat\n";
+
+    for (size_t i = 0; i < m_FrameCount; ++i)
+    {
+        file << i + 1 << ',' << m_Time[i] << ',' << m_WindowX[i] << ',' << m_WindowY[i] << ',' << m_WindowScale[i]
+            << ',' << m_HeaderScale[i] << ',' << m_HeaderOpacity[i] << ','
+            << m_PrevHeaderScale[i] << ',' << m_PrevHeaderOpacity[i] << ',' << m_CodeProgress[i] << ','
+            << (int)m_Repeat[i] << '\n';
+    }
+
+    std::cout << "Animation timeline written to " << path << "\n";
+    return true;
+}
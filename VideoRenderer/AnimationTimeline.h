@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CpuCompositor.h"
+
+
+// Keyframe values of one slide's window, header and code animation, fixed at load time.
+struct AnimationKeys
+{
+    float duration = 0.0f;
+    float codeDuration = 0.0f;
+
+    float startSizeX = 0.0f;
+    float startSizeY = 0.0f;
+    float midSizeX = 0.0f;
+    float midSizeY = 0.0f;
+    float endSizeX = 0.0f;
+    float endSizeY = 0.0f;
+
+    float startScale = 0.0f;
+    float endScale = 0.0f;
+
+    bool bHeaderChanged = false;
+};
+
+// Everything that changes from frame to frame, as a pure function of the frame's time. Drawing
+// reads only this, so frames can be prepared in any order and on any thread.
+struct FrameState
+{
+    float time = 0.0f;
+    CompositeParams window;
+
+    float headerScale = 1.0f;
+    float headerOpacity = 1.0f;
+    float prevHeaderScale = 0.0f;   // outgoing header of the previous slide, while it shrinks away
+    float prevHeaderOpacity = 0.0f;
+
+    float codeProgress = 0.0f;
+};
+
+
+// Frames [first, last] render identically; all but `first` repeat the one before.
+struct StaticSpan
+{
+    uint32_t first = 0;
+    uint32_t last = 0;
+};
+
+
+// Every animated parameter of every frame, evaluated once up front and stored one array per
+// parameter. Build works parameter by parameter over contiguous ranges: phases, then easing, then
+// the lerps, so the render loop only indexes. Frame numbers are 1-based like the render loop, so
+// frame f is at t = f / fps.
+class AnimationTimeline
+{
+    private:
+        uint32_t m_FrameCount = 0;
+        uint32_t m_FPS = 0;
+
+        std::vector<float> m_Time;
+        std::vector<float> m_WindowX;
+        std::vector<float> m_WindowY;
+        std::vector<float> m_WindowScale;
+        std::vector<float> m_HeaderScale;
+        std::vector<float> m_HeaderOpacity;
+        std::vector<float> m_PrevHeaderScale;
+        std::vector<float> m_PrevHeaderOpacity;
+        std::vector<float> m_CodeProgress;
+
+        std::vector<uint8_t> m_Repeat;
+        std::vector<StaticSpan> m_StaticSpans;
+        uint32_t m_RepeatCount = 0;
+
+
+    public:
+        void Build(const AnimationKeys& keys, const uint32_t& fps, const uint32_t& frameCount);
+
+        uint32_t GetFrameCount() const { return m_FrameCount; }
+        FrameState GetFrame(const uint32_t& frame) const;
+
+        // Whether `frame` renders exactly like the frame before it, so its pixels can be reused.
+        bool IsRepeat(const uint32_t& frame) const { return frame >= 2 && frame <= m_FrameCount && m_Repeat[frame - 1]; }
+        const std::vector<StaticSpan>& GetStaticSpans() const { return m_StaticSpans; }
+        uint32_t GetRepeatCount() const { return m_RepeatCount; }
+
+        // One CSV row per frame, one column per parameter.
+        bool Dump(const std::string& path) const;
+
+
+    private:
+        void FindStaticSpans();
+        static void Lerp(const float& a, const float& b, const float* t, float* out, const size_t& count);
+};
@@ -1,21 +1,69 @@
 #include "Application.h"
+#include "FramePipeline.h"
+#include "ReorderBuffer.h"
+#include "StreamConcat.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <sstream>
 #include <chrono>
 
 
+// Brings `frame` up to date with `source` inside `region`; the rest already matches.
+static void CopyRegion(const CpuFrame& source, const DirtyRect& region, CpuFrame& frame)
+{
+    if (frame.width != source.width || frame.height != source.height)
+    {
+        frame = source;
+        return;
+    }
+
+    const uint32_t x0 = std::min(region.x0, source.width);
+    const uint32_t x1 = std::clamp(region.x1, x0, source.width);
+    const uint32_t y1 = std::min(region.y1, source.height);
+    for (uint32_t y = region.y0; y < y1; ++y)
+        std::copy(source.Row(y) + x0, source.Row(y) + x1, frame.Row(y) + x0);
+}
+
+// The same for P010, grown to the even columns and row pairs chroma covers.
+static void CopyRegion(const P010Frame& source, const DirtyRect& region, P010Frame& frame)
+{
+    if (frame.width != source.width || frame.height != source.height)
+    {
+        frame = source;
+        return;
+    }
+
+    const uint32_t x0 = std::min(region.x0, source.width) & ~1u;
+    const uint32_t x1 = std::max(std::min((region.x1 + 1) & ~1u, source.width), x0);
+    const uint32_t pair0 = std::min(region.y0, source.height) / 2;
+    const uint32_t pair1 = (std::min(region.y1, source.height) + 1) / 2;
+    for (uint32_t pair = pair0; pair < pair1; ++pair)
+    {
+        for (uint32_t y = pair * 2; y < std::min(pair * 2 + 2, source.height); ++y)
+            std::copy(source.LumaRow(y) + x0, source.LumaRow(y) + x1, frame.LumaRow(y) + x0);
+
+        // Interleaved UV, one pair per two columns.
+        std::copy(source.ChromaRow(pair) + x0, source.ChromaRow(pair) + (x1 + 1) / 2 * 2, frame.ChromaRow(pair) + x0);
+    }
+}
+
+
 Application::Application
 (
     const uint16_t& width,
     const uint16_t& height,
     const uint8_t& fps,
-    const uint16_t& duration
+    const uint16_t& duration,
+    const RenderBackend& backend
 )
     : m_Width(width)
     , m_Height(height)
     , m_FPS(fps)
     , m_TotalFrames((uint32_t)fps * duration)
+    , m_Backend(backend)
 {}
 
 Application::~Application() {}
@@ -23,73 +71,536 @@ Application::~Application() {}
 
 bool Application::Initialize(const std::string& outputPath, Slide* pSlide)
 {
-    m_pRenderer = std::make_unique<Renderer>(m_Width, m_Height);
+    m_pRenderer = std::make_unique<Renderer>(m_Width, m_Height, m_Backend);
+    m_pRenderer->SetTextBackend(m_TextBackend);
+
+    // The software encoder reads system memory, so the CPU backends never need a D3D11 device.
+    m_pRenderer->SetSystemMemory(m_Backend != RenderBackend::GPU && m_EncoderSettings.backend == EncoderBackend::Software);
     if (!m_pRenderer->Initialize(pSlide))
     {
         std::cerr << "Failed to initialize renderer\n";
         return false;
     }
 
-    m_pEncoder = std::make_unique<VideoEncoder>(outputPath, m_Width, m_Height, m_FPS, 0);
-    if (!m_pEncoder->Initialize(m_pRenderer->GetDevice()))
+    m_Timeline.Build(m_pRenderer->GetAnimationKeys(), m_FPS, m_TotalFrames);
+    if (!m_TimelineDumpPath.empty())
+        m_Timeline.Dump(m_TimelineDumpPath);
+
+    if (m_bBenchmark)
+        m_pRenderer->BenchmarkCompositor(60);
+
+    // The fused backends hand the encoder finished P010 planes.
+    if (m_pRenderer->IsFused() && m_OutputFormat != OutputFormat::P010)
+    {
+        std::cout << "The fused CPU backends only produce P010, ignoring " << GetFormatInfo(m_OutputFormat).name << "\n";
+        m_OutputFormat = OutputFormat::P010;
+    }
+
+    // Chunked runs open one encoder per chunk instead and write the output when they concatenate.
+    m_OutputPath = outputPath;
+    if (m_ChunkFrames > 0)
+        return true;
+
+    m_pEncoder = CreateEncoder(outputPath);
+    return m_pEncoder != nullptr;
+}
+
+std::unique_ptr<VideoEncoder> Application::CreateEncoder(const std::string& outputPath) const
+{
+    std::unique_ptr<VideoEncoder> pEncoder = std::make_unique<VideoEncoder>(outputPath, m_Width, m_Height, m_FPS, 0);
+    pEncoder->SetOutputFormat(m_OutputFormat);
+    pEncoder->SetSettings(m_EncoderSettings);
+    if (!pEncoder->Initialize(m_pRenderer->GetDevice()))
     {
         std::cerr << "Failed to initialize encoder\n";
+        return nullptr;
+    }
+
+    return pEncoder;
+}
+
+bool Application::AppendSlide(Slide* pSlide)
+{
+    const EndInfo prevEnd = m_pRenderer->GetEndInfo();
+    if (!m_pRenderer->LoadSlide(pSlide, &prevEnd))
+    {
+        std::cerr << "Failed to load slide " << pSlide->m_SlideNo << "\n";
         return false;
     }
 
+    m_TotalFrames = (uint32_t)m_FPS * (uint16_t)pSlide->m_Duration;
+    m_Timeline.Build(m_pRenderer->GetAnimationKeys(), m_FPS, m_TotalFrames);
+    if (!m_TimelineDumpPath.empty())
+        m_Timeline.Dump(m_TimelineDumpPath);
+
     return true;
 }
 
-void Application::Run()
+bool Application::Run()
+{
+    if (m_ChunkFrames > 0)
+    {
+        using clock = std::chrono::high_resolution_clock;
+        auto t0 = clock::now();
+
+        if (!RunChunked())
+            return false;
+
+        std::cout << "\nVideo rendering complete!\nTotal render time: "
+            << std::chrono::duration<double>(clock::now() - t0).count() << " s\n";
+        return true;
+    }
+
+    // The video is finalized even after a failed frame, so what was encoded stays playable.
+    const bool bRendered = RenderSlide();
+    return Finish() && bRendered;
+}
+
+bool Application::RenderSlide()
 {
     using clock = std::chrono::high_resolution_clock;
     auto t0 = clock::now();
+    if (m_FramesWritten == 0)
+        m_StartTime = t0;
+
+    // Stages can only run apart when the encoder takes system memory: NVENC reads D3D11 frames
+    // through the same immediate context the renderer draws with.
+    const bool bPipelined = m_PipelineDepth > 0 && m_pEncoder->IsSoftware();
 
     std::cout << "\nRendering " << m_TotalFrames << " frames...\n";
-    for (int frame = 1; frame <= m_TotalFrames; ++frame)
+    bool bResult = false;
+    if (m_FramesInFlight > 1 && m_pRenderer->SupportsFrameParallel())
+        bResult = RunFrameParallel();
+    else if (bPipelined)
+        bResult = RunPipelined();
+    else
+        bResult = RunSerial();
+
+    m_FramesWritten += m_TotalFrames;
+    if (!bResult)
     {
-        float t = static_cast<float>(frame) / static_cast<float>(m_FPS);
-        float p = static_cast<float>(frame) / static_cast<float>(m_TotalFrames);
+        std::cerr << "\nSlide failed after " << std::chrono::duration<double>(clock::now() - t0).count() << " s\n";
+        return false;
+    }
 
-        m_pRenderer->RenderCompute(t, p);
+    std::cout << "\nSlide rendered in " << std::chrono::duration<double>(clock::now() - t0).count() << " s\n";
+    if (m_Timeline.GetRepeatCount() > 0)
+    {
+        std::cout << "Static spans: " << m_Timeline.GetRepeatCount() << " frames in " << m_Timeline.GetStaticSpans().size()
+            << " spans reused the previous frame instead of rendering\n";
+    }
 
-        m_pRenderer->BeginFrame();
-        RenderOverlay(frame + 1);
-        m_pRenderer->EndFrame();
+    return true;
+}
+
+bool Application::Finish()
+{
+    std::cout << '\n';
+    if (!m_pEncoder->Finalize())
+    {
+        std::cerr << "Failed to finalize " << m_OutputPath << "\n";
+        return false;
+    }
+    std::cout << "\nVideo rendering complete!\n";
+
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_StartTime).count();
+    std::cout << "Total render time: " << seconds << " s\n";
+
+    if (m_Backend == RenderBackend::CPUTiled && m_FramesWritten > 0)
+    {
+        const TileStats& tiles = m_pRenderer->GetTotalTileStats();
+        const double n = (double)m_FramesWritten;
+        std::cout << "Tiles per frame: " << tiles.outside / n << " outside, " << tiles.inside / n << " inside, "
+            << tiles.edge / n << " edge, " << tiles.skipped / n << " skipped, " << tiles.text / n << " with text\n";
+    }
+
+    if (const AtlasStats* pAtlas = m_pRenderer->GetAtlasStats())
+    {
+        std::cout << "Glyph atlas: " << pAtlas->hits << " hits, " << pAtlas->misses << " misses ("
+            << pAtlas->GetHitRate() * 100.0 << "% hit), " << pAtlas->glyphs << " glyphs, "
+            << pAtlas->GetOccupancy() * 100.0 << "% occupied, " << pAtlas->resets << " resets\n";
+    }
+
+    return true;
+}
+
+
+bool Application::RunSerial()
+{
+    for (uint32_t frame = 1; frame <= m_TotalFrames; ++frame)
+    {
+        bool bEncoded = false;
+        if (m_Timeline.IsRepeat(frame))
+        {
+            bEncoded = m_pEncoder->RepeatFrame();
+        }
+        else
+        {
+            RenderFrame(frame);
+            if (m_pRenderer->IsFused())
+                bEncoded = m_pEncoder->EncodeFrame(m_pRenderer->GetP010Frame());
+            else if (m_pRenderer->IsSystemMemory())
+                bEncoded = m_pEncoder->EncodeFrame(m_pRenderer->GetCpuFrame());
+            else
+                bEncoded = m_pEncoder->EncodeFrame(m_pRenderer->GetRenderTexture());
+        }
 
-        if (!m_pEncoder->EncodeFrame(m_pRenderer->GetRenderTexture()))
+        if (!bEncoded)
         {
             std::cerr << "Failed to encode frame " << frame << "\n";
+            return false;
+        }
+
+        PrintProgress(frame);
+    }
+
+    return true;
+}
+
+bool Application::RunPipelined()
+{
+    FramePipeline pipeline(m_pEncoder.get(), m_PipelineDepth);
+    pipeline.Start();
+
+    bool bResult = true;
+    for (uint32_t frame = 1; frame <= m_TotalFrames; ++frame)
+    {
+        PipelineFrame* pFrame = pipeline.Acquire();
+        if (!pFrame || !SubmitFrame(pipeline, pFrame, frame, m_Timeline.IsRepeat(frame), *m_pEncoder))
+        {
+            std::cerr << "Failed to render frame " << frame << "\n";
+            bResult = false;
             break;
         }
 
-        if (frame % 30 != 0)
-            continue;
+        PrintProgress(frame);
+    }
 
-        uint8_t percent = (float)frame / m_TotalFrames * 100;
-        
-        std::cout << "\r";
-        std::cout << frame << '/' << m_TotalFrames << ' ' << (int)percent << "%  \t[";
-        for (uint8_t p = 1; p <= percent; ++p)
-            std::cout << (char)254u;
-        for (uint8_t p = percent; p < 100; ++p)
-            std::cout << ' ';
-        std::cout << "]";
+    if (!pipeline.Finish())
+    {
+        std::cerr << "Pipeline stopped early\n";
+        bResult = false;
     }
 
     std::cout << '\n';
-    m_pEncoder->Finalize();
-    std::cout << "\nVideo rendering complete!\n";
+    pipeline.PrintStats();
+    return bResult;
+}
 
-    auto t1 = clock::now();
-    double seconds = std::chrono::duration<double>(t1 - t0).count();
+bool Application::SubmitFrame(FramePipeline& pipeline, PipelineFrame* pFrame, const uint32_t& frame, const bool& bRepeat,
+    VideoEncoder& encoder)
+{
+    using clock = std::chrono::high_resolution_clock;
 
-    std::cout << "Total render time: " << seconds << " s\n";
+    pFrame->number = frame;
+    pFrame->bRepeat = bRepeat;
+    if (pFrame->bRepeat)
+    {
+        pipeline.Submit(pFrame);
+        return true;
+    }
+
+    auto t0 = clock::now();
+    RenderFrame(frame);
+
+    // The renderer rewrites its output frames in place where they change, so a buffer only takes
+    // what changed since the output frame it holds instead of a whole frame.
+    pFrame->bHasRgba = !m_pRenderer->IsFused();
+    if (!pFrame->bHasRgba)
+    {
+        CopyRegion(m_pRenderer->GetP010Frame(), m_pRenderer->GetOutputChanges(pFrame->serial), pFrame->p010);
+        pFrame->serial = m_pRenderer->GetOutputSerial();
+    }
+    else if (m_pRenderer->IsSystemMemory())
+    {
+        CopyRegion(m_pRenderer->GetCpuFrame(), m_pRenderer->GetOutputChanges(pFrame->serial), pFrame->rgba);
+        pFrame->serial = m_pRenderer->GetOutputSerial();
+    }
+    else
+    {
+        pFrame->serial = 0;
+        if (!encoder.ReadbackTexture(m_pRenderer->GetRenderTexture(), pFrame->rgba))
+            return false;
+    }
+
+    pipeline.AddRenderTime(std::chrono::duration<double, std::milli>(clock::now() - t0).count());
+    pipeline.Submit(pFrame);
+    return true;
+}
+
+bool Application::RunChunked()
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    // Optional baseline: the same slide through the path Run would otherwise take, into a scratch file.
+    double serialSeconds = 0.0;
+    if (m_bCompareSerial)
+    {
+        const std::string serialPath = GetChunkPath("serial");
+        m_pEncoder = CreateEncoder(serialPath);
+        bool bBaseline = m_pEncoder != nullptr;
+        if (bBaseline)
+        {
+            std::cout << "\nSerial baseline\n";
+            auto t0 = clock::now();
+            bBaseline = RenderSlide();
+            bBaseline = m_pEncoder->Finalize() && bBaseline;
+            serialSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+            m_FramesWritten = 0;
+        }
+
+        m_pEncoder.reset();
+        std::filesystem::remove(serialPath);
+        if (!bBaseline)
+        {
+            std::cerr << "Serial baseline failed\n";
+            return false;
+        }
+    }
+
+    struct Chunk
+    {
+        uint32_t first = 0;
+        uint32_t last = 0;
+        uint32_t next = 0;
+        std::unique_ptr<VideoEncoder> pEncoder;
+        std::unique_ptr<FramePipeline> pPipeline;
+        clock::time_point start;
+        double seconds = 0.0;
+    };
+
+    const uint32_t chunkFrames = std::max(m_ChunkFrames, 1u);
+    const uint32_t workers = std::max(m_ChunkWorkers, 1u);
+    const uint32_t chunkCount = (m_TotalFrames + chunkFrames - 1) / chunkFrames;
+
+    std::vector<Chunk> chunks(chunkCount);
+    std::vector<ChunkFile> files(chunkCount);
+    for (uint32_t c = 0; c < chunkCount; ++c)
+    {
+        chunks[c].first = c * chunkFrames + 1;
+        chunks[c].last = std::min((c + 1) * chunkFrames, m_TotalFrames);
+        chunks[c].next = chunks[c].first;
+        files[c].path = GetChunkPath("chunk" + std::to_string(c));
+        files[c].startFrame = chunks[c].first - 1;
+    }
+
+    std::cout << "\nRendering " << m_TotalFrames << " frames as " << chunkCount << " chunks of " << chunkFrames
+        << " on " << workers << " encoders...\n";
+
+    auto t0 = clock::now();
+    bool bFailed = false;
+    uint32_t opened = 0;
+    uint32_t finished = 0;
+    uint32_t rendered = 0;
+
+    // Joins the oldest closed chunk; its encode thread finalized it already.
+    auto Retire = [&]()
+    {
+        Chunk& chunk = chunks[finished++];
+        if (!chunk.pPipeline->Finish())
+            bFailed = true;
+        chunk.seconds = std::chrono::duration<double>(clock::now() - chunk.start).count();
+        chunk.pPipeline.reset();
+        chunk.pEncoder.reset();
+    };
+
+    // One renderer feeds every chunk: D2D and the immediate context are single-threaded. Up to
+    // `workers` chunks take turns a frame at a time, each through its own pipeline and encoder,
+    // so the encoders run side by side. Every chunk opens its own stream, so it starts on an IDR
+    // frame and never references another chunk.
+    while (finished < chunkCount && !bFailed)
+    {
+        while (opened < chunkCount && opened - finished < workers && !bFailed)
+        {
+            Chunk& chunk = chunks[opened];
+            chunk.pEncoder = CreateEncoder(files[opened].path);
+            if (!chunk.pEncoder || !chunk.pEncoder->IsSoftware())
+            {
+                std::cerr << "Chunked encoding needs the software encoder\n";
+                bFailed = true;
+                break;
+            }
+
+            chunk.pPipeline = std::make_unique<FramePipeline>(chunk.pEncoder.get(), m_PipelineDepth);
+            chunk.pPipeline->Start();
+            chunk.start = clock::now();
+            ++opened;
+        }
+
+        bool bRendered = false;
+        for (uint32_t c = finished; c < opened && !bFailed; ++c)
+        {
+            Chunk& chunk = chunks[c];
+            if (chunk.next > chunk.last)
+                continue;
+
+            PipelineFrame* pFrame = chunk.pPipeline->Acquire();
+            const bool bRepeat = chunk.next != chunk.first && m_Timeline.IsRepeat(chunk.next);
+            if (!pFrame || !SubmitFrame(*chunk.pPipeline, pFrame, chunk.next, bRepeat, *chunk.pEncoder))
+            {
+                std::cerr << "Chunk " << c << " failed at frame " << chunk.next << "\n";
+                bFailed = true;
+                break;
+            }
+
+            if (++chunk.next > chunk.last)
+                chunk.pPipeline->Close(true);
+
+            PrintProgress(++rendered);
+            bRendered = true;
+        }
+
+        // Everything open is submitted: wait for the oldest to make room.
+        if (!bRendered && finished < opened)
+            Retire();
+    }
+
+    while (finished < opened)
+        Retire();
+
+    const double encodeSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+    bool bConcatenated = false;
+    double concatSeconds = 0.0;
+    if (!bFailed)
+    {
+        auto t1 = clock::now();
+        bConcatenated = StreamConcat::Concatenate(files, m_FPS, m_OutputPath);
+        concatSeconds = std::chrono::duration<double>(clock::now() - t1).count();
+    }
+
+    for (const ChunkFile& file : files)
+        std::filesystem::remove(file.path);
+
+    m_FramesWritten += m_TotalFrames;
+    if (!bConcatenated)
+    {
+        std::cerr << "Chunked encode failed, " << m_OutputPath << " was not written\n";
+        return false;
+    }
+
+    double chunkSeconds = 0.0;
+    for (const Chunk& chunk : chunks)
+        chunkSeconds += chunk.seconds;
+
+    const double wallSeconds = encodeSeconds + concatSeconds;
+    std::cout << "\nChunked: " << wallSeconds << " s wall (" << concatSeconds << " s concatenating), "
+        << chunkSeconds / chunkCount << " s per chunk average\n";
+    if (serialSeconds > 0.0)
+        std::cout << "Serial: " << serialSeconds << " s, speedup " << serialSeconds / wallSeconds << "x\n";
+    return true;
+}
+
+std::string Application::GetChunkPath(const std::string& suffix) const
+{
+    std::filesystem::path path(m_OutputPath);
+    const std::filesystem::path extension = path.extension();
+    path.replace_extension();
+    return path.string() + "." + suffix + extension.string();
+}
+
+bool Application::RunFrameParallel()
+{
+    // Text is drawn on this thread, one frame at a time, because D2D and the D3D11 context are
+    // single-threaded; the composites of up to m_FramesInFlight frames run on the pool meanwhile.
+    // Finished frames come back in any order and are encoded here in pts order, so hardware
+    // encoding stays on the render thread too.
+    const uint32_t slotCount = m_FramesInFlight;
+    std::vector<RenderSlot> slots(slotCount);
+    ReorderBuffer<RenderSlot*> reorder(slotCount, 1);
+    bool bFailed = false;
+
+    auto EncodeNext = [&](const bool& bWait)
+    {
+        RenderSlot* pSlot = nullptr;
+        if (bWait)
+            pSlot = reorder.Pop();
+        else if (!reorder.TryPop(pSlot))
+            return false;
+
+        // A null slot is a repeat of the frame before it.
+        const uint32_t frame = (uint32_t)reorder.GetNext() - 1;
+        if (pSlot)
+            m_pRenderer->AddTileStats(pSlot->tileStats);
+        if (!bFailed && !(pSlot ? m_pEncoder->EncodeFrame(pSlot->p010) : m_pEncoder->RepeatFrame()))
+        {
+            std::cerr << "Failed to encode frame " << frame << "\n";
+            bFailed = true;
+        }
+
+        PrintProgress(frame);
+        return true;
+    };
+
+    uint32_t submitted = 0;
+    for (uint32_t frame = 1; frame <= m_TotalFrames && !bFailed; ++frame)
+    {
+        // Slot reuse: frame - slotCount must be encoded before its buffers are overwritten.
+        while (reorder.GetNext() + slotCount <= frame)
+            EncodeNext(true);
+        while (EncodeNext(false))
+            ;
+
+        if (m_Timeline.IsRepeat(frame))
+        {
+            reorder.Insert(frame, nullptr);
+            ++submitted;
+            continue;
+        }
+
+        RenderSlot* pSlot = &slots[(frame - 1) % slotCount];
+        const FrameState state = m_Timeline.GetFrame(frame);
+
+        m_pRenderer->BeginFrame();
+        RenderOverlay(state);
+        m_pRenderer->EndFrame(*pSlot);
+
+        ThreadPool::Get().Submit([this, &reorder, pSlot, state, frame]()
+        {
+            m_pRenderer->CompositeSlot(state, *pSlot);
+            reorder.Insert(frame, pSlot);
+        });
+        ++submitted;
+    }
+
+    // Every submitted job has to come back before the slots go away, even after a failure.
+    while (reorder.GetNext() <= submitted)
+        EncodeNext(true);
+
+    std::cout << "\nFrame-parallel: " << slotCount << " frames in flight, up to " << reorder.GetMaxPending()
+        << " finished out of order at once, encoder waited " << reorder.GetStalls() << " times\n";
+    return !bFailed;
+}
+
+void Application::RenderFrame(const uint32_t& frame)
+{
+    const FrameState state = m_Timeline.GetFrame(frame);
+
+    m_pRenderer->RenderCompute(state);
+
+    m_pRenderer->BeginFrame();
+    RenderOverlay(state);
+    m_pRenderer->EndFrame();
+}
+
+void Application::PrintProgress(const uint32_t& frame)
+{
+    if (!m_bProgress || frame % 30 != 0)
+        return;
+
+    uint8_t percent = (float)frame / m_TotalFrames * 100;
+
+    std::cout << "\r";
+    std::cout << frame << '/' << m_TotalFrames << ' ' << (int)percent << "%  \t[";
+    for (uint8_t p = 1; p <= percent; ++p)
+        std::cout << (char)254u;
+    for (uint8_t p = percent; p < 100; ++p)
+        std::cout << ' ';
+    std::cout << "]";
 }
 
 
-void Application::RenderOverlay(const uint32_t& frameNumber)
+void Application::RenderOverlay(const FrameState& state)
 {
-    m_pRenderer->DrawHeader();
-    m_pRenderer->DrawCode();
+    m_pRenderer->DrawHeader(state);
+    m_pRenderer->DrawCode(state);
 }
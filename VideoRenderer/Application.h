@@ -2,8 +2,10 @@
 
 #include "Renderer.h"
 #include "VideoEncoder.h"
+#include "FramePipeline.h"
 #include "Slide.h"
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -15,21 +17,86 @@ class Application
         uint16_t m_Height = 0;
         uint8_t m_FPS = 0;
         uint32_t m_TotalFrames = 0;
+        RenderBackend m_Backend = RenderBackend::GPU;
+        TextBackend m_TextBackend = TextBackend::Direct2D;
+        OutputFormat m_OutputFormat = OutputFormat::P010;
+        EncoderSettings m_EncoderSettings;
+        uint32_t m_PipelineDepth = 3;
+        uint32_t m_FramesInFlight = 0;
+        uint32_t m_ChunkFrames = 0;
+        uint32_t m_ChunkWorkers = 0;
+        bool m_bCompareSerial = false;
+        std::string m_OutputPath;
+
+        uint32_t m_FramesWritten = 0;
+        std::chrono::high_resolution_clock::time_point m_StartTime;
 
         uint8_t m_PrevPercent = 0;
+        bool m_bBenchmark = false;
+        bool m_bProgress = true;
+
+        AnimationTimeline m_Timeline;
+        std::string m_TimelineDumpPath;
 
         std::unique_ptr<Renderer> m_pRenderer;
         std::unique_ptr<VideoEncoder> m_pEncoder;
 
 
     public:
-        Application(const uint16_t& width, const uint16_t& height, const uint8_t& fps, const uint16_t& duration);
+        Application(const uint16_t& width, const uint16_t& height, const uint8_t& fps, const uint16_t& duration,
+            const RenderBackend& backend = RenderBackend::GPU);
         ~Application();
     
         bool Initialize(const std::string& outputPath, Slide* pSlide);
-        void Run();
+        void SetBenchmark(const bool& bBenchmark) { m_bBenchmark = bBenchmark; }
+
+        // The progress bar redraws one console line; off when several renders share the console.
+        void SetProgress(const bool& bProgress) { m_bProgress = bProgress; }
+        uint32_t GetTotalFrames() const { return m_TotalFrames; }
+        void SetOutputFormat(const OutputFormat& format) { m_OutputFormat = format; }
+        void SetTextBackend(const TextBackend& backend) { m_TextBackend = backend; }
+        void SetEncoderSettings(const EncoderSettings& settings) { m_EncoderSettings = settings; }
+
+        // Frame buffers in flight between render, convert and encode; 0 runs the stages serially.
+        void SetPipelineDepth(const uint32_t& depth) { m_PipelineDepth = depth; }
+
+        // Frames composited concurrently on the thread pool (fused backends); 0 or 1 renders one at a time.
+        void SetFramesInFlight(const uint32_t& frames) { m_FramesInFlight = frames; }
+
+        // Encodes chunks of `chunkFrames` frames as independent streams, `workers` at a time, and
+        // joins them into the output losslessly; 0 encodes one stream. Software encoding only, and
+        // only through Run. bCompareSerial first times the unchunked path on the same slide.
+        void SetChunking(const uint32_t& chunkFrames, const uint32_t& workers, const bool& bCompareSerial = false)
+        {
+            m_ChunkFrames = chunkFrames;
+            m_ChunkWorkers = workers;
+            m_bCompareSerial = bCompareSerial;
+        }
+
+        // Writes the precomputed per-frame animation values as CSV during Initialize; empty skips it.
+        void SetTimelineDump(const std::string& path) { m_TimelineDumpPath = path; }
+
+        // Renders the slide and finalizes the video; false if any frame failed to render or encode.
+        bool Run();
+
+        // Back-to-back slides in one file: RenderSlide, then AppendSlide and RenderSlide for each
+        // following slide, then Finish. Devices and the encoder stay open throughout, and each slide
+        // starts from the previous one's end state in memory. Each returns false on failure.
+        bool AppendSlide(Slide* pSlide);
+        bool RenderSlide();
+        bool Finish();
     
 
     private:
-        void RenderOverlay(const uint32_t& frameNumber);
+        bool RunSerial();
+        bool RunPipelined();
+        bool RunFrameParallel();
+        bool RunChunked();
+        bool SubmitFrame(FramePipeline& pipeline, PipelineFrame* pFrame, const uint32_t& frame, const bool& bRepeat,
+            VideoEncoder& encoder);
+        std::unique_ptr<VideoEncoder> CreateEncoder(const std::string& outputPath) const;
+        std::string GetChunkPath(const std::string& suffix) const;
+        void RenderFrame(const uint32_t& frame);
+        void PrintProgress(const uint32_t& frame);
+        void RenderOverlay(const FrameState& state);
 };
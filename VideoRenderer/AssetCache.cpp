@@ -0,0 +1,302 @@
+#include "AssetCache.h"
+#include "Hash.h"
+#include "ImageLoader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+
+// Pixels start at sizeof(CacheHeader), so the mapped view stays 64-byte aligned.
+struct CacheHeader
+{
+    uint32_t magic = AssetCache::Magic;
+    uint32_t version = AssetCache::Version;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t reserved[6] {};
+};
+static_assert(sizeof(CacheHeader) == 64);
+
+// Contents of a .ref entry: which .raw entry the source file hashed to when it last had this path,
+// size and write time.
+struct CacheRef
+{
+    uint32_t magic = AssetCache::Magic ^ 0x00004600;  // "VRFC"
+    uint32_t version = AssetCache::Version;
+    uint64_t contentHash = 0;
+};
+static_assert(sizeof(CacheRef) == 16);
+
+
+std::filesystem::path& AssetCache::GetDirectory()
+{
+    static std::filesystem::path directory = "../in/cache";
+    return directory;
+}
+
+std::filesystem::path AssetCache::GetEntryPath(const uint64_t& key, const char* extension)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)key, extension);
+    return GetDirectory() / name;
+}
+
+bool AssetCache::GetSourceKey(const std::filesystem::path& path, uint64_t& key)
+{
+    std::error_code ec;
+    const std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+    const uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    const std::filesystem::file_time_type written = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return false;
+
+    const std::wstring name = absolute.wstring();
+    uint64_t fields[2] = { (uint64_t)size, (uint64_t)written.time_since_epoch().count() };
+    key = HashBytes(fields, sizeof(fields), HashBytes(name.data(), name.size() * sizeof(wchar_t)));
+    return true;
+}
+
+
+bool AssetCache::LoadDecoded(const std::wstring& path, CpuImage& image, uint64_t& contentHash)
+{
+    using clock = std::chrono::high_resolution_clock;
+    auto t0 = clock::now();
+
+    // An unchanged file maps its entry without being read or hashed again.
+    uint64_t sourceKey = 0;
+    const bool bHasSourceKey = GetSourceKey(path, sourceKey);
+    const std::filesystem::path ref = GetEntryPath(sourceKey, "ref");
+    if (bHasSourceKey && ReadRef(ref, contentHash) && Map(GetEntryPath(contentHash), image))
+    {
+        auto t1 = clock::now();
+        std::wcout << L"Asset cache hit for " << path << L" ("
+            << std::chrono::duration<double, std::milli>(t1 - t0).count() << L" ms)\n";
+        return true;
+    }
+
+    std::ifstream file(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        std::wcerr << L"Failed to open " << path << L"\n";
+        return false;
+    }
+
+    std::vector<char> bytes((size_t)file.tellg());
+    file.seekg(0);
+    file.read(bytes.data(), (std::streamsize)bytes.size());
+    file.close();
+
+    contentHash = HashBytes(bytes.data(), bytes.size());
+    const std::filesystem::path entry = GetEntryPath(contentHash);
+
+    if (Map(entry, image))
+    {
+        auto t1 = clock::now();
+        std::wcout << L"Asset cache hit for " << path << L" ("
+            << std::chrono::duration<double, std::milli>(t1 - t0).count() << L" ms)\n";
+    }
+    else
+    {
+        if (!ImageLoader::LoadRGBA8(path, image))
+            return false;
+        Store(entry, image);
+    }
+
+    if (bHasSourceKey)
+        StoreRef(ref, contentHash);
+    return true;
+}
+
+bool AssetCache::LoadBlurred(const uint64_t& contentHash, const BlurSettings& settings, const CpuImage& source,
+    CpuImage& blurred)
+{
+    uint64_t key[3] = { contentHash, 0, 0 };
+    static_assert(sizeof(float) * 2 <= sizeof(uint64_t));
+    std::memcpy(&key[1], &settings.radius, sizeof(float));
+    std::memcpy((char*)&key[1] + sizeof(float), &settings.dim, sizeof(float));
+    key[2] = GaussianBlur::Version;
+
+    const std::filesystem::path entry = GetEntryPath(HashBytes(key, sizeof(key)));
+    if (Map(entry, blurred) && blurred.width == source.width && blurred.height == source.height)
+        return true;
+
+    if (!GaussianBlur::ApplyCached(source, settings, blurred))
+        return false;
+
+    Store(entry, blurred);
+    return true;
+}
+
+
+bool AssetCache::Map(const std::filesystem::path& path, CpuImage& image)
+{
+    std::error_code ec;
+    const uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec || size < sizeof(CacheHeader))
+        return false;
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view)
+        return false;
+
+    auto unmap = [](const void* p) { UnmapViewOfFile(p); };
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    void* mapped = mmap(nullptr, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    const void* view = mapped;
+    auto unmap = [size](const void* p) { munmap(const_cast<void*>(p), (size_t)size); };
+#endif
+
+    // Owns the mapping; the pixel pointer below shares its lifetime.
+    std::shared_ptr<const void> owner(view, unmap);
+
+    CacheHeader header {};
+    std::memcpy(&header, view, sizeof(header));
+
+    const uint64_t expected = sizeof(CacheHeader) + (uint64_t)header.width * header.height * sizeof(uint32_t);
+    if (header.magic != Magic || header.version != Version || header.width == 0 || header.height == 0 || size != expected)
+    {
+        std::cerr << "Ignoring stale asset cache entry " << path.string() << "\n";
+        return false;
+    }
+
+    const uint32_t* pixels = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(view) + sizeof(CacheHeader));
+
+    image.width = header.width;
+    image.height = header.height;
+    image.pixels = std::shared_ptr<const uint32_t[]>(owner, pixels);
+    return true;
+}
+
+bool AssetCache::Store(const std::filesystem::path& path, const CpuImage& image)
+{
+    if (!image.IsValid())
+        return false;
+
+    CacheHeader header {};
+    header.width = image.width;
+    header.height = image.height;
+
+    return WriteAtomically(path, &header, sizeof(header), image.pixels.get(),
+        (size_t)image.width * image.height * sizeof(uint32_t));
+}
+
+bool AssetCache::ReadRef(const std::filesystem::path& path, uint64_t& contentHash)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    CacheRef ref {};
+    const CacheRef expected {};
+    in.read(reinterpret_cast<char*>(&ref), sizeof(ref));
+    if (!in || ref.magic != expected.magic || ref.version != expected.version)
+        return false;
+
+    contentHash = ref.contentHash;
+    return true;
+}
+
+bool AssetCache::StoreRef(const std::filesystem::path& path, const uint64_t& contentHash)
+{
+    uint64_t current = 0;
+    if (ReadRef(path, current) && current == contentHash)
+        return true;
+
+    CacheRef ref {};
+    ref.contentHash = contentHash;
+    return WriteAtomically(path, &ref, sizeof(ref), nullptr, 0);
+}
+
+bool AssetCache::WriteAtomically(const std::filesystem::path& path, const void* header, const size_t& headerSize,
+    const void* data, const size_t& dataSize)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    // Written under a name only this writer uses and renamed, so concurrent writers of the same
+    // entry never share a file, and no run maps a half-written entry.
+#if defined(_WIN32)
+    const unsigned long processId = GetCurrentProcessId();
+#else
+    const unsigned long processId = (unsigned long)getpid();
+#endif
+    static std::atomic<uint32_t> counter { 0 };
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), ".%lu-%zx-%u.tmp", processId,
+        std::hash<std::thread::id>()(std::this_thread::get_id()), counter++);
+
+    std::filesystem::path temp = path;
+    temp += suffix;
+
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Failed to write asset cache entry " << temp.string() << "\n";
+            return false;
+        }
+
+        out.write(static_cast<const char*>(header), (std::streamsize)headerSize);
+        if (dataSize > 0)
+            out.write(static_cast<const char*>(data), (std::streamsize)dataSize);
+        if (!out)
+        {
+            std::cerr << "Failed to write asset cache entry " << temp.string() << "\n";
+            out.close();
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+    {
+        std::cerr << "Failed to commit asset cache entry " << path.string() << ": " << ec.message() << "\n";
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+
+    return true;
+}
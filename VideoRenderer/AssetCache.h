@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "CpuFrame.h"
+#include "GaussianBlur.h"
+
+
+// On-disk cache of decoded RGBA8 layers under ../in/cache, named by the content hash of the source
+// file. Hits are memory-mapped and handed out as CpuImages that unmap when the last reference goes.
+// A small reference entry per source path, size and write time remembers that hash, so unchanged
+// files are not even read again.
+class AssetCache
+{
+    public:
+        static constexpr uint32_t Magic = 0x43495256;   // "VRIC"
+        static constexpr uint32_t Version = 1;
+
+        // Decodes `path` (or maps its cached planes) and returns the hash of the file's bytes.
+        static bool LoadDecoded(const std::wstring& path, CpuImage& image, uint64_t& contentHash);
+
+        // Blurred layer derived from the file with `contentHash`, generated and stored on a miss.
+        static bool LoadBlurred(const uint64_t& contentHash, const BlurSettings& settings, const CpuImage& source,
+            CpuImage& blurred);
+
+        static void SetDirectory(const std::filesystem::path& directory) { GetDirectory() = directory; }
+
+
+    private:
+        static std::filesystem::path& GetDirectory();
+        static std::filesystem::path GetEntryPath(const uint64_t& key, const char* extension = "raw");
+        static bool GetSourceKey(const std::filesystem::path& path, uint64_t& key);
+
+        static bool Map(const std::filesystem::path& path, CpuImage& image);
+        static bool Store(const std::filesystem::path& path, const CpuImage& image);
+        static bool ReadRef(const std::filesystem::path& path, uint64_t& contentHash);
+        static bool StoreRef(const std::filesystem::path& path, const uint64_t& contentHash);
+        static bool WriteAtomically(const std::filesystem::path& path, const void* header, const size_t& headerSize,
+            const void* data, const size_t& dataSize);
+};
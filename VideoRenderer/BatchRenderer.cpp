@@ -0,0 +1,408 @@
+#include "BatchRenderer.h"
+#include "Slide.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+
+BatchRenderer::BatchRenderer(const BatchOptions& options)
+    : m_Options(options)
+{}
+
+
+bool BatchRenderer::Run()
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    if (m_Options.slides.empty())
+    {
+        std::cerr << "No slides to render\n";
+        return false;
+    }
+
+    std::filesystem::create_directories(m_Options.outputDir);
+
+    const uint32_t slideCount = (uint32_t)m_Options.slides.size();
+    uint32_t jobs = std::max(m_Options.jobs, 1u);
+    const bool bUsesDevice = m_Options.backend == RenderBackend::GPU || m_Options.encoder.backend != EncoderBackend::Software;
+    if (bUsesDevice && jobs > MaxDeviceJobs)
+    {
+        std::cout << jobs << " jobs would share one GPU for rendering or encoding, running " << MaxDeviceJobs
+            << " (use --backend cpu/fused/tiled with --encoder software for more)\n";
+        jobs = MaxDeviceJobs;
+    }
+    jobs = std::min(jobs, slideCount);
+    m_Options.jobs = jobs;
+
+    m_Timings.assign(slideCount, SlideTiming {});
+    m_Loaded = 0;
+
+    std::cout << "Rendering " << slideCount << " slides at " << m_Options.width << "x" << m_Options.height << ", "
+        << (int)m_Options.fps << " fps, " << jobs << " at a time\n";
+
+    auto t0 = clock::now();
+    std::atomic<size_t> next { 0 };
+    auto Worker = [this, &next, slideCount]()
+    {
+        size_t index = 0;
+        while ((index = next.fetch_add(1)) < slideCount)
+            RenderSlide(index);
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < jobs; ++i)
+        workers.emplace_back(Worker);
+    Worker();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    const double wallSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+    WriteJson(wallSeconds, jobs);
+
+    return std::all_of(m_Timings.begin(), m_Timings.end(), [](const SlideTiming& t) { return t.bOk; });
+}
+
+void BatchRenderer::RenderSlide(const size_t& index)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    SlideTiming& timing = m_Timings[index];
+    timing.slide = m_Options.slides[index];
+    timing.output = (std::filesystem::path(m_Options.outputDir) / (std::to_string(timing.slide) + ".mp4")).string();
+
+    // Slides load in list order: each one reads the end info the previous one writes.
+    {
+        std::unique_lock<std::mutex> lock(m_LoadMutex);
+        m_LoadCV.wait(lock, [this, index]() { return m_Loaded == index; });
+    }
+
+    auto t0 = clock::now();
+    Slide slide(timing.slide);
+
+    Application app(m_Options.width, m_Options.height, m_Options.fps, slide.m_Duration, m_Options.backend);
+    Configure(app, m_Options, timing.slide);
+    app.SetProgress(m_Options.jobs == 1);
+
+    const bool bLoaded = app.Initialize(timing.output, &slide);
+    timing.loadSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+    MarkLoaded(index);
+
+    if (!bLoaded)
+    {
+        std::cerr << "Failed to initialize slide " << timing.slide << "\n";
+        return;
+    }
+
+    auto t1 = clock::now();
+    timing.bOk = app.Run();
+    timing.renderSeconds = std::chrono::duration<double>(clock::now() - t1).count();
+    timing.frames = app.GetTotalFrames();
+    if (!timing.bOk)
+    {
+        std::cerr << "Slide " << timing.slide << " failed after " << timing.renderSeconds << " s\n";
+        return;
+    }
+
+    std::cout << "Slide " << timing.slide << ": " << timing.frames << " frames in " << timing.renderSeconds
+        << " s, saved to " << timing.output << "\n";
+}
+
+void BatchRenderer::MarkLoaded(const size_t& index)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_LoadMutex);
+        m_Loaded = index + 1;
+    }
+    m_LoadCV.notify_all();
+}
+
+
+void BatchRenderer::Configure(Application& app, const BatchOptions& options, const int& slide)
+{
+    app.SetOutputFormat(options.outputFormat);
+    app.SetTextBackend(options.textBackend);
+    app.SetEncoderSettings(options.encoder);
+    app.SetPipelineDepth(options.pipelineDepth);
+    app.SetFramesInFlight(options.framesInFlight);
+    app.SetChunking(options.chunkFrames, options.chunkWorkers, options.bCompareChunked);
+    app.SetBenchmark(options.bBenchmark);
+    if (options.bDumpTimeline)
+        app.SetTimelineDump((std::filesystem::path(options.outputDir) / (std::to_string(slide) + "_timeline.csv")).string());
+}
+
+
+bool BatchRenderer::WriteJson(const double& wallSeconds, const uint32_t& jobs) const
+{
+    const std::string path = !m_Options.jsonPath.empty()
+        ? m_Options.jsonPath
+        : (std::filesystem::path(m_Options.outputDir) / "batch.json").string();
+
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for the batch timings\n";
+        return false;
+    }
+
+    uint64_t frames = 0;
+    uint32_t failed = 0;
+
+    file << "{\n  \"slides\": [\n";
+    for (size_t i = 0; i < m_Timings.size(); ++i)
+    {
+        const SlideTiming& t = m_Timings[i];
+        frames += t.frames;
+        failed += t.bOk ? 0 : 1;
+
+        file << "    { \"slide\": " << t.slide
+            << ", \"output\": \"" << EscapeJson(t.output) << '"'
+            << ", \"ok\": " << (t.bOk ? "true" : "false")
+            << ", \"frames\": " << t.frames
+            << ", \"loadSeconds\": " << t.loadSeconds
+            << ", \"renderSeconds\": " << t.renderSeconds
+            << ", \"fps\": " << (t.renderSeconds > 0.0 ? t.frames / t.renderSeconds : 0.0)
+            << " }" << (i + 1 < m_Timings.size() ? "," : "") << "\n";
+    }
+
+    file << "  ],\n  \"summary\": { \"slides\": " << m_Timings.size()
+        << ", \"failed\": " << failed
+        << ", \"jobs\": " << jobs
+        << ", \"width\": " << m_Options.width
+        << ", \"height\": " << m_Options.height
+        << ", \"fps\": " << (int)m_Options.fps
+        << ", \"frames\": " << frames
+        << ", \"wallSeconds\": " << wallSeconds
+        << ", \"framesPerSecond\": " << (wallSeconds > 0.0 ? frames / wallSeconds : 0.0)
+        << " }\n}\n";
+
+    std::cout << "\nBatch: " << frames << " frames from " << m_Timings.size() << " slides in " << wallSeconds
+        << " s (" << (wallSeconds > 0.0 ? frames / wallSeconds : 0.0) << " frames/s), timings written to " << path << "\n";
+    return true;
+}
+
+std::string BatchRenderer::EscapeJson(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+
+bool BatchRenderer::ParseArguments(const int& argc, char** argv, BatchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        // Switches take no value.
+        if (arg == "--vfr")
+        {
+            options.encoder.frameRate = FrameRateMode::Variable;
+            continue;
+        }
+        if (arg == "--compare")
+        {
+            options.bCompareChunked = true;
+            continue;
+        }
+        if (arg == "--benchmark")
+        {
+            options.bBenchmark = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << arg << " needs a value\n";
+            return false;
+        }
+
+        const std::string value = argv[++i];
+        if (arg == "--slides")
+        {
+            if (!ParseSlides(value, options.slides))
+                return false;
+        }
+        else if (arg == "--size")
+        {
+            if (!ParseSize(value, options.width, options.height))
+                return false;
+        }
+        else if (arg == "--fps")
+        {
+            const int fps = std::atoi(value.c_str());
+            if (fps <= 0 || fps > 255)
+            {
+                std::cerr << "Bad frame rate " << value << "\n";
+                return false;
+            }
+            options.fps = (uint8_t)fps;
+        }
+        else if (arg == "--out")
+            options.outputDir = value;
+        else if (arg == "--jobs")
+            options.jobs = (uint32_t)std::max(std::atoi(value.c_str()), 0);
+        else if (arg == "--json")
+            options.jsonPath = value;
+        else if (arg == "--backend")
+        {
+            if (value == "gpu")             options.backend = RenderBackend::GPU;
+            else if (value == "cpu")        options.backend = RenderBackend::CPU;
+            else if (value == "fused")      options.backend = RenderBackend::CPUFused;
+            else if (value == "tiled")      options.backend = RenderBackend::CPUTiled;
+            else
+            {
+                std::cerr << "Unknown backend " << value << "\n";
+                return false;
+            }
+        }
+        else if (arg == "--text")
+        {
+            if (value == "d2d")             options.textBackend = TextBackend::Direct2D;
+            else if (value == "atlas")      options.textBackend = TextBackend::Atlas;
+            else
+            {
+                std::cerr << "Unknown text backend " << value << "\n";
+                return false;
+            }
+        }
+        else if (arg == "--encoder")
+        {
+            if (value == "auto")            options.encoder.backend = EncoderBackend::Auto;
+            else if (value == "hardware")   options.encoder.backend = EncoderBackend::Hardware;
+            else if (value == "software")   options.encoder.backend = EncoderBackend::Software;
+            else
+            {
+                std::cerr << "Unknown encoder " << value << "\n";
+                return false;
+            }
+        }
+        else if (arg == "--codec")
+            options.encoder.codec = value;
+        else if (arg == "--crf")
+            options.encoder.crf = std::atoi(value.c_str());
+        else if (arg == "--preset")
+            options.encoder.preset = value;
+        else if (arg == "--threads")
+            options.encoder.threads = std::max(std::atoi(value.c_str()), 0);
+        else if (arg == "--chunk")
+            options.chunkFrames = (uint32_t)std::max(std::atoi(value.c_str()), 0);
+        else if (arg == "--continuous")
+        {
+            if (!ParseRange(value, options.rangeFirst, options.rangeLast))
+                return false;
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+
+    if (options.rangeFirst > 0 && !options.slides.empty())
+    {
+        std::cerr << "--slides and --continuous cannot be combined\n";
+        return false;
+    }
+    if (options.slides.empty() && options.rangeFirst == 0)
+    {
+        std::cerr << "--slides or --continuous is required\n";
+        return false;
+    }
+
+    return true;
+}
+
+void BatchRenderer::PrintUsage()
+{
+    std::cout <<
+        "Usage: VideoRenderer --slides 1-5,8 [options]\n"
+        "       VideoRenderer --continuous 1-5 [options]\n"
+        "  --slides LIST     slide numbers and inclusive ranges, comma separated\n"
+        "  --continuous A-B  slides A to B back to back into one DIR/A-B.mp4\n"
+        "  --size WxH        output resolution (default 3840x2160; backgrounds must match)\n"
+        "  --fps N           frame rate (default 60)\n"
+        "  --out DIR         output directory (default render)\n"
+        "  --jobs N          slides rendered at once (default 1; at most 2 unless the\n"
+        "                    backend is cpu, fused or tiled and the encoder is software)\n"
+        "  --json FILE       timing report (default DIR/batch.json)\n"
+        "  --backend NAME    gpu, cpu, fused or tiled\n"
+        "  --text NAME       d2d, or atlas to draw code from a glyph cache (fused and tiled)\n"
+        "  --encoder NAME    auto, hardware or software\n"
+        "  --codec NAME      software codec (default libx265)\n"
+        "  --crf N           software quality (default 18)\n"
+        "  --preset NAME     software speed, ultrafast to placebo (default medium); libsvtav1\n"
+        "                    maps these onto its scale or takes a number from -2 to 13\n"
+        "  --threads N       software encoder threads (default 0, the codec decides)\n"
+        "  --vfr             drop held frames instead of encoding them again (variable frame rate)\n"
+        "  --chunk N         encode each slide in chunks of N frames in parallel\n"
+        "  --compare         with --chunk, also render unchunked and report the speedup\n"
+        "  --benchmark       time the CPU compositor paths on each slide before rendering\n"
+        "Without arguments the renderer asks for slide numbers interactively.\n"
+        "VideoRenderer --test checks the CPU compositor against a port of the shader.\n";
+}
+
+bool BatchRenderer::ParseSlides(const std::string& text, std::vector<int>& slides)
+{
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        const size_t end = std::min(text.find(',', start), text.size());
+        const std::string item = text.substr(start, end - start);
+        start = end + 1;
+
+        if (item.empty())
+            continue;
+
+        int first = 0, last = 0;
+        if (!ParseRange(item, first, last))
+            return false;
+
+        for (int n = first; n <= last; ++n)
+            slides.push_back(n);
+    }
+
+    return !slides.empty();
+}
+
+bool BatchRenderer::ParseRange(const std::string& text, int& first, int& last)
+{
+    const size_t dash = text.find('-');
+    first = std::atoi(text.substr(0, dash).c_str());
+    last = dash == std::string::npos ? first : std::atoi(text.substr(dash + 1).c_str());
+    if (first <= 0 || last < first)
+    {
+        std::cerr << "Bad slide range " << text << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool BatchRenderer::ParseSize(const std::string& text, uint16_t& width, uint16_t& height)
+{
+    const size_t x = text.find('x');
+    const int w = x == std::string::npos ? 0 : std::atoi(text.substr(0, x).c_str());
+    const int h = x == std::string::npos ? 0 : std::atoi(text.substr(x + 1).c_str());
+    if (w <= 0 || h <= 0 || w > 65535 || h > 65535 || (w & 1) || (h & 1))
+    {
+        std::cerr << "Bad size " << text << ", expected an even WxH such as 1920x1080\n";
+        return false;
+    }
+
+    width = (uint16_t)w;
+    height = (uint16_t)h;
+    return true;
+}
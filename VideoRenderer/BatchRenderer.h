@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Application.h"
+
+
+struct BatchOptions
+{
+    std::vector<int> slides;
+    uint16_t width = 3840;
+    uint16_t height = 2160;
+    uint8_t fps = 60;
+    std::string outputDir = "render";
+    uint32_t jobs = 1;                  // slides rendered at once, at most one per slide; see MaxDeviceJobs
+    std::string jsonPath;               // empty writes <outputDir>/batch.json
+    int rangeFirst = 0;                 // --continuous: slides [rangeFirst, rangeLast] into one <outputDir>/A-B.mp4
+    int rangeLast = 0;
+
+    RenderBackend backend = RenderBackend::GPU;
+    TextBackend textBackend = TextBackend::Direct2D;
+    OutputFormat outputFormat = OutputFormat::P010;
+    EncoderSettings encoder;
+    uint32_t pipelineDepth = 3;
+    uint32_t framesInFlight = 4;
+    uint32_t chunkFrames = 0;
+    uint32_t chunkWorkers = 4;
+    bool bCompareChunked = false;       // also time the unchunked path for the speedup report
+    bool bDumpTimeline = false;
+    bool bBenchmark = false;            // time the CPU compositor paths on each slide before rendering it
+};
+
+struct SlideTiming
+{
+    int slide = 0;
+    std::string output;
+    uint32_t frames = 0;
+    double loadSeconds = 0.0;
+    double renderSeconds = 0.0;
+    bool bOk = false;
+};
+
+
+// Renders a list of slides without prompting, up to `jobs` at a time, each through its own
+// Application on its own thread. Slides are loaded one after another in list order, since a slide
+// reads the end state the slide before it writes while loading. Rendering then overlaps freely.
+class BatchRenderer
+{
+    private:
+        BatchOptions m_Options;
+        std::vector<SlideTiming> m_Timings;
+
+        std::mutex m_LoadMutex;
+        std::condition_variable m_LoadCV;
+        size_t m_Loaded = 0;
+
+
+    public:
+        // Jobs that render through the GPU backend or encode through NVENC each open their own D3D11
+        // device and encoder session on the same GPU. Consumer drivers cap concurrent NVENC sessions
+        // (at 3 on older ones), and compute dispatches from several devices only queue behind each
+        // other, so --jobs is clamped to this unless both stages run on the CPU.
+        static constexpr uint32_t MaxDeviceJobs = 2;
+
+        explicit BatchRenderer(const BatchOptions& options);
+
+        // False if any slide failed. Timings go to the JSON file either way.
+        bool Run();
+
+        // Applies everything but the slide list to an Application about to render `slide`.
+        static void Configure(Application& app, const BatchOptions& options, const int& slide);
+
+        // argv[1..]; false on anything it does not understand.
+        static bool ParseArguments(const int& argc, char** argv, BatchOptions& options);
+        static void PrintUsage();
+
+
+    private:
+        void RenderSlide(const size_t& index);
+        void MarkLoaded(const size_t& index);
+        bool WriteJson(const double& wallSeconds, const uint32_t& jobs) const;
+
+        static bool ParseSlides(const std::string& text, std::vector<int>& slides);
+        static bool ParseRange(const std::string& text, int& first, int& last);
+        static bool ParseSize(const std::string& text, uint16_t& width, uint16_t& height);
+        static std::string EscapeJson(const std::string& text);
+};
@@ -0,0 +1,220 @@
+#include "CodeGlyphs.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+static GlyphRect UnionRect(const GlyphRect& a, const GlyphRect& b)
+{
+    return GlyphRect { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+}
+
+static GlyphRect OffsetRect(const GlyphRect& rect, const float& x, const float& y)
+{
+    return GlyphRect { rect.left + x, rect.top + y, rect.right + x, rect.bottom + y };
+}
+
+
+void CodeGlyphs::AddRun(const GlyphRun& glyphRun)
+{
+    if (glyphRun.glyphCount == 0 || glyphRun.textLength == 0)
+        return;
+
+    Run run;
+    run.x = glyphRun.x;
+    run.y = glyphRun.y;
+    run.font = glyphRun.font;
+    run.emSize = glyphRun.emSize;
+    run.bidiLevel = glyphRun.bidiLevel;
+    run.color = glyphRun.color;
+    run.textStart = glyphRun.textStart;
+    run.textLength = glyphRun.textLength;
+    run.firstGlyph = (uint32_t)m_Glyphs.size();
+    run.glyphCount = glyphRun.glyphCount;
+    run.firstCluster = (uint32_t)m_ClusterMap.size();
+
+    m_Glyphs.insert(m_Glyphs.end(), glyphRun.glyphs, glyphRun.glyphs + glyphRun.glyphCount);
+    m_ClusterMap.insert(m_ClusterMap.end(), glyphRun.clusters, glyphRun.clusters + glyphRun.textLength);
+
+    float width = 0.0f;
+    for (uint32_t g = 0; g < glyphRun.glyphCount; ++g)
+    {
+        m_Advances.push_back(glyphRun.advances[g]);
+        m_Offsets.push_back(glyphRun.offsets ? glyphRun.offsets[g] : GlyphOffset {});
+        width += glyphRun.advances[g];
+    }
+
+    // Advance box from the font's ascent and descent, with room for overhangs like the layout bounds.
+    const float overhang = 2.0f + 0.1f * run.emSize;
+    run.bounds = GlyphRect
+    {
+        run.x - overhang,
+        run.y - glyphRun.ascent - 2.0f,
+        run.x + width + overhang,
+        run.y + glyphRun.descent + 2.0f
+    };
+
+    m_Runs.push_back(run);
+}
+
+void CodeGlyphs::End()
+{
+    // Left-to-right code comes out in text order already; sorting only guards the binary searches.
+    std::stable_sort(m_Runs.begin(), m_Runs.end(), [](const Run& a, const Run& b) { return a.textStart < b.textStart; });
+
+    m_PrefixBounds.resize(m_Runs.size());
+    for (size_t i = 0; i < m_Runs.size(); ++i)
+        m_PrefixBounds[i] = i == 0 ? m_Runs[i].bounds : UnionRect(m_PrefixBounds[i - 1], m_Runs[i].bounds);
+}
+
+void CodeGlyphs::Clear()
+{
+    m_Runs.clear();
+    m_Glyphs.clear();
+    m_Advances.clear();
+    m_Offsets.clear();
+    m_ClusterMap.clear();
+    m_PrefixBounds.clear();
+}
+
+
+int CodeGlyphs::FindRun(const uint32_t& index) const
+{
+    auto it = std::upper_bound(m_Runs.begin(), m_Runs.end(), index,
+        [](const uint32_t& i, const Run& run) { return i < run.textStart; });
+    return (int)(it - m_Runs.begin()) - 1;
+}
+
+bool CodeGlyphs::FindPrefix(const uint32_t& count, int& last, uint32_t& glyphs) const
+{
+    if (count == 0 || m_Runs.empty())
+        return false;
+
+    last = FindRun(count - 1);
+    if (last < 0)
+        return false;
+
+    // The run holding the last revealed character may continue past it.
+    const Run& run = m_Runs[last];
+    const uint32_t end = count - run.textStart;
+    glyphs = end >= run.textLength ? run.glyphCount : m_ClusterMap[run.firstCluster + end];
+    return true;
+}
+
+bool CodeGlyphs::FindCluster(const uint32_t& index, int& r, uint32_t& first, uint32_t& end) const
+{
+    r = FindRun(index);
+    if (r < 0 || index - m_Runs[r].textStart >= m_Runs[r].textLength)
+        return false;
+
+    const Run& run = m_Runs[r];
+    first = m_ClusterMap[run.firstCluster + index - run.textStart];
+    end = run.glyphCount;
+    for (uint32_t c = index - run.textStart + 1; c < run.textLength; ++c)
+    {
+        if (m_ClusterMap[run.firstCluster + c] != first)
+        {
+            end = m_ClusterMap[run.firstCluster + c];
+            break;
+        }
+    }
+
+    return true;
+}
+
+GlyphRun CodeGlyphs::GetGlyphs(const Run& run, const uint32_t& first, const uint32_t& count) const
+{
+    GlyphRun glyphs;
+    glyphs.x = run.x;
+    glyphs.y = run.y;
+    glyphs.font = run.font;
+    glyphs.emSize = run.emSize;
+    glyphs.bidiLevel = run.bidiLevel;
+    glyphs.color = run.color;
+    glyphs.textStart = run.textStart;
+    glyphs.textLength = run.textLength;
+    glyphs.glyphCount = count;
+    glyphs.glyphs = m_Glyphs.data() + run.firstGlyph + first;
+    glyphs.advances = m_Advances.data() + run.firstGlyph + first;
+    glyphs.offsets = m_Offsets.data() + run.firstGlyph + first;
+
+    for (uint32_t g = 0; g < first; ++g)
+        glyphs.x += m_Advances[run.firstGlyph + g];
+    return glyphs;
+}
+
+void CodeGlyphs::DrawGlyphs(GlyphAtlas& atlas, const GlyphTarget& target, const float& x, const float& y, const GlyphRun& run,
+    const float& opacity) const
+{
+    const GlyphColor color { run.color.r, run.color.g, run.color.b, run.color.a * opacity };
+    const float baseline = std::round(y + run.y);
+    float pen = std::round(x + run.x);
+
+    for (uint32_t g = 0; g < run.glyphCount; ++g)
+    {
+        atlas.DrawGlyph(target, run.font, run.glyphs[g], run.emSize, pen + run.offsets[g].advance,
+            baseline - run.offsets[g].ascender, color);
+        pen += run.advances[g];
+    }
+}
+
+
+void CodeGlyphs::GetPrefix(const uint32_t& count, std::vector<GlyphRun>& runs) const
+{
+    runs.clear();
+
+    int last = -1;
+    uint32_t glyphs = 0;
+    if (!FindPrefix(count, last, glyphs))
+        return;
+
+    for (int r = 0; r < last; ++r)
+        runs.push_back(GetGlyphs(m_Runs[r], 0, m_Runs[r].glyphCount));
+    if (glyphs > 0)
+        runs.push_back(GetGlyphs(m_Runs[last], 0, glyphs));
+}
+
+bool CodeGlyphs::GetCluster(const uint32_t& index, GlyphRun& run) const
+{
+    int r = -1;
+    uint32_t first = 0, end = 0;
+    if (!FindCluster(index, r, first, end))
+        return false;
+
+    run = GetGlyphs(m_Runs[r], first, end - first);
+    return true;
+}
+
+void CodeGlyphs::DrawPrefix(GlyphAtlas& atlas, const GlyphTarget& target, const float& x, const float& y, const uint32_t& count) const
+{
+    int last = -1;
+    uint32_t glyphs = 0;
+    if (!FindPrefix(count, last, glyphs))
+        return;
+
+    for (int r = 0; r < last; ++r)
+        DrawGlyphs(atlas, target, x, y, GetGlyphs(m_Runs[r], 0, m_Runs[r].glyphCount), 1.0f);
+    DrawGlyphs(atlas, target, x, y, GetGlyphs(m_Runs[last], 0, glyphs), 1.0f);
+}
+
+void CodeGlyphs::DrawCluster(GlyphAtlas& atlas, const GlyphTarget& target, const float& x, const float& y, const uint32_t& index,
+    const float& opacity) const
+{
+    GlyphRun run;
+    if (GetCluster(index, run))
+        DrawGlyphs(atlas, target, x, y, run, opacity);
+}
+
+GlyphRect CodeGlyphs::GetPrefixBounds(const float& x, const float& y, const uint32_t& count) const
+{
+    int last = -1;
+    uint32_t glyphs = 0;
+    return FindPrefix(count, last, glyphs) ? OffsetRect(m_PrefixBounds[last], x, y) : GlyphRect {};
+}
+
+GlyphRect CodeGlyphs::GetClusterBounds(const float& x, const float& y, const uint32_t& index) const
+{
+    int r = -1;
+    uint32_t first = 0, end = 0;
+    return FindCluster(index, r, first, end) ? OffsetRect(m_Runs[r].bounds, x, y) : GlyphRect {};
+}
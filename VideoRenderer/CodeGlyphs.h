@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GlyphAtlas.h"
+
+
+// Shift of one glyph from where its pen puts it, along the baseline and up from it.
+struct GlyphOffset
+{
+    float advance = 0.0f;
+    float ascender = 0.0f;
+};
+
+struct GlyphRect
+{
+    float left = 0.0f;
+    float top = 0.0f;
+    float right = 0.0f;
+    float bottom = 0.0f;
+};
+
+// Positioned glyphs in one font, size and color. A GlyphSource hands code over in these, with a
+// cluster map of one entry per code unit holding the first glyph of its cluster, and CodeGlyphs
+// hands them back without the cluster map for drawing. Font ids are those of the GlyphRasterizer
+// the source is paired with.
+struct GlyphRun
+{
+    float x = 0.0f;             // baseline origin of the first glyph
+    float y = 0.0f;
+    uint32_t font = 0;
+    float emSize = 0.0f;
+    float ascent = 0.0f;        // the font's, in pixels, for the bounds
+    float descent = 0.0f;
+    uint32_t bidiLevel = 0;
+    GlyphColor color;
+
+    uint32_t textStart = 0;
+    uint32_t textLength = 0;
+    uint32_t glyphCount = 0;
+    const uint16_t* glyphs = nullptr;
+    const float* advances = nullptr;
+    const GlyphOffset* offsets = nullptr;      // all zero if null
+    const uint16_t* clusters = nullptr;
+};
+
+
+// The code text laid out once into positioned, colored glyph runs, so revealing it character by
+// character only draws glyphs instead of laying the revealed prefix out again every frame. Runs are
+// kept in text order; a prefix of N characters is every run before the one holding character N,
+// plus the glyphs of that run in front of N's cluster. A ligature shows once all of its characters do.
+// Positions are relative to the top-left of the code block and offset by `x`, `y` when drawn.
+class CodeGlyphs
+{
+    private:
+        struct Run
+        {
+            float x = 0.0f;
+            float y = 0.0f;
+            uint32_t font = 0;
+            float emSize = 0.0f;
+            uint32_t bidiLevel = 0;
+            GlyphColor color;
+
+            uint32_t textStart = 0;
+            uint32_t textLength = 0;
+            uint32_t firstGlyph = 0;     // into m_Glyphs, m_Advances and m_Offsets
+            uint32_t glyphCount = 0;
+            uint32_t firstCluster = 0;   // into m_ClusterMap, one entry per character
+            GlyphRect bounds;
+        };
+
+        std::vector<Run> m_Runs;
+        std::vector<uint16_t> m_Glyphs;
+        std::vector<float> m_Advances;
+        std::vector<GlyphOffset> m_Offsets;
+        std::vector<uint16_t> m_ClusterMap;
+        std::vector<GlyphRect> m_PrefixBounds;     // union of the bounds of runs [0, i]
+
+
+    public:
+        // Runs are copied in between Clear and End.
+        void AddRun(const GlyphRun& run);
+        void End();
+        void Clear();
+
+        bool IsEmpty() const { return m_Runs.empty(); }
+        size_t GetRunCount() const { return m_Runs.size(); }
+        size_t GetGlyphCount() const { return m_Glyphs.size(); }
+
+        // Replaces `runs` with what draws characters [0, count), pointing into this object.
+        void GetPrefix(const uint32_t& count, std::vector<GlyphRun>& runs) const;
+        // The cluster holding character `index`; false if there is none.
+        bool GetCluster(const uint32_t& index, GlyphRun& run) const;
+
+        // The same through a glyph atlas onto CPU pixels, the cluster at `opacity`.
+        void DrawPrefix(GlyphAtlas& atlas, const GlyphTarget& target, const float& x, const float& y, const uint32_t& count) const;
+        void DrawCluster(GlyphAtlas& atlas, const GlyphTarget& target, const float& x, const float& y, const uint32_t& index,
+            const float& opacity) const;
+
+        // What the prefix and the cluster cover, or an empty rect.
+        GlyphRect GetPrefixBounds(const float& x, const float& y, const uint32_t& count) const;
+        GlyphRect GetClusterBounds(const float& x, const float& y, const uint32_t& index) const;
+
+
+    private:
+        // Index of the run holding character `index`, or the last run before it; -1 if none.
+        int FindRun(const uint32_t& index) const;
+
+        // Last run of the prefix and how many of its glyphs belong to it; false if nothing is drawn.
+        bool FindPrefix(const uint32_t& count, int& last, uint32_t& glyphs) const;
+        // Run and glyph range [first, end) of the cluster holding character `index`.
+        bool FindCluster(const uint32_t& index, int& run, uint32_t& first, uint32_t& end) const;
+
+        GlyphRun GetGlyphs(const Run& run, const uint32_t& first, const uint32_t& count) const;
+        void DrawGlyphs(GlyphAtlas& atlas, const GlyphTarget& target, const float& x, const float& y, const GlyphRun& run,
+            const float& opacity) const;
+};
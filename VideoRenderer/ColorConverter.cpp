@@ -0,0 +1,537 @@
+#include "ColorConverter.h"
+#include "ThreadPool.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+
+// Row pairs (or row groups of other formats) per thread pool task.
+static constexpr uint32_t BandPairs = 8;
+
+
+static inline void DecodePixel(const uint64_t& p, float& y, float& cb, float& cr)
+{
+    Bt709::RgbToYCbCr
+    (
+        HalfToFloat((uint16_t)p),
+        HalfToFloat((uint16_t)(p >> 16)),
+        HalfToFloat((uint16_t)(p >> 32)),
+        y, cb, cr
+    );
+}
+
+#if VR_SIMD_X86
+
+// Four RGBA16F pixel pairs to planar float. Lanes 0-3 hold the even pixels and lanes 4-7 the odd
+// ones, so the horizontal chroma pair of lane i is lane i + 4.
+VR_TARGET_AVX2 static inline void LoadPlanar8(const uint64_t* p, __m256& r, __m256& g, __m256& b)
+{
+    const __m256 v0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    const __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2)));
+    const __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4)));
+    const __m256 v3 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 6)));
+
+    const __m256 t0 = _mm256_unpacklo_ps(v0, v1);
+    const __m256 t1 = _mm256_unpackhi_ps(v0, v1);
+    const __m256 t2 = _mm256_unpacklo_ps(v2, v3);
+    const __m256 t3 = _mm256_unpackhi_ps(v2, v3);
+
+    r = _mm256_shuffle_ps(t0, t2, 0x44);
+    g = _mm256_shuffle_ps(t0, t2, 0xEE);
+    b = _mm256_shuffle_ps(t1, t3, 0x44);
+}
+
+// Bt709::RgbToYCbCr operation for operation. No FMA: a fused multiply-add rounds once and would
+// drift from the shader's codes.
+VR_TARGET_AVX2 static inline void RgbToYCbCr8(__m256 r, __m256 g, __m256 b, __m256& y, __m256& cb, __m256& cr)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    r = _mm256_min_ps(_mm256_max_ps(r, zero), one);
+    g = _mm256_min_ps(_mm256_max_ps(g, zero), one);
+    b = _mm256_min_ps(_mm256_max_ps(b, zero), one);
+
+    y = _mm256_add_ps
+    (
+        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Bt709::Kr), r), _mm256_mul_ps(_mm256_set1_ps(Bt709::Kg), g)),
+        _mm256_mul_ps(_mm256_set1_ps(Bt709::Kb), b)
+    );
+    cb = _mm256_div_ps(_mm256_sub_ps(b, y), _mm256_set1_ps(Bt709::CbDivisor));
+    cr = _mm256_div_ps(_mm256_sub_ps(r, y), _mm256_set1_ps(Bt709::CrDivisor));
+}
+
+VR_TARGET_AVX2 static inline __m128i QuantizeY8(const __m256& y)
+{
+    const __m256 s = _mm256_min_ps(_mm256_max_ps(y, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    const __m256 v = _mm256_add_ps(_mm256_mul_ps(s, _mm256_set1_ps(876.0f)), _mm256_set1_ps(64.0f));
+    __m256i q = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(v, _mm256_set1_ps(0.5f))));
+    q = _mm256_min_epi32(_mm256_max_epi32(q, _mm256_set1_epi32(64)), _mm256_set1_epi32(940));
+
+    // Back to pixel order: even lanes low, odd lanes high.
+    const __m128i even = _mm256_castsi256_si128(q);
+    const __m128i odd = _mm256_extracti128_si256(q, 1);
+    const __m128i packed = _mm_packus_epi32(_mm_unpacklo_epi32(even, odd), _mm_unpackhi_epi32(even, odd));
+    return _mm_slli_epi16(packed, 6);
+}
+
+VR_TARGET_AVX2 static inline __m128i QuantizeC4(const __m128& c)
+{
+    const __m128 s = _mm_min_ps(_mm_max_ps(c, _mm_set1_ps(-0.5f)), _mm_set1_ps(0.5f));
+    const __m128 v = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(896.0f)), _mm_set1_ps(512.0f));
+    const __m128i q = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(v, _mm_set1_ps(0.5f))));
+    return _mm_min_epi32(_mm_max_epi32(q, _mm_set1_epi32(64)), _mm_set1_epi32(960));
+}
+
+// ((c00 + c10) + c01) + c11, the shader's summation order.
+VR_TARGET_AVX2 static inline __m128 Average4(const __m256& c0, const __m256& c1)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(c0), _mm256_extractf128_ps(c0, 1));
+    s = _mm_add_ps(s, _mm256_castps256_ps128(c1));
+    s = _mm_add_ps(s, _mm256_extractf128_ps(c1, 1));
+    return _mm_mul_ps(s, _mm_set1_ps(0.25f));
+}
+
+VR_TARGET_AVX2 static void ConvertRowPairAVX2(const uint64_t* row0, const uint64_t* row1, const uint32_t& count,
+    uint16_t* lumaOut0, uint16_t* lumaOut1, uint16_t* chromaOut)
+{
+    for (uint32_t x = 0; x + 8 <= count; x += 8)
+    {
+        __m256 r, g, b;
+        __m256 y0, cb0, cr0;
+        __m256 y1, cb1, cr1;
+
+        LoadPlanar8(row0 + x, r, g, b);
+        RgbToYCbCr8(r, g, b, y0, cb0, cr0);
+        LoadPlanar8(row1 + x, r, g, b);
+        RgbToYCbCr8(r, g, b, y1, cb1, cr1);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lumaOut0 + x), QuantizeY8(y0));
+        if (lumaOut1)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lumaOut1 + x), QuantizeY8(y1));
+
+        const __m128i u = QuantizeC4(Average4(cb0, cb1));
+        const __m128i v = QuantizeC4(Average4(cr0, cr1));
+        const __m128i uv = _mm_packus_epi32(_mm_unpacklo_epi32(u, v), _mm_unpackhi_epi32(u, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(chromaOut + x), _mm_slli_epi16(uv, 6));
+    }
+}
+
+VR_TARGET_AVX2 static uint32_t DecodeRowAVX2(const uint64_t* row, const uint32_t& count, float* y, float* cb, float* cr)
+{
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256 r, g, b, yy, u, v;
+        LoadPlanar8(row + x, r, g, b);
+        RgbToYCbCr8(r, g, b, yy, u, v);
+
+        _mm256_storeu_ps(y + x, _mm256_permutevar8x32_ps(yy, order));
+        _mm256_storeu_ps(cb + x, _mm256_permutevar8x32_ps(u, order));
+        _mm256_storeu_ps(cr + x, _mm256_permutevar8x32_ps(v, order));
+    }
+    return x;
+}
+
+// v = clamp(in, lo, hi) * mul + add, rounded half up and clamped to [qmin, qmax]; the template
+// quantizers' arithmetic, eight samples at a time.
+VR_TARGET_AVX2 static uint32_t QuantizeRowAVX2(const float* in, const uint32_t& count, const float& lo, const float& hi,
+    const float& mul, const float& add, const uint32_t& qmin, const uint32_t& qmax, uint32_t* out)
+{
+    const __m256 vLo = _mm256_set1_ps(lo);
+    const __m256 vHi = _mm256_set1_ps(hi);
+    const __m256 vMul = _mm256_set1_ps(mul);
+    const __m256 vAdd = _mm256_set1_ps(add);
+    const __m256 vHalf = _mm256_set1_ps(0.5f);
+    const __m256i vMin = _mm256_set1_epi32((int)qmin);
+    const __m256i vMax = _mm256_set1_epi32((int)qmax);
+
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        const __m256 c = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + x), vLo), vHi);
+        const __m256 v = _mm256_add_ps(_mm256_mul_ps(c, vMul), vAdd);
+        __m256i q = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(v, vHalf)));
+        q = _mm256_min_epi32(_mm256_max_epi32(q, vMin), vMax);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), q);
+    }
+    return x;
+}
+
+#endif
+
+
+// One chroma sample from the decoded rows `c[0..1]`, filtered for the format's siting.
+template <typename Traits>
+static inline float FilterChroma(const float* const* c, const uint32_t& cx, const uint32_t& width)
+{
+    if constexpr (Traits::Siting == ChromaSiting::Center)
+    {
+        static_assert(Traits::ShiftX == 1 && Traits::ShiftY == 1);
+        const uint32_t x = cx * 2;
+        const uint32_t x1 = std::min(x + 1, width - 1);
+        return (c[0][x] + c[0][x1] + c[1][x] + c[1][x1]) * 0.25f;
+    }
+    else if constexpr (Traits::Siting == ChromaSiting::Left)
+    {
+        static_assert(Traits::ShiftX == 1 && Traits::ShiftY == 0);
+        const uint32_t x = cx * 2;
+        const uint32_t left = x > 0 ? x - 1 : 0;
+        const uint32_t right = std::min(x + 1, width - 1);
+        return (c[0][left] + 2.0f * c[0][x] + c[0][right]) * 0.25f;
+    }
+    else
+    {
+        return c[0][cx];
+    }
+}
+
+
+SimdLevel& ColorConverter::GetLevel()
+{
+    static SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+void ColorConverter::DecodeRow(const uint64_t* row, const uint32_t& count, float* y, float* cb, float* cr)
+{
+    uint32_t x = 0;
+
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        x = DecodeRowAVX2(row, count, y, cb, cr);
+#endif
+
+    for (; x < count; ++x)
+        DecodePixel(row[x], y[x], cb[x], cr[x]);
+}
+
+template <uint32_t Bits>
+void ColorConverter::QuantizeRow(const float* in, const uint32_t& count, const bool& bChroma, uint32_t* out)
+{
+    uint32_t x = 0;
+
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+    {
+        constexpr float Scale = (float)(1u << (Bits - 8));
+        x = bChroma
+            ? QuantizeRowAVX2(in, count, -0.5f, 0.5f, 224.0f * Scale, 128.0f * Scale, 16u << (Bits - 8), 240u << (Bits - 8), out)
+            : QuantizeRowAVX2(in, count, 0.0f, 1.0f, 219.0f * Scale, 16.0f * Scale, 16u << (Bits - 8), 235u << (Bits - 8), out);
+    }
+#endif
+
+    for (; x < count; ++x)
+        out[x] = bChroma ? Bt709::QuantizeC<Bits>(in[x]) : Bt709::QuantizeY<Bits>(in[x]);
+}
+
+void ColorConverter::ConvertRowPairScalar(const uint64_t* row0, const uint64_t* row1, const uint32_t& x0,
+    const uint32_t& count, uint16_t* lumaOut0, uint16_t* lumaOut1, uint16_t* chromaOut)
+{
+    for (uint32_t x = x0; x < count; x += 2)
+    {
+        const uint32_t x1 = std::min(x + 1, count - 1);
+
+        float y00, u00, v00;
+        float y10, u10, v10;
+        float y01, u01, v01;
+        float y11, u11, v11;
+
+        DecodePixel(row0[x],  y00, u00, v00);
+        DecodePixel(row0[x1], y10, u10, v10);
+        DecodePixel(row1[x],  y01, u01, v01);
+        DecodePixel(row1[x1], y11, u11, v11);
+
+        lumaOut0[x] = Bt709::PackP010(Bt709::QuantizeY10(y00));
+        if (x1 != x)
+            lumaOut0[x1] = Bt709::PackP010(Bt709::QuantizeY10(y10));
+
+        if (lumaOut1)
+        {
+            lumaOut1[x] = Bt709::PackP010(Bt709::QuantizeY10(y01));
+            if (x1 != x)
+                lumaOut1[x1] = Bt709::PackP010(Bt709::QuantizeY10(y11));
+        }
+
+        const float uAvg = (u00 + u10 + u01 + u11) * 0.25f;
+        const float vAvg = (v00 + v10 + v01 + v11) * 0.25f;
+
+        chromaOut[x]     = Bt709::PackP010(Bt709::QuantizeC10(uAvg));
+        chromaOut[x + 1] = Bt709::PackP010(Bt709::QuantizeC10(vAvg));
+    }
+}
+
+
+void ColorConverter::ConvertRowPair
+(
+    const uint64_t* row0,
+    const uint64_t* row1,
+    const uint32_t& count,
+    uint16_t* lumaOut0,
+    uint16_t* lumaOut1,
+    uint16_t* chromaOut
+)
+{
+    uint32_t x = 0;
+
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+    {
+        ConvertRowPairAVX2(row0, row1, count, lumaOut0, lumaOut1, chromaOut);
+        x = count & ~7u;
+    }
+#endif
+
+    ConvertRowPairScalar(row0, row1, x, count, lumaOut0, lumaOut1, chromaOut);
+}
+
+void ColorConverter::Convert(const CpuFrame& frame, P010Frame& p010)
+{
+    p010.Resize(frame.width, frame.height);
+
+    const uint32_t pairs = (frame.height + 1) / 2;
+    const uint32_t bands = (pairs + BandPairs - 1) / BandPairs;
+
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t end = std::min((band + 1) * BandPairs, pairs);
+        for (uint32_t pair = band * BandPairs; pair < end; ++pair)
+        {
+            const uint32_t y = pair * 2;
+            const bool bHasSecondRow = y + 1 < frame.height;
+
+            ConvertRowPair(frame.Row(y), frame.Row(bHasSecondRow ? y + 1 : y), frame.width,
+                p010.LumaRow(y), bHasSecondRow ? p010.LumaRow(y + 1) : nullptr, p010.ChromaRow(pair));
+        }
+    });
+}
+
+
+template <OutputFormat Format>
+void ColorConverter::ConvertTo(const CpuFrame& frame, YuvFrame& yuv)
+{
+    using Traits = FormatTraits<Format>;
+    using Sample = std::conditional_t<(Traits::BitDepth > 8), uint16_t, uint8_t>;
+
+    constexpr uint32_t Rows = 1u << Traits::ShiftY;
+    constexpr uint32_t Step = Traits::bInterleaved ? 2 : 1;
+
+    yuv.Resize(Format, frame.width, frame.height);
+
+    const uint32_t width = frame.width;
+    const uint32_t height = frame.height;
+    const uint32_t chromaWidth = (width + (1u << Traits::ShiftX) - 1) >> Traits::ShiftX;
+    const uint32_t groups = (height + Rows - 1) / Rows;
+    const uint32_t bands = (groups + BandPairs - 1) / BandPairs;
+
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t end = std::min((band + 1) * BandPairs, groups);
+
+        if constexpr (Format == OutputFormat::P010)
+        {
+            for (uint32_t pair = band * BandPairs; pair < end; ++pair)
+            {
+                const uint32_t y = pair * 2;
+                const bool bHasSecondRow = y + 1 < height;
+
+                ConvertRowPair(frame.Row(y), frame.Row(bHasSecondRow ? y + 1 : y), width, yuv.PlaneRow<uint16_t>(0, y),
+                    bHasSecondRow ? yuv.PlaneRow<uint16_t>(0, y + 1) : nullptr, yuv.PlaneRow<uint16_t>(1, pair));
+            }
+        }
+        else
+        {
+            std::vector<float> scratch((size_t)width * 3 * Rows + (size_t)chromaWidth * 2);
+            std::vector<uint32_t> codes((size_t)std::max(width, chromaWidth * 2));
+            float* filteredCb = scratch.data() + (size_t)width * 3 * Rows;
+            float* filteredCr = filteredCb + chromaWidth;
+            const float* cb[2];
+            const float* cr[2];
+
+            for (uint32_t group = band * BandPairs; group < end; ++group)
+            {
+                const uint32_t y0 = group * Rows;
+
+                for (uint32_t i = 0; i < Rows; ++i)
+                {
+                    float* rowY = scratch.data() + (size_t)width * 3 * i;
+                    float* rowCb = rowY + width;
+                    float* rowCr = rowCb + width;
+                    cb[i] = rowCb;
+                    cr[i] = rowCr;
+
+                    // Past the bottom edge the last row stands in for chroma but gets no luma.
+                    DecodeRow(frame.Row(std::min(y0 + i, height - 1)), width, rowY, rowCb, rowCr);
+                    if (y0 + i >= height)
+                        continue;
+
+                    QuantizeRow<Traits::BitDepth>(rowY, width, false, codes.data());
+
+                    Sample* luma = yuv.PlaneRow<Sample>(0, y0 + i);
+                    for (uint32_t x = 0; x < width; ++x)
+                        luma[x] = (Sample)codes[x];
+                }
+
+                for (uint32_t cx = 0; cx < chromaWidth; ++cx)
+                {
+                    filteredCb[cx] = FilterChroma<Traits>(cb, cx, width);
+                    filteredCr[cx] = FilterChroma<Traits>(cr, cx, width);
+                }
+
+                // Cb and Cr are adjacent in scratch, so one pass quantizes both.
+                QuantizeRow<Traits::BitDepth>(filteredCb, chromaWidth * 2, true, codes.data());
+
+                Sample* outCb = yuv.PlaneRow<Sample>(1, group);
+                Sample* outCr = Traits::bInterleaved ? outCb + 1 : yuv.PlaneRow<Sample>(2, group);
+                for (uint32_t cx = 0; cx < chromaWidth; ++cx)
+                {
+                    outCb[cx * Step] = (Sample)codes[cx];
+                    outCr[cx * Step] = (Sample)codes[chromaWidth + cx];
+                }
+            }
+        }
+    });
+}
+
+template void ColorConverter::ConvertTo<OutputFormat::P010>(const CpuFrame&, YuvFrame&);
+template void ColorConverter::ConvertTo<OutputFormat::NV12>(const CpuFrame&, YuvFrame&);
+template void ColorConverter::ConvertTo<OutputFormat::YUV420P10>(const CpuFrame&, YuvFrame&);
+template void ColorConverter::ConvertTo<OutputFormat::YUV422P10>(const CpuFrame&, YuvFrame&);
+template void ColorConverter::ConvertTo<OutputFormat::YUV444P10>(const CpuFrame&, YuvFrame&);
+
+void ColorConverter::Convert(const CpuFrame& frame, const OutputFormat& format, YuvFrame& yuv)
+{
+    switch (format)
+    {
+        case OutputFormat::P010:        ConvertTo<OutputFormat::P010>(frame, yuv);        break;
+        case OutputFormat::NV12:        ConvertTo<OutputFormat::NV12>(frame, yuv);        break;
+        case OutputFormat::YUV420P10:   ConvertTo<OutputFormat::YUV420P10>(frame, yuv);   break;
+        case OutputFormat::YUV422P10:   ConvertTo<OutputFormat::YUV422P10>(frame, yuv);   break;
+        case OutputFormat::YUV444P10:   ConvertTo<OutputFormat::YUV444P10>(frame, yuv);   break;
+    }
+}
+
+bool ColorConverter::Repack(const P010Frame& p010, const OutputFormat& format, YuvFrame& yuv)
+{
+    if (format != OutputFormat::P010 && format != OutputFormat::NV12 && format != OutputFormat::YUV420P10)
+        return false;
+
+    yuv.Resize(format, p010.width, p010.height);
+
+    const uint32_t chromaWidth = p010.GetChromaWidth();
+    const uint32_t pairs = (p010.height + 1) / 2;
+    const uint32_t bands = (pairs + BandPairs - 1) / BandPairs;
+
+    // 10-bit code in the high bits -> nearest 8-bit code.
+    auto To8 = [](const uint16_t& code) { return (uint8_t)std::min(((code >> 6) + 2) >> 2, 255); };
+
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t end = std::min((band + 1) * BandPairs, pairs);
+        for (uint32_t pair = band * BandPairs; pair < end; ++pair)
+        {
+            const uint16_t* chroma = p010.ChromaRow(pair);
+            switch (format)
+            {
+                case OutputFormat::P010:
+                {
+                    for (uint32_t y = pair * 2; y < std::min(pair * 2 + 2, p010.height); ++y)
+                        std::memcpy(yuv.PlaneRow<uint16_t>(0, y), p010.LumaRow(y), (size_t)p010.width * sizeof(uint16_t));
+                    std::memcpy(yuv.PlaneRow<uint16_t>(1, pair), chroma, (size_t)chromaWidth * 2 * sizeof(uint16_t));
+                    break;
+                }
+                case OutputFormat::NV12:
+                {
+                    for (uint32_t y = pair * 2; y < std::min(pair * 2 + 2, p010.height); ++y)
+                    {
+                        const uint16_t* in = p010.LumaRow(y);
+                        uint8_t* out = yuv.PlaneRow<uint8_t>(0, y);
+                        for (uint32_t x = 0; x < p010.width; ++x)
+                            out[x] = To8(in[x]);
+                    }
+
+                    uint8_t* out = yuv.PlaneRow<uint8_t>(1, pair);
+                    for (uint32_t i = 0; i < chromaWidth * 2; ++i)
+                        out[i] = To8(chroma[i]);
+                    break;
+                }
+                default:
+                {
+                    for (uint32_t y = pair * 2; y < std::min(pair * 2 + 2, p010.height); ++y)
+                    {
+                        const uint16_t* in = p010.LumaRow(y);
+                        uint16_t* out = yuv.PlaneRow<uint16_t>(0, y);
+                        for (uint32_t x = 0; x < p010.width; ++x)
+                            out[x] = in[x] >> 6;
+                    }
+
+                    uint16_t* cb = yuv.PlaneRow<uint16_t>(1, pair);
+                    uint16_t* cr = yuv.PlaneRow<uint16_t>(2, pair);
+                    for (uint32_t cx = 0; cx < chromaWidth; ++cx)
+                    {
+                        cb[cx] = chroma[cx * 2] >> 6;
+                        cr[cx] = chroma[cx * 2 + 1] >> 6;
+                    }
+                    break;
+                }
+            }
+        }
+    });
+
+    return true;
+}
+
+
+void ColorConverter::ConvertReference(const CpuFrame& frame, P010Frame& p010)
+{
+    p010.Resize(frame.width, frame.height);
+
+    auto Load = [&](uint32_t x, uint32_t y, float& yy, float& cb, float& cr)
+    {
+        DecodePixel(frame.Row(std::min(y, frame.height - 1))[std::min(x, frame.width - 1)], yy, cb, cr);
+    };
+
+    for (uint32_t y = 0; y < frame.height; ++y)
+    {
+        for (uint32_t x = 0; x < frame.width; ++x)
+        {
+            float yy, cb, cr;
+            Load(x, y, yy, cb, cr);
+            p010.LumaRow(y)[x] = Bt709::PackP010(Bt709::QuantizeY10(yy));
+        }
+    }
+
+    for (uint32_t cy = 0; cy < (frame.height + 1) / 2; ++cy)
+    {
+        for (uint32_t cx = 0; cx < p010.GetChromaWidth(); ++cx)
+        {
+            float yy, u00, v00, u10, v10, u01, v01, u11, v11;
+            Load(cx * 2,     cy * 2,     yy, u00, v00);
+            Load(cx * 2 + 1, cy * 2,     yy, u10, v10);
+            Load(cx * 2,     cy * 2 + 1, yy, u01, v01);
+            Load(cx * 2 + 1, cy * 2 + 1, yy, u11, v11);
+
+            p010.ChromaRow(cy)[cx * 2]     = Bt709::PackP010(Bt709::QuantizeC10((u00 + u10 + u01 + u11) * 0.25f));
+            p010.ChromaRow(cy)[cx * 2 + 1] = Bt709::PackP010(Bt709::QuantizeC10((v00 + v10 + v01 + v11) * 0.25f));
+        }
+    }
+}
+
+uint64_t ColorConverter::CountMismatches(const CpuFrame& frame, const P010Frame& p010)
+{
+    P010Frame reference;
+    ConvertReference(frame, reference);
+
+    if (p010.width != reference.width || p010.height != reference.height)
+        return (uint64_t)reference.luma.size() + reference.chroma.size();
+
+    uint64_t mismatches = 0;
+    for (size_t i = 0; i < reference.luma.size(); ++i)
+        mismatches += p010.luma[i] != reference.luma[i];
+    for (size_t i = 0; i < reference.chroma.size(); ++i)
+        mismatches += p010.chroma[i] != reference.chroma[i];
+    return mismatches;
+}
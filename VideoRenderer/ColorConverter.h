@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "CpuFrame.h"
+#include "Simd.h"
+
+
+// Scalar mirror of the limited-range BT.709 math in VideoEncoder's RGBA16F -> P010 shader. Every
+// step is evaluated in float, in the shader's order, so the 10-bit codes match it exactly.
+namespace Bt709
+{
+    inline constexpr float Kr = 0.2126f;
+    inline constexpr float Kb = 0.0722f;
+    inline constexpr float Kg = 1.0f - Kr - Kb;
+    inline constexpr float CbDivisor = 2.0f * (1.0f - Kb);
+    inline constexpr float CrDivisor = 2.0f * (1.0f - Kr);
+
+    // NaN goes to the lower bound, like HLSL saturate/clamp and the SSE min/max ordering.
+    inline float Saturate(const float& v) { return v > 0.0f ? std::min(v, 1.0f) : 0.0f; }
+    inline float ClampChroma(const float& c) { return c > -0.5f ? std::min(c, 0.5f) : -0.5f; }
+
+    inline void RgbToYCbCr(float r, float g, float b, float& y, float& cb, float& cr)
+    {
+        r = Saturate(r);
+        g = Saturate(g);
+        b = Saturate(b);
+
+        y = Kr * r + Kg * g + Kb * b;
+        cb = (b - y) / CbDivisor;
+        cr = (r - y) / CrDivisor;
+    }
+
+    inline uint32_t QuantizeY10(const float& y01)
+    {
+        const float v = Saturate(y01) * 876.0f + 64.0f;
+        const uint32_t q = (uint32_t)std::floor(v + 0.5f);
+        return std::clamp(q, 64u, 940u);
+    }
+
+    inline uint32_t QuantizeC10(const float& c)
+    {
+        const float v = ClampChroma(c) * 896.0f + 512.0f;
+        const uint32_t q = (uint32_t)std::floor(v + 0.5f);
+        return std::clamp(q, 64u, 960u);
+    }
+
+    inline uint16_t PackP010(const uint32_t& code10) { return (uint16_t)((code10 & 1023u) << 6); }
+
+    // Limited-range codes at any bit depth: 16-235 / 16-240 scaled by 2^(bits - 8). At 10 bits these
+    // are exactly QuantizeY10 / QuantizeC10.
+    template <uint32_t Bits>
+    inline uint32_t QuantizeY(const float& y01)
+    {
+        constexpr float Scale = (float)(1u << (Bits - 8));
+        const float v = Saturate(y01) * (219.0f * Scale) + 16.0f * Scale;
+        const uint32_t q = (uint32_t)std::floor(v + 0.5f);
+        return std::clamp(q, 16u << (Bits - 8), 235u << (Bits - 8));
+    }
+
+    template <uint32_t Bits>
+    inline uint32_t QuantizeC(const float& c)
+    {
+        constexpr float Scale = (float)(1u << (Bits - 8));
+        const float v = ClampChroma(c) * (224.0f * Scale) + 128.0f * Scale;
+        const uint32_t q = (uint32_t)std::floor(v + 0.5f);
+        return std::clamp(q, 16u << (Bits - 8), 240u << (Bits - 8));
+    }
+}
+
+
+class ColorConverter
+{
+    public:
+        // Converts `count` RGBA16F pixels of two vertically adjacent rows. Every pixel is converted
+        // once; its Cb/Cr feed the 2x2 average directly. When count is odd the last column is
+        // duplicated, and passing row1 == row0 with lumaOut1 == nullptr handles an odd last row, the
+        // same edge clamping the shader does. Uses F16C + AVX2 when available.
+        static void ConvertRowPair
+        (
+            const uint64_t* row0,
+            const uint64_t* row1,
+            const uint32_t& count,
+            uint16_t* lumaOut0,
+            uint16_t* lumaOut1,
+            uint16_t* chromaOut
+        );
+
+        // Whole frame, threaded across bands of row pairs.
+        static void Convert(const CpuFrame& frame, P010Frame& p010);
+
+        // Compile-time specialized conversion to any OutputFormat, threaded like Convert. Each row is
+        // converted to float Y/Cb/Cr once, then chroma is filtered per FormatTraits::Siting. P010
+        // routes to the row-pair kernel above.
+        template <OutputFormat Format>
+        static void ConvertTo(const CpuFrame& frame, YuvFrame& yuv);
+
+        // Dispatches to ConvertTo for `format`.
+        static void Convert(const CpuFrame& frame, const OutputFormat& format, YuvFrame& yuv);
+
+        // P010 into another 4:2:0 layout: a copy for P010, lossless for yuv420p10, rounded to 8 bits
+        // for NV12. False for formats with more chroma than P010 carries.
+        static bool Repack(const P010Frame& p010, const OutputFormat& format, YuvFrame& yuv);
+
+        // Straight port of the encoder's CSMain, recomputing YCbCr for every 2x2 chroma sample.
+        static void ConvertReference(const CpuFrame& frame, P010Frame& p010);
+        static uint64_t CountMismatches(const CpuFrame& frame, const P010Frame& p010);
+
+        static SimdLevel GetSimdLevel() { return GetLevel(); }
+        static void SetSimdLevel(const SimdLevel& level) { GetLevel() = level; }
+
+
+    private:
+        static SimdLevel& GetLevel();
+
+        template <uint32_t Bits>
+        static void QuantizeRow(const float* in, const uint32_t& count, const bool& bChroma, uint32_t* out);
+
+        static void DecodeRow(const uint64_t* row, const uint32_t& count, float* y, float* cb, float* cr);
+
+        static void ConvertRowPairScalar(const uint64_t* row0, const uint64_t* row1, const uint32_t& x0,
+            const uint32_t& count, uint16_t* lumaOut0, uint16_t* lumaOut1, uint16_t* chromaOut);
+};
@@ -0,0 +1,540 @@
+#include "CompositorTest.h"
+#include "ColorConverter.h"
+#include "KeyframeCurve.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+// A closed window, small and large ones, fractional sizes, a hold and a window larger than the
+// frame. Taken in order they also drive the incremental paths from one geometry to the next.
+static const CompositeParams TestParams[] =
+{
+    { 0.0f, 0.0f, 0.0f },
+    { 0.25f, 180.0f, 120.0f },
+    { 0.5f, 640.5f, 360.25f },
+    { 0.731f, 853.37f, 411.9f },
+    { 1.0f, 1000.0f, 560.0f },
+    { 1.0f, 1000.0f, 560.0f },
+    { 1.0f, 1400.0f, 900.0f },
+    { 0.1f, 40.0f, 30.0f }
+};
+static constexpr size_t TestCount = sizeof(TestParams) / sizeof(TestParams[0]);
+
+static constexpr OutputFormat TestFormats[] =
+{
+    OutputFormat::P010, OutputFormat::NV12, OutputFormat::YUV420P10, OutputFormat::YUV422P10, OutputFormat::YUV444P10
+};
+
+// ShapeCS.hlsl's traffic-light colors, in shader order.
+static const float CircleColors[3][4] =
+{
+    { 1.0f, 0.3686f, 0.3412f, 1.0f },
+    { 1.0f, 0.7294f, 0.1804f, 1.0f },
+    { 0.1569f, 0.7882f, 0.2549f, 1.0f }
+};
+
+
+// What the R16G16B16A16_FLOAT store does: round to nearest even. Only non-negative values below 2
+// occur here, the smallest of them from blends as half subnormals.
+static uint16_t ToHalf(const float& value)
+{
+    if (value < 0x1p-14f)
+        return (uint16_t)std::nearbyint(std::ldexp(value, 24));
+
+    int exponent = 0;
+    const float mantissa = std::frexp(value, &exponent);
+    float significand = std::nearbyint(std::ldexp(mantissa, 11));
+    if (significand == 2048.0f)
+    {
+        significand = 1024.0f;
+        ++exponent;
+    }
+
+    return (uint16_t)(((uint32_t)(exponent + 14) << 10) | ((uint32_t)significand - 1024u));
+}
+
+static float FromHalf(const uint16_t& half)
+{
+    const uint32_t exponent = (half >> 10) & 0x1Fu;
+    const uint32_t fraction = half & 0x3FFu;
+    if (exponent == 0)
+        return std::ldexp((float)fraction, -24);
+
+    return std::ldexp((float)(1024u + fraction), (int)exponent - 25);
+}
+
+
+bool CompositorTest::Run()
+{
+    std::cout << "Compositor test: " << Width << "x" << Height << ", " << TestCount << " geometries\n";
+
+    CpuImage background;
+    CpuImage blurred;
+    MakeLayer(1, background);
+    MakeLayer(2, blurred);
+
+    std::vector<uint8_t> overlayPixels;
+    CpuOverlay overlay {};
+    MakeOverlay(overlayPixels, overlay);
+
+    CpuCompositor compositor(Width, Height);
+    if (!compositor.SetLayers(background, blurred))
+        return false;
+
+    std::vector<CpuFrame> expected(TestCount);
+    std::vector<CpuFrame> expectedText(TestCount);
+    std::vector<P010Frame> expectedP010(TestCount);
+    for (size_t i = 0; i < TestCount; ++i)
+    {
+        ComposeExpected(TestParams[i], background, blurred, CpuOverlay {}, expected[i]);
+        ComposeExpected(TestParams[i], background, blurred, overlay, expectedText[i]);
+        ColorConverter::ConvertReference(expectedText[i], expectedP010[i]);
+    }
+
+    // Converter input: a composited frame, and noise of odd size past 1.0 for the edges and clamps.
+    CpuFrame noise;
+    MakeNoise(3, 333, 77, noise);
+    const CpuFrame* converterFrames[2] = { &expectedText[TestCount / 2], &noise };
+
+    std::vector<YuvFrame> expectedYuv;
+    for (OutputFormat format : TestFormats)
+    {
+        for (const CpuFrame* pFrame : converterFrames)
+        {
+            expectedYuv.emplace_back();
+            ConvertExpected(*pFrame, format, expectedYuv.back());
+        }
+    }
+
+    const SimdLevel detected = compositor.GetSimdLevel();
+    const SimdLevel converterLevel = ColorConverter::GetSimdLevel();
+    bool bPassed = true;
+
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2 })
+    {
+        if ((uint8_t)level > (uint8_t)detected)
+            continue;
+
+        const std::string name = GetSimdLevelName(level);
+        compositor.SetSimdLevel(level);
+        ColorConverter::SetSimdLevel(std::min(level, converterLevel));
+
+        for (CompositeMode mode : { CompositeMode::PerPixel, CompositeMode::Spans })
+        {
+            compositor.SetMode(mode);
+
+            uint64_t differing = 0;
+            CpuFrame frame;
+            for (size_t i = 0; i < TestCount; ++i)
+            {
+                compositor.Composite(TestParams[i], frame);
+                differing += CountDiffering(expected[i], frame);
+            }
+
+            bPassed &= Report(name + (mode == CompositeMode::Spans ? " composite, spans" : " composite, per pixel"), differing);
+        }
+
+        // The renderer's paths, each carrying its buffers from one geometry to the next and
+        // rewriting only the region it would.
+        uint64_t incremental = 0;
+        uint64_t blended = 0;
+        uint64_t fused = 0;
+        uint64_t tiled = 0;
+
+        CpuFrame composite;
+        CpuFrame output;
+        P010Frame fusedP010;
+        P010Frame tiledP010;
+        TiledFrame tiles;
+        compositor.InvalidateHistory();
+
+        for (size_t i = 0; i < TestCount; ++i)
+        {
+            DirtyRect dirty = compositor.CompositeIncremental(TestParams[i], composite);
+            incremental += CountDiffering(expected[i], composite);
+
+            dirty.Union(overlay.rect);
+            compositor.BlendOverlay(composite, overlay, dirty, output);
+            blended += CountDiffering(expectedText[i], output);
+
+            DirtyRect region { 0, 0, Width, Height };
+            if (i > 0)
+            {
+                region = CpuCompositor::GetShapeBounds(TestParams[i - 1], Width, Height);
+                region.Union(CpuCompositor::GetShapeBounds(TestParams[i], Width, Height));
+                region.Union(overlay.rect);
+            }
+            else
+            {
+                fusedP010.Resize(Width, Height);
+                tiledP010.Resize(Width, Height);
+                tiles.Resize(Width, Height);
+            }
+
+            compositor.CompositeP010(TestParams[i], overlay, region, fusedP010);
+            fused += CountDiffering(expectedP010[i], fusedP010);
+
+            compositor.CompositeTiles(TestParams[i], overlay, region, tiles, tiledP010);
+            tiled += CountDiffering(expectedP010[i], tiledP010);
+        }
+
+        bPassed &= Report(name + " incremental", incremental);
+        bPassed &= Report(name + " incremental + overlay", blended);
+        bPassed &= Report(name + " fused P010", fused);
+        bPassed &= Report(name + " tiled P010", tiled);
+
+        size_t e = 0;
+        for (OutputFormat format : TestFormats)
+        {
+            uint64_t converted = 0;
+            YuvFrame yuv;
+            for (const CpuFrame* pFrame : converterFrames)
+            {
+                ColorConverter::Convert(*pFrame, format, yuv);
+                converted += CountDiffering(expectedYuv[e++], yuv);
+            }
+
+            bPassed &= Report(name + " convert " + GetFormatInfo(format).name, converted);
+        }
+    }
+
+    // P010 repacked for the encoder, against the reference conversion straight to each format.
+    for (OutputFormat format : TestFormats)
+    {
+        const bool bRepackable = GetFormatInfo(format).shiftY == 1;
+        uint64_t repacked = 0;
+        for (size_t i = 0; i < TestCount; ++i)
+        {
+            YuvFrame expectedRepack;
+            YuvFrame yuv;
+            const bool bRepacked = ColorConverter::Repack(expectedP010[i], format, yuv);
+            if (bRepacked != bRepackable)
+            {
+                repacked += 1;
+                continue;
+            }
+            if (!bRepacked)
+                continue;
+
+            RepackExpected(expectedP010[i], format, expectedRepack);
+            repacked += CountDiffering(expectedRepack, yuv);
+        }
+
+        bPassed &= Report(std::string("repack ") + GetFormatInfo(format).name + (bRepackable ? "" : " (refused)"), repacked);
+    }
+
+    ColorConverter::SetSimdLevel(converterLevel);
+
+    // The baked double-back tables, within the error KeyframeCurve.h states for them.
+    bPassed &= ReportError("curve table, in double-back", InAEDoubleBackTable.MaxError(InAEDoubleBackCurve, 65537),
+        CurveTableMaxError);
+    bPassed &= ReportError("curve table, out double-back", OutAEDoubleBackTable.MaxError(OutAEDoubleBackCurve, 65537),
+        CurveTableMaxError);
+
+    std::cout << (bPassed ? "Compositor test passed\n" : "Compositor test FAILED\n");
+    return bPassed;
+}
+
+
+void CompositorTest::MakeLayer(const uint32_t& seed, CpuImage& image)
+{
+    std::shared_ptr<uint32_t[]> pixels(new uint32_t[(size_t)Width * Height]);
+
+    // xorshift32: every channel value shows up, neighbours are unrelated.
+    uint32_t state = 0x9E3779B9u * seed;
+    for (size_t i = 0; i < (size_t)Width * Height; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        pixels[i] = state;
+    }
+
+    image.width = Width;
+    image.height = Height;
+    image.pixels = pixels;
+}
+
+void CompositorTest::MakeNoise(const uint32_t& seed, const uint32_t& width, const uint32_t& height, CpuFrame& frame)
+{
+    frame.Resize(width, height);
+
+    uint32_t state = 0x9E3779B9u * seed;
+    for (uint64_t& pixel : frame.pixels)
+    {
+        pixel = 0;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            pixel |= (uint64_t)ToHalf((float)(state >> 8) * 0x1p-24f * 1.25f) << (16 * c);
+        }
+    }
+}
+
+void CompositorTest::MakeOverlay(std::vector<uint8_t>& pixels, CpuOverlay& overlay)
+{
+    // Premultiplied text-like coverage over part of the window, from transparent to opaque.
+    overlay.rect = DirtyRect { 300, 200, 980, 520 };
+    overlay.pitch = (size_t)(overlay.rect.x1 - overlay.rect.x0) * 4;
+    pixels.assign(overlay.pitch * (overlay.rect.y1 - overlay.rect.y0), 0);
+
+    for (uint32_t y = overlay.rect.y0; y < overlay.rect.y1; ++y)
+    {
+        uint8_t* row = pixels.data() + (size_t)(y - overlay.rect.y0) * overlay.pitch;
+        for (uint32_t x = overlay.rect.x0; x < overlay.rect.x1; ++x)
+        {
+            uint8_t* p = row + (size_t)(x - overlay.rect.x0) * 4;
+            const uint32_t alpha = (x * 7 + y * 13) % 256;
+            p[0] = (uint8_t)(alpha * ((x >> 3) % 4) / 3);
+            p[1] = (uint8_t)(alpha * ((y >> 2) % 3) / 2);
+            p[2] = (uint8_t)alpha;
+            p[3] = (uint8_t)alpha;
+        }
+    }
+
+    overlay.pixels = pixels.data();
+}
+
+
+void CompositorTest::ComposeExpected(const CompositeParams& params, const CpuImage& background, const CpuImage& blurred,
+    const CpuOverlay& overlay, CpuFrame& frame)
+{
+    frame.Resize(Width, Height);
+
+    for (uint32_t y = 0; y < Height; ++y)
+    {
+        for (uint32_t x = 0; x < Width; ++x)
+        {
+            uint64_t pixel = ShadeExpected(params, x, y, background.Row(y)[x], blurred.Row(y)[x]);
+
+            const bool bInOverlay = !overlay.IsEmpty() && x >= overlay.rect.x0 && x < overlay.rect.x1
+                && y >= overlay.rect.y0 && y < overlay.rect.y1;
+            if (bInOverlay)
+            {
+                // D2D's premultiplied source-over, B8G8R8A8 onto RGBA.
+                const uint8_t* p = overlay.pixels + (size_t)(y - overlay.rect.y0) * overlay.pitch
+                    + (size_t)(x - overlay.rect.x0) * 4;
+                const float alpha = p[3] / 255.0f;
+                const float inverse = 1.0f - alpha;
+                const float source[4] = { p[2] / 255.0f, p[1] / 255.0f, p[0] / 255.0f, alpha };
+
+                uint64_t blended = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float value = source[c] + FromHalf((uint16_t)(pixel >> (16 * c))) * inverse;
+                    blended |= (uint64_t)ToHalf(value) << (16 * c);
+                }
+                pixel = blended;
+            }
+
+            frame.Row(y)[x] = pixel;
+        }
+    }
+}
+
+uint64_t CompositorTest::ShadeExpected(const CompositeParams& params, const uint32_t& x, const uint32_t& y,
+    const uint32_t& background, const uint32_t& blurred)
+{
+    // CSMain with sdRoundRect and sdCircle inlined as the shader writes them.
+    const float px = (float)x;
+    const float py = (float)y;
+    const float centerX = Width * 0.5f;
+    const float centerY = Height * 0.5f;
+    const float cornerRadius = 100.0f * params.scale;
+
+    const float dx = std::fabs(px - centerX) - (params.sizeX * 0.5f - cornerRadius);
+    const float dy = std::fabs(py - centerY) - (params.sizeY * 0.5f - cornerRadius);
+    const float ox = std::max(dx, 0.0f);
+    const float oy = std::max(dy, 0.0f);
+    const float dRect = std::sqrt(ox * ox + oy * oy) + std::min(std::max(dx, dy), 0.0f) - cornerRadius;
+
+    const uint32_t texel = dRect <= 0.0f ? blurred : background;
+    float color[4];
+    for (int c = 0; c < 4; ++c)
+        color[c] = ((texel >> (8 * c)) & 0xFF) / 255.0f;
+
+    const float topLeftX = centerX - params.sizeX * 0.5f + cornerRadius;
+    const float topLeftY = centerY - params.sizeY * 0.5f + cornerRadius;
+    const float circleRadius = 25.0f * params.scale;
+    const float circleOffsets[3] = { 0.0f, 75.0f * params.scale, 150.0f * params.scale };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const float cx = px - (topLeftX + circleOffsets[i]);
+        const float cy = py - topLeftY;
+        if (std::sqrt(cx * cx + cy * cy) - circleRadius <= 0.0f)
+        {
+            for (int c = 0; c < 4; ++c)
+                color[c] = CircleColors[i][c];
+        }
+    }
+
+    uint64_t pixel = 0;
+    for (int c = 0; c < 4; ++c)
+        pixel |= (uint64_t)ToHalf(color[c]) << (16 * c);
+    return pixel;
+}
+
+
+void CompositorTest::ConvertExpected(const CpuFrame& frame, const OutputFormat& format, YuvFrame& yuv)
+{
+    const FormatInfo info = GetFormatInfo(format);
+    yuv.Resize(format, frame.width, frame.height);
+
+    auto Load = [&](const uint32_t& x, const uint32_t& y, float& yy, float& cb, float& cr)
+    {
+        const uint64_t p = frame.Row(std::min(y, frame.height - 1))[std::min(x, frame.width - 1)];
+        Bt709::RgbToYCbCr(FromHalf((uint16_t)p), FromHalf((uint16_t)(p >> 16)), FromHalf((uint16_t)(p >> 32)), yy, cb, cr);
+    };
+    auto Store = [&](const uint32_t& plane, const uint32_t& y, const uint32_t& i, const float& value, const bool& bChroma)
+    {
+        if (info.bitDepth == 8)
+        {
+            yuv.PlaneRow<uint8_t>(plane, y)[i] = (uint8_t)(bChroma ? Bt709::QuantizeC<8>(value) : Bt709::QuantizeY<8>(value));
+            return;
+        }
+
+        const uint32_t code = bChroma ? Bt709::QuantizeC<10>(value) : Bt709::QuantizeY<10>(value);
+        yuv.PlaneRow<uint16_t>(plane, y)[i] = (uint16_t)(info.bMsbAligned ? code << 6 : code);
+    };
+
+    for (uint32_t y = 0; y < frame.height; ++y)
+    {
+        for (uint32_t x = 0; x < frame.width; ++x)
+        {
+            float yy, cb, cr;
+            Load(x, y, yy, cb, cr);
+            Store(0, y, x, yy, false);
+        }
+    }
+
+    const uint32_t chromaWidth = (frame.width + (1u << info.shiftX) - 1) >> info.shiftX;
+    const uint32_t chromaHeight = (frame.height + (1u << info.shiftY) - 1) >> info.shiftY;
+    for (uint32_t cy = 0; cy < chromaHeight; ++cy)
+    {
+        for (uint32_t cx = 0; cx < chromaWidth; ++cx)
+        {
+            // 4:2:0 averages the 2x2 block, 4:2:2 sits on the even column with [1 2 1] / 4, and
+            // samples past the edges repeat the last row and column.
+            float yy, cb = 0.0f, cr = 0.0f;
+            if (info.siting == ChromaSiting::Center)
+            {
+                float u00, v00, u10, v10, u01, v01, u11, v11;
+                Load(cx * 2,     cy * 2,     yy, u00, v00);
+                Load(cx * 2 + 1, cy * 2,     yy, u10, v10);
+                Load(cx * 2,     cy * 2 + 1, yy, u01, v01);
+                Load(cx * 2 + 1, cy * 2 + 1, yy, u11, v11);
+                cb = (u00 + u10 + u01 + u11) * 0.25f;
+                cr = (v00 + v10 + v01 + v11) * 0.25f;
+            }
+            else if (info.siting == ChromaSiting::Left)
+            {
+                float ul, vl, uc, vc, ur, vr;
+                Load(cx > 0 ? cx * 2 - 1 : 0, cy, yy, ul, vl);
+                Load(cx * 2,                  cy, yy, uc, vc);
+                Load(cx * 2 + 1,              cy, yy, ur, vr);
+                cb = (ul + 2.0f * uc + ur) * 0.25f;
+                cr = (vl + 2.0f * vc + vr) * 0.25f;
+            }
+            else
+            {
+                Load(cx, cy, yy, cb, cr);
+            }
+
+            Store(1, cy, info.bInterleaved ? cx * 2 : cx, cb, true);
+            Store(info.bInterleaved ? 1 : 2, cy, info.bInterleaved ? cx * 2 + 1 : cx, cr, true);
+        }
+    }
+}
+
+void CompositorTest::RepackExpected(const P010Frame& p010, const OutputFormat& format, YuvFrame& yuv)
+{
+    const FormatInfo info = GetFormatInfo(format);
+    yuv.Resize(format, p010.width, p010.height);
+
+    // 10-bit codes to nearest 8-bit ones, or moved to the low bits.
+    auto Store = [&](const uint32_t& plane, const uint32_t& y, const uint32_t& i, const uint16_t& sample)
+    {
+        const uint32_t code = sample >> 6;
+        if (info.bitDepth == 8)
+            yuv.PlaneRow<uint8_t>(plane, y)[i] = (uint8_t)std::min((code + 2) / 4, 255u);
+        else
+            yuv.PlaneRow<uint16_t>(plane, y)[i] = (uint16_t)(info.bMsbAligned ? sample : code);
+    };
+
+    for (uint32_t y = 0; y < p010.height; ++y)
+    {
+        for (uint32_t x = 0; x < p010.width; ++x)
+            Store(0, y, x, p010.LumaRow(y)[x]);
+    }
+
+    for (uint32_t cy = 0; cy < (p010.height + 1) / 2; ++cy)
+    {
+        for (uint32_t cx = 0; cx < p010.GetChromaWidth(); ++cx)
+        {
+            Store(1, cy, info.bInterleaved ? cx * 2 : cx, p010.ChromaRow(cy)[cx * 2]);
+            Store(info.bInterleaved ? 1 : 2, cy, info.bInterleaved ? cx * 2 + 1 : cx, p010.ChromaRow(cy)[cx * 2 + 1]);
+        }
+    }
+}
+
+
+uint64_t CompositorTest::CountDiffering(const CpuFrame& expected, const CpuFrame& actual)
+{
+    if (actual.width != expected.width || actual.height != expected.height)
+        return (uint64_t)expected.width * expected.height;
+
+    uint64_t differing = 0;
+    for (size_t i = 0; i < expected.pixels.size(); ++i)
+        differing += expected.pixels[i] != actual.pixels[i] ? 1 : 0;
+    return differing;
+}
+
+uint64_t CompositorTest::CountDiffering(const P010Frame& expected, const P010Frame& actual)
+{
+    if (actual.width != expected.width || actual.height != expected.height)
+        return expected.luma.size() + expected.chroma.size();
+
+    uint64_t differing = 0;
+    for (size_t i = 0; i < expected.luma.size(); ++i)
+        differing += expected.luma[i] != actual.luma[i] ? 1 : 0;
+    for (size_t i = 0; i < expected.chroma.size(); ++i)
+        differing += expected.chroma[i] != actual.chroma[i] ? 1 : 0;
+    return differing;
+}
+
+uint64_t CompositorTest::CountDiffering(const YuvFrame& expected, const YuvFrame& actual)
+{
+    uint64_t differing = 0;
+    for (uint32_t plane = 0; plane < 3; ++plane)
+    {
+        if (actual.planes[plane].size() != expected.planes[plane].size())
+            return expected.planes[0].size() + expected.planes[1].size() + expected.planes[2].size();
+
+        for (size_t i = 0; i < expected.planes[plane].size(); ++i)
+            differing += expected.planes[plane][i] != actual.planes[plane][i] ? 1 : 0;
+    }
+    return differing;
+}
+
+bool CompositorTest::Report(const std::string& check, const uint64_t& differing)
+{
+    std::cout << "  " << check << ": ";
+    if (differing == 0)
+        std::cout << "ok\n";
+    else
+        std::cout << differing << " differ\n";
+    return differing == 0;
+}
+
+bool CompositorTest::ReportError(const std::string& check, const float& error, const float& bound)
+{
+    std::cout << "  " << check << ": max error " << error << (error <= bound ? ", ok\n" : ", above the bound\n");
+    return error <= bound;
+}
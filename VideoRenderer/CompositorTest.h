@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "CpuCompositor.h"
+
+
+// Pixel test of the CPU compositor over fixed window geometries and synthetic layers. The expected
+// frames come from a float port of ShapeCS.hlsl's CSMain written against the shader, sharing no code
+// with CpuCompositor. Every SIMD level, composite mode and output path has to match it exactly.
+// ColorConverter's output formats and P010 repacking are checked against per-sample ports at every
+// SIMD level, and the baked curve tables against their curves. Run with VideoRenderer --test.
+class CompositorTest
+{
+    public:
+        static constexpr uint32_t Width = 1280;
+        static constexpr uint32_t Height = 720;
+
+        // Prints one line per check; false if any pixel or code differs.
+        static bool Run();
+
+
+    private:
+        static void MakeLayer(const uint32_t& seed, CpuImage& image);
+        static void MakeOverlay(std::vector<uint8_t>& pixels, CpuOverlay& overlay);
+        static void MakeNoise(const uint32_t& seed, const uint32_t& width, const uint32_t& height, CpuFrame& frame);
+
+        static void ComposeExpected(const CompositeParams& params, const CpuImage& background, const CpuImage& blurred,
+            const CpuOverlay& overlay, CpuFrame& frame);
+        static uint64_t ShadeExpected(const CompositeParams& params, const uint32_t& x, const uint32_t& y,
+            const uint32_t& background, const uint32_t& blurred);
+
+        // Per-sample ports of the converters: every format's chroma siting and edge handling, and P010
+        // repacked to the 4:2:0 layouts.
+        static void ConvertExpected(const CpuFrame& frame, const OutputFormat& format, YuvFrame& yuv);
+        static void RepackExpected(const P010Frame& p010, const OutputFormat& format, YuvFrame& yuv);
+
+        static uint64_t CountDiffering(const CpuFrame& expected, const CpuFrame& actual);
+        static uint64_t CountDiffering(const P010Frame& expected, const P010Frame& actual);
+        static uint64_t CountDiffering(const YuvFrame& expected, const YuvFrame& actual);
+        static bool Report(const std::string& check, const uint64_t& differing);
+        static bool ReportError(const std::string& check, const float& error, const float& bound);
+};
@@ -0,0 +1,946 @@
+#include "CpuCompositor.h"
+#include "ColorConverter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+
+static constexpr uint32_t BandRows = 16;
+
+
+static inline uint64_t ShadePixel
+(
+    const WindowShape& s,
+    const uint32_t& x,
+    const uint32_t& y,
+    const uint64_t& bg,
+    const uint64_t& blur,
+    const uint64_t colors[3]
+)
+{
+    const float px = (float)x;
+    const float py = (float)y;
+
+    uint64_t outp = bg;
+
+    const float dx = std::fabs(px - s.centerX) - s.halfX;
+    const float dy = std::fabs(py - s.centerY) - s.halfY;
+    const float mx = std::max(dx, 0.0f);
+    const float my = std::max(dy, 0.0f);
+    const float dRect = std::sqrt(mx * mx + my * my) + std::min(std::max(dx, dy), 0.0f) - s.cornerRadius;
+    if (dRect <= 0.0f)
+        outp = blur;
+
+    const float cy = py - s.circleY;
+    for (int i = 0; i < 3; ++i)
+    {
+        const float cx = px - s.circleX[i];
+        const float d = std::sqrt(cx * cx + cy * cy) - s.circleRadius;
+        if (d <= 0.0f)
+            outp = colors[i];
+    }
+
+    return outp;
+}
+
+static void CompositeRowScalar
+(
+    const WindowShape& s,
+    const uint32_t& y,
+    const uint32_t& x0,
+    const uint32_t& x1,
+    const uint64_t* bg,
+    const uint64_t* blur,
+    uint64_t* out,
+    const uint64_t colors[3]
+)
+{
+    for (uint32_t x = x0; x < x1; ++x)
+        out[x] = ShadePixel(s, x, y, bg[x], blur[x], colors);
+}
+
+
+#if VR_SIMD_X86
+
+VR_TARGET_AVX2 static inline __m256i ExpandMaskLo(const __m256& m)
+{
+    return _mm256_cvtepi32_epi64(_mm256_castsi256_si128(_mm256_castps_si256(m)));
+}
+
+VR_TARGET_AVX2 static inline __m256i ExpandMaskHi(const __m256& m)
+{
+    return _mm256_cvtepi32_epi64(_mm256_extracti128_si256(_mm256_castps_si256(m), 1));
+}
+
+VR_TARGET_AVX2 static void CompositeRowAVX2
+(
+    const WindowShape& s,
+    const uint32_t& y,
+    const uint32_t& x0,
+    const uint32_t& x1,
+    const uint64_t* bg,
+    const uint64_t* blur,
+    uint64_t* out,
+    const uint64_t colors[3]
+)
+{
+    const float py = (float)y;
+    const float dyScalar = std::fabs(py - s.centerY) - s.halfY;
+    const float myScalar = std::max(dyScalar, 0.0f);
+    const float cyScalar = py - s.circleY;
+
+    const __m256 zero       = _mm256_setzero_ps();
+    const __m256 absMask    = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 lane       = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 centerX    = _mm256_set1_ps(s.centerX);
+    const __m256 halfX      = _mm256_set1_ps(s.halfX);
+    const __m256 radius     = _mm256_set1_ps(s.cornerRadius);
+    const __m256 dy         = _mm256_set1_ps(dyScalar);
+    const __m256 my2        = _mm256_set1_ps(myScalar * myScalar);
+    const __m256 cy2        = _mm256_set1_ps(cyScalar * cyScalar);
+    const __m256 circleR    = _mm256_set1_ps(s.circleRadius);
+
+    __m256 circleX[3];
+    __m256i color[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        circleX[i] = _mm256_set1_ps(s.circleX[i]);
+        color[i] = _mm256_set1_epi64x((long long)colors[i]);
+    }
+
+    uint32_t x = x0;
+    for (; x + 8 <= x1; x += 8)
+    {
+        const __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+
+        const __m256 dx = _mm256_sub_ps(_mm256_and_ps(_mm256_sub_ps(px, centerX), absMask), halfX);
+        const __m256 mx = _mm256_max_ps(dx, zero);
+        const __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(mx, mx), my2));
+        const __m256 inner = _mm256_min_ps(_mm256_max_ps(dx, dy), zero);
+        const __m256 dRect = _mm256_sub_ps(_mm256_add_ps(len, inner), radius);
+        const __m256 inRect = _mm256_cmp_ps(dRect, zero, _CMP_LE_OQ);
+
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + x + 4));
+
+        if (_mm256_movemask_ps(inRect))
+        {
+            lo = _mm256_blendv_epi8(lo, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blur + x)), ExpandMaskLo(inRect));
+            hi = _mm256_blendv_epi8(hi, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blur + x + 4)), ExpandMaskHi(inRect));
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            const __m256 cx = _mm256_sub_ps(px, circleX[i]);
+            const __m256 d = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), cy2)), circleR);
+            const __m256 inCircle = _mm256_cmp_ps(d, zero, _CMP_LE_OQ);
+            if (!_mm256_movemask_ps(inCircle))
+                continue;
+
+            lo = _mm256_blendv_epi8(lo, color[i], ExpandMaskLo(inCircle));
+            hi = _mm256_blendv_epi8(hi, color[i], ExpandMaskHi(inCircle));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x + 4), hi);
+    }
+
+    CompositeRowScalar(s, y, x, x1, bg, blur, out, colors);
+}
+
+
+VR_TARGET_SSE41 static void CompositeRowSSE41
+(
+    const WindowShape& s,
+    const uint32_t& y,
+    const uint32_t& x0,
+    const uint32_t& x1,
+    const uint64_t* bg,
+    const uint64_t* blur,
+    uint64_t* out,
+    const uint64_t colors[3]
+)
+{
+    const float py = (float)y;
+    const float dyScalar = std::fabs(py - s.centerY) - s.halfY;
+    const float myScalar = std::max(dyScalar, 0.0f);
+    const float cyScalar = py - s.circleY;
+
+    const __m128 zero       = _mm_setzero_ps();
+    const __m128 absMask    = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 lane       = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 centerX    = _mm_set1_ps(s.centerX);
+    const __m128 halfX      = _mm_set1_ps(s.halfX);
+    const __m128 radius     = _mm_set1_ps(s.cornerRadius);
+    const __m128 dy         = _mm_set1_ps(dyScalar);
+    const __m128 my2        = _mm_set1_ps(myScalar * myScalar);
+    const __m128 cy2        = _mm_set1_ps(cyScalar * cyScalar);
+    const __m128 circleR    = _mm_set1_ps(s.circleRadius);
+
+    __m128 circleX[3];
+    __m128i color[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        circleX[i] = _mm_set1_ps(s.circleX[i]);
+        color[i] = _mm_set1_epi64x((long long)colors[i]);
+    }
+
+    uint32_t x = x0;
+    for (; x + 4 <= x1; x += 4)
+    {
+        const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+
+        const __m128 dx = _mm_sub_ps(_mm_and_ps(_mm_sub_ps(px, centerX), absMask), halfX);
+        const __m128 mx = _mm_max_ps(dx, zero);
+        const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(mx, mx), my2));
+        const __m128 inner = _mm_min_ps(_mm_max_ps(dx, dy), zero);
+        const __m128 dRect = _mm_sub_ps(_mm_add_ps(len, inner), radius);
+        const __m128i inRect = _mm_castps_si128(_mm_cmple_ps(dRect, zero));
+
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + x + 2));
+
+        lo = _mm_blendv_epi8(lo, _mm_loadu_si128(reinterpret_cast<const __m128i*>(blur + x)), _mm_cvtepi32_epi64(inRect));
+        hi = _mm_blendv_epi8(hi, _mm_loadu_si128(reinterpret_cast<const __m128i*>(blur + x + 2)), _mm_cvtepi32_epi64(_mm_srli_si128(inRect, 8)));
+
+        for (int i = 0; i < 3; ++i)
+        {
+            const __m128 cx = _mm_sub_ps(px, circleX[i]);
+            const __m128 d = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(cx, cx), cy2)), circleR);
+            const __m128i inCircle = _mm_castps_si128(_mm_cmple_ps(d, zero));
+
+            lo = _mm_blendv_epi8(lo, color[i], _mm_cvtepi32_epi64(inCircle));
+            hi = _mm_blendv_epi8(hi, color[i], _mm_cvtepi32_epi64(_mm_srli_si128(inCircle, 8)));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x + 2), hi);
+    }
+
+    CompositeRowScalar(s, y, x, x1, bg, blur, out, colors);
+}
+
+#endif
+
+
+CpuCompositor::CpuCompositor(const uint32_t& width, const uint32_t& height)
+    : m_Width(width)
+    , m_Height(height)
+    , m_SimdLevel(DetectSimdLevel())
+{
+    m_CircleColors[0] = PackHalf4(1.0f, 0.3686f, 0.3412f, 1.0f);
+    m_CircleColors[1] = PackHalf4(1.0f, 0.7294f, 0.1804f, 1.0f);
+    m_CircleColors[2] = PackHalf4(0.1569f, 0.7882f, 0.2549f, 1.0f);
+}
+
+
+bool CpuCompositor::SetLayers(const CpuImage& background, const CpuImage& blurred)
+{
+    if (!background.IsValid() || !blurred.IsValid())
+    {
+        std::cerr << "CpuCompositor: missing background layers\n";
+        return false;
+    }
+
+    if
+    (
+        background.width != m_Width || background.height != m_Height ||
+        blurred.width != m_Width || blurred.height != m_Height
+    )
+    {
+        std::cerr << "CpuCompositor: background is " << background.width << 'x' << background.height
+            << ", blurred is " << blurred.width << 'x' << blurred.height
+            << ", expected " << m_Width << 'x' << m_Height << "\n";
+        return false;
+    }
+
+    ConvertLayer(background, m_Background);
+    ConvertLayer(blurred, m_Blurred);
+    ConvertLayerP010(m_Background, m_Width, m_Height, m_BackgroundP010);
+    ConvertLayerP010(m_Blurred, m_Width, m_Height, m_BlurredP010);
+    return true;
+}
+
+void CpuCompositor::ConvertLayer(const CpuImage& image, std::vector<uint64_t>& layer)
+{
+    uint16_t lut[256];
+    for (uint32_t i = 0; i < 256; ++i)
+        lut[i] = FloatToHalf((float)i / 255.0f);
+
+    layer.resize((size_t)image.width * image.height);
+
+    ThreadPool::Get().ParallelFor(image.height, [&](uint32_t y)
+    {
+        const uint32_t* src = image.Row(y);
+        uint64_t* dst = layer.data() + (size_t)y * image.width;
+
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            const uint32_t p = src[x];
+            dst[x] = (uint64_t)lut[p & 0xFF]
+                | ((uint64_t)lut[(p >> 8) & 0xFF] << 16)
+                | ((uint64_t)lut[(p >> 16) & 0xFF] << 32)
+                | ((uint64_t)lut[p >> 24] << 48);
+        }
+    });
+}
+
+void CpuCompositor::ConvertLayerP010(const std::vector<uint64_t>& layer, const uint32_t& width, const uint32_t& height,
+    P010Frame& p010)
+{
+    p010.Resize(width, height);
+
+    ThreadPool::Get().ParallelFor((height + 1) / 2, [&](uint32_t pair)
+    {
+        const uint32_t y = pair * 2;
+        const bool bHasSecondRow = y + 1 < height;
+        const uint64_t* row0 = layer.data() + (size_t)y * width;
+
+        ColorConverter::ConvertRowPair(row0, bHasSecondRow ? row0 + width : row0, width,
+            p010.LumaRow(y), bHasSecondRow ? p010.LumaRow(y + 1) : nullptr, p010.ChromaRow(pair));
+    });
+}
+
+
+WindowShape CpuCompositor::MakeShape(const CompositeParams& params, const uint32_t& width, const uint32_t& height)
+{
+    WindowShape s {};
+    s.centerX       = (float)width * 0.5f;
+    s.centerY       = (float)height * 0.5f;
+    s.cornerRadius  = 100.0f * params.scale;
+    s.halfX         = params.sizeX * 0.5f - s.cornerRadius;
+    s.halfY         = params.sizeY * 0.5f - s.cornerRadius;
+
+    const float topLeftX = s.centerX - params.sizeX * 0.5f + s.cornerRadius;
+    s.circleY       = s.centerY - params.sizeY * 0.5f + s.cornerRadius;
+    s.circleRadius  = 25.0f * params.scale;
+    s.circleX[0]    = topLeftX;
+    s.circleX[1]    = topLeftX + 75.0f * params.scale;
+    s.circleX[2]    = topLeftX + 150.0f * params.scale;
+
+    return s;
+}
+
+
+void CpuCompositor::Composite(const CompositeParams& params, CpuFrame& frame) const
+{
+    frame.Resize(m_Width, m_Height);
+    const WindowShape shape = MakeShape(params, m_Width, m_Height);
+
+    const uint32_t bands = (m_Height + BandRows - 1) / BandRows;
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t y0 = band * BandRows;
+        CompositeRows(shape, frame, y0, std::min(y0 + BandRows, m_Height));
+    });
+}
+
+DirtyRect CpuCompositor::CompositeIncremental(const CompositeParams& params, CpuFrame& frame)
+{
+    if (!m_bHasHistory || frame.width != m_Width || frame.height != m_Height)
+    {
+        Composite(params, frame);
+        m_LastParams = params;
+        m_bHasHistory = true;
+
+        return DirtyRect { 0, 0, m_Width, m_Height };
+    }
+
+    if (params == m_LastParams)
+        return DirtyRect {};
+
+    const WindowShape prev = MakeShape(m_LastParams, m_Width, m_Height);
+    const WindowShape curr = MakeShape(params, m_Width, m_Height);
+    m_LastParams = params;
+
+    // Per row, the union of both outer spans may have changed, except where both shapes are
+    // certainly inside the window (blurred either way) and no circle is involved.
+    struct RowWork
+    {
+        uint32_t lo = 0, hi = 0;
+        uint32_t keep0 = 0, keep1 = 0;
+    };
+
+    std::vector<RowWork> rows(m_Height);
+    DirtyRect dirty {};
+
+    for (uint32_t y = 0; y < m_Height; ++y)
+    {
+        const RowSpans a = ComputeRowSpans(prev, y);
+        const RowSpans b = ComputeRowSpans(curr, y);
+        RowWork& w = rows[y];
+
+        w.lo = m_Width;
+        w.hi = 0;
+        for (const auto& [r0, r1] : { std::pair(a.outer0, a.outer1), std::pair(b.outer0, b.outer1),
+            std::pair(a.circle0, a.circle1), std::pair(b.circle0, b.circle1) })
+        {
+            if (r1 <= r0)
+                continue;
+            w.lo = std::min(w.lo, r0);
+            w.hi = std::max(w.hi, r1);
+        }
+
+        if (w.hi <= w.lo)
+            continue;
+
+        if (a.circle1 <= a.circle0 && b.circle1 <= b.circle0)
+        {
+            w.keep0 = std::max(a.inner0, b.inner0);
+            w.keep1 = std::min(a.inner1, b.inner1);
+        }
+        if (w.keep1 <= w.keep0)
+            w.keep0 = w.keep1 = w.hi;
+
+        dirty.Union(DirtyRect { w.lo, y, w.hi, y + 1 });
+    }
+
+    const uint32_t bands = (m_Height + BandRows - 1) / BandRows;
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t y0 = band * BandRows;
+        const uint32_t y1 = std::min(y0 + BandRows, m_Height);
+
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            const RowWork& w = rows[y];
+            if (w.hi <= w.lo)
+                continue;
+
+            const uint64_t* bg = m_Background.data() + (size_t)y * m_Width;
+            const uint64_t* blur = m_Blurred.data() + (size_t)y * m_Width;
+            uint64_t* out = frame.Row(y);
+
+            if (m_Mode == CompositeMode::Spans)
+            {
+                CompositeRowSpans(curr, y, w.lo, w.keep0, bg, blur, out);
+                CompositeRowSpans(curr, y, w.keep1, w.hi, bg, blur, out);
+            }
+            else
+            {
+                ShadeRange(curr, y, w.lo, w.keep0, bg, blur, out);
+                ShadeRange(curr, y, w.keep1, w.hi, bg, blur, out);
+            }
+        }
+    });
+
+    return dirty;
+}
+
+// Source-over of premultiplied 8-bit text onto the half-float composite, rounded back through half
+// precision the way D2D's blend into the R16G16B16A16_FLOAT render target stores it.
+static void BlendOverlayRow(const CpuOverlay& overlay, const uint32_t& y, const uint32_t& x0, const uint32_t& x1,
+    uint64_t* row)
+{
+    if (y < overlay.rect.y0 || y >= overlay.rect.y1)
+        return;
+
+    const uint32_t a = std::max(x0, overlay.rect.x0);
+    const uint32_t b = std::min(x1, overlay.rect.x1);
+    const uint8_t* src = overlay.pixels + (size_t)(y - overlay.rect.y0) * overlay.pitch;
+
+    for (uint32_t x = a; x < b; ++x)
+    {
+        const uint8_t* p = src + (size_t)(x - overlay.rect.x0) * 4;
+        if (p[3] == 0)
+            continue;
+
+        const float sa = p[3] / 255.0f;
+        const float inv = 1.0f - sa;
+        const uint64_t d = row[x];
+
+        row[x] = PackHalf4
+        (
+            p[2] / 255.0f + HalfToFloat((uint16_t)d) * inv,
+            p[1] / 255.0f + HalfToFloat((uint16_t)(d >> 16)) * inv,
+            p[0] / 255.0f + HalfToFloat((uint16_t)(d >> 32)) * inv,
+            sa + HalfToFloat((uint16_t)(d >> 48)) * inv
+        );
+    }
+}
+
+void CpuCompositor::BlendOverlay(const CpuFrame& composite, const CpuOverlay& overlay, const DirtyRect& region,
+    CpuFrame& frame) const
+{
+    frame.Resize(m_Width, m_Height);
+
+    const uint32_t x0 = std::min(region.x0, m_Width);
+    const uint32_t x1 = std::clamp(region.x1, x0, m_Width);
+    const uint32_t y0 = std::min(region.y0, m_Height);
+    const uint32_t y1 = std::clamp(region.y1, y0, m_Height);
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    const uint32_t bands = (y1 - y0 + BandRows - 1) / BandRows;
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t first = y0 + band * BandRows;
+        for (uint32_t y = first; y < std::min(first + BandRows, y1); ++y)
+        {
+            std::memcpy(frame.Row(y) + x0, composite.Row(y) + x0, (size_t)(x1 - x0) * sizeof(uint64_t));
+            if (!overlay.IsEmpty())
+                BlendOverlayRow(overlay, y, x0, x1, frame.Row(y));
+        }
+    });
+}
+
+void CpuCompositor::CompositeP010(const CompositeParams& params, const CpuOverlay& overlay, const DirtyRect& region,
+    P010Frame& frame) const
+{
+    if (frame.width != m_Width || frame.height != m_Height)
+        frame.Resize(m_Width, m_Height);
+
+    // Chroma pairs pixels, so the region grows to even columns and whole row pairs.
+    const uint32_t x0 = std::min(region.x0, m_Width) & ~1u;
+    const uint32_t x1 = std::min((region.x1 + 1) & ~1u, m_Width);
+    const uint32_t pair0 = std::min(region.y0, m_Height) / 2;
+    const uint32_t pair1 = (std::min(region.y1, m_Height) + 1) / 2;
+    if (x1 <= x0 || pair1 <= pair0)
+        return;
+
+    const WindowShape shape = MakeShape(params, m_Width, m_Height);
+    constexpr uint32_t BandPairs = BandRows / 2;
+    const uint32_t bands = (pair1 - pair0 + BandPairs - 1) / BandPairs;
+
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        thread_local std::vector<uint64_t> scratch;
+        scratch.resize((size_t)m_Width * 2);
+        uint64_t* rows[2] = { scratch.data(), scratch.data() + m_Width };
+
+        const uint32_t first = pair0 + band * BandPairs;
+        const uint32_t last = std::min(first + BandPairs, pair1);
+
+        for (uint32_t pair = first; pair < last; ++pair)
+        {
+            const uint32_t y = pair * 2;
+            const bool bHasSecondRow = y + 1 < m_Height;
+
+            for (uint32_t i = 0; i < (bHasSecondRow ? 2u : 1u); ++i)
+            {
+                const size_t offset = (size_t)(y + i) * m_Width;
+                if (m_Mode == CompositeMode::Spans)
+                    CompositeRowSpans(shape, y + i, x0, x1, m_Background.data() + offset, m_Blurred.data() + offset, rows[i]);
+                else
+                    ShadeRange(shape, y + i, x0, x1, m_Background.data() + offset, m_Blurred.data() + offset, rows[i]);
+
+                if (!overlay.IsEmpty())
+                    BlendOverlayRow(overlay, y + i, x0, x1, rows[i]);
+            }
+
+            ColorConverter::ConvertRowPair
+            (
+                rows[0] + x0,
+                (bHasSecondRow ? rows[1] : rows[0]) + x0,
+                x1 - x0,
+                frame.LumaRow(y) + x0,
+                bHasSecondRow ? frame.LumaRow(y + 1) + x0 : nullptr,
+                frame.ChromaRow(pair) + x0
+            );
+        }
+    });
+}
+
+static TileClass ClassifyTile(const std::vector<RowSpans>& rows, const uint32_t& x0, const uint32_t& x1,
+    const uint32_t& y0, const uint32_t& y1)
+{
+    bool bAllOutside = true;
+    bool bAllInside = true;
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const RowSpans& r = rows[y];
+        const bool bTouchesCircle = r.circle1 > r.circle0 && r.circle0 < x1 && r.circle1 > x0;
+        if (bTouchesCircle)
+            return TileClass::Edge;
+
+        const bool bTouchesWindow = r.outer1 > r.outer0 && r.outer0 < x1 && r.outer1 > x0;
+        const bool bCoveredByInner = r.inner0 <= x0 && r.inner1 >= x1 && r.inner1 > r.inner0;
+
+        bAllOutside = bAllOutside && !bTouchesWindow;
+        bAllInside = bAllInside && bCoveredByInner;
+        if (!bAllOutside && !bAllInside)
+            return TileClass::Edge;
+    }
+
+    return bAllOutside ? TileClass::Outside : TileClass::Inside;
+}
+
+TileStats CpuCompositor::CompositeTiles(const CompositeParams& params, const CpuOverlay& overlay, const DirtyRect& region,
+    TiledFrame& tiles, P010Frame& p010) const
+{
+    constexpr uint32_t T = TiledFrame::TileSize;
+
+    if (tiles.width != m_Width || tiles.height != m_Height)
+        tiles.Resize(m_Width, m_Height);
+    if (p010.width != m_Width || p010.height != m_Height)
+        p010.Resize(m_Width, m_Height);
+
+    const WindowShape shape = MakeShape(params, m_Width, m_Height);
+
+    std::vector<RowSpans> rows(m_Height);
+    const uint32_t bands = (m_Height + BandRows - 1) / BandRows;
+    ThreadPool::Get().ParallelFor(bands, [&](uint32_t band)
+    {
+        const uint32_t y1 = std::min((band + 1) * BandRows, m_Height);
+        for (uint32_t y = band * BandRows; y < y1; ++y)
+            rows[y] = ComputeRowSpans(shape, y);
+    });
+
+    struct TileJob
+    {
+        uint32_t index;
+        TileClass tileClass;
+        bool bText;
+    };
+
+    std::vector<TileJob> jobs;
+    jobs.reserve(tiles.GetTileCount());
+    TileStats stats {};
+
+    for (uint32_t ty = 0; ty < tiles.tilesY; ++ty)
+    {
+        for (uint32_t tx = 0; tx < tiles.tilesX; ++tx)
+        {
+            const DirtyRect rect { tx * T, ty * T, std::min((tx + 1) * T, m_Width), std::min((ty + 1) * T, m_Height) };
+            const bool bDirty = rect.x0 < region.x1 && rect.x1 > region.x0 && rect.y0 < region.y1 && rect.y1 > region.y0;
+            if (!bDirty)
+            {
+                ++stats.skipped;
+                continue;
+            }
+
+            const TileClass tileClass = ClassifyTile(rows, rect.x0, rect.x1, rect.y0, rect.y1);
+            const bool bText = !overlay.IsEmpty() && rect.x0 < overlay.rect.x1 && rect.x1 > overlay.rect.x0
+                && rect.y0 < overlay.rect.y1 && rect.y1 > overlay.rect.y0;
+
+            switch (tileClass)
+            {
+                case TileClass::Outside:    ++stats.outside;    break;
+                case TileClass::Inside:     ++stats.inside;     break;
+                default:                    ++stats.edge;       break;
+            }
+            if (bText)
+                ++stats.text;
+
+            jobs.push_back(TileJob { ty * tiles.tilesX + tx, tileClass, bText });
+        }
+    }
+
+    // Expensive tiles first, so the cheap copies fill in behind them and no thread ends on a long job.
+    std::stable_partition(jobs.begin(), jobs.end(), [](const TileJob& job)
+    {
+        return job.tileClass == TileClass::Edge || job.bText;
+    });
+
+    ThreadPool::Get().ParallelFor((uint32_t)jobs.size(), [&](uint32_t i)
+    {
+        const TileJob& job = jobs[i];
+        CompositeTile(shape, job.index, job.tileClass, job.bText ? &overlay : nullptr, tiles, p010);
+    });
+
+    return stats;
+}
+
+void CpuCompositor::CompositeTile(const WindowShape& shape, const uint32_t& index, const TileClass& tileClass,
+    const CpuOverlay* pOverlay, TiledFrame& tiles, P010Frame& p010) const
+{
+    constexpr uint32_t T = TiledFrame::TileSize;
+
+    const uint32_t x0 = (index % tiles.tilesX) * T;
+    const uint32_t y0 = (index / tiles.tilesX) * T;
+    const uint32_t x1 = std::min(x0 + T, m_Width);
+    const uint32_t y1 = std::min(y0 + T, m_Height);
+    const uint32_t w = x1 - x0;
+    uint64_t* tile = tiles.Tile(index);
+
+    const bool bTrivial = tileClass != TileClass::Edge;
+    const std::vector<uint64_t>& layer = tileClass == TileClass::Inside ? m_Blurred : m_Background;
+
+    // The kernels address pixels by frame x, so edge and text rows go through a frame-wide scratch row.
+    thread_local std::vector<uint64_t> scratch;
+    if (!bTrivial || pOverlay)
+        scratch.resize(m_Width);
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const size_t offset = (size_t)y * m_Width;
+        uint64_t* out = tile + (size_t)(y - y0) * T;
+
+        if (bTrivial && !pOverlay)
+        {
+            std::memcpy(out, layer.data() + offset + x0, (size_t)w * sizeof(uint64_t));
+            continue;
+        }
+
+        if (bTrivial)
+            std::memcpy(scratch.data() + x0, layer.data() + offset + x0, (size_t)w * sizeof(uint64_t));
+        else if (m_Mode == CompositeMode::Spans)
+            CompositeRowSpans(shape, y, x0, x1, m_Background.data() + offset, m_Blurred.data() + offset, scratch.data());
+        else
+            ShadeRange(shape, y, x0, x1, m_Background.data() + offset, m_Blurred.data() + offset, scratch.data());
+
+        if (pOverlay)
+            BlendOverlayRow(*pOverlay, y, x0, x1, scratch.data());
+
+        std::memcpy(out, scratch.data() + x0, (size_t)w * sizeof(uint64_t));
+    }
+
+    // Chroma pairs stay inside the tile because TileSize is even.
+    const uint32_t chromaCount = (w + 1) & ~1u;
+    if (bTrivial && !pOverlay)
+    {
+        const P010Frame& planes = tileClass == TileClass::Inside ? m_BlurredP010 : m_BackgroundP010;
+        for (uint32_t y = y0; y < y1; ++y)
+            std::memcpy(p010.LumaRow(y) + x0, planes.LumaRow(y) + x0, (size_t)w * sizeof(uint16_t));
+        for (uint32_t pair = y0 / 2; pair < (y1 + 1) / 2; ++pair)
+            std::memcpy(p010.ChromaRow(pair) + x0, planes.ChromaRow(pair) + x0, (size_t)chromaCount * sizeof(uint16_t));
+        return;
+    }
+
+    for (uint32_t y = y0; y < y1; y += 2)
+    {
+        const bool bHasSecondRow = y + 1 < y1;
+        const uint64_t* row0 = tile + (size_t)(y - y0) * T;
+
+        ColorConverter::ConvertRowPair(row0, bHasSecondRow ? row0 + T : row0, w,
+            p010.LumaRow(y) + x0, bHasSecondRow ? p010.LumaRow(y + 1) + x0 : nullptr, p010.ChromaRow(y / 2) + x0);
+    }
+}
+
+DirtyRect CpuCompositor::GetShapeBounds(const CompositeParams& params, const uint32_t& width, const uint32_t& height)
+{
+    const WindowShape s = MakeShape(params, width, height);
+
+    auto ToRect = [&](double x0, double y0, double x1, double y1)
+    {
+        DirtyRect r {};
+        if (x1 < x0 || y1 < y0)
+            return r;
+
+        r.x0 = (uint32_t)std::clamp(std::floor(x0 - 1.0), 0.0, (double)width);
+        r.y0 = (uint32_t)std::clamp(std::floor(y0 - 1.0), 0.0, (double)height);
+        r.x1 = (uint32_t)std::clamp(std::ceil(x1 + 1.0) + 1.0, (double)r.x0, (double)width);
+        r.y1 = (uint32_t)std::clamp(std::ceil(y1 + 1.0) + 1.0, (double)r.y0, (double)height);
+        return r;
+    };
+
+    const double ex = (double)s.halfX + s.cornerRadius;
+    const double ey = (double)s.halfY + s.cornerRadius;
+    DirtyRect bounds = ToRect(s.centerX - ex, s.centerY - ey, s.centerX + ex, s.centerY + ey);
+
+    const double cr = s.circleRadius;
+    bounds.Union(ToRect(s.circleX[0] - cr, s.circleY - cr, s.circleX[2] + cr, s.circleY + cr));
+
+    return bounds;
+}
+
+void CpuCompositor::CompositeRows(const WindowShape& shape, CpuFrame& frame, const uint32_t& y0, const uint32_t& y1) const
+{
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const uint64_t* bg = m_Background.data() + (size_t)y * m_Width;
+        const uint64_t* blur = m_Blurred.data() + (size_t)y * m_Width;
+        uint64_t* out = frame.Row(y);
+
+        if (m_Mode == CompositeMode::Spans)
+            CompositeRowSpans(shape, y, 0, m_Width, bg, blur, out);
+        else
+            ShadeRange(shape, y, 0, m_Width, bg, blur, out);
+    }
+}
+
+void CpuCompositor::CompositeRowSpans
+(
+    const WindowShape& shape,
+    const uint32_t& y,
+    const uint32_t& x0,
+    const uint32_t& x1,
+    const uint64_t* bg,
+    const uint64_t* blur,
+    uint64_t* out
+) const
+{
+    const RowSpans spans = ComputeRowSpans(shape, y);
+
+    auto Copy = [&](uint32_t a, uint32_t b, const uint64_t* src)
+    {
+        a = std::max(a, x0);
+        b = std::min(b, x1);
+        if (b > a)
+            std::memcpy(out + a, src + a, (size_t)(b - a) * sizeof(uint64_t));
+    };
+
+    auto Shade = [&](uint32_t a, uint32_t b)
+    {
+        ShadeRange(shape, y, std::max(a, x0), std::min(b, x1), bg, blur, out);
+    };
+
+    Copy(0, spans.outer0, bg);
+    Shade(spans.outer0, spans.inner0);
+    Copy(spans.inner0, spans.inner1, blur);
+    Shade(spans.inner1, spans.outer1);
+    Copy(spans.outer1, m_Width, bg);
+
+    if (spans.circle1 > spans.circle0)
+        Shade(spans.circle0, spans.circle1);
+}
+
+RowSpans CpuCompositor::ComputeRowSpans(const WindowShape& shape, const uint32_t& y) const
+{
+    // Solving sdRoundRect(p) <= 0 for x gives |x - cx| <= halfX + w(y), with w = r on the straight
+    // part and sqrt(r^2 - dy^2) in the corners. Pixels within EdgeMargin of that boundary, or of the
+    // circles, go through the exact SDF so the result stays identical to the per-pixel path.
+    constexpr double EdgeMargin = 1.0;
+    constexpr double TangentMargin = 0.01;
+
+    RowSpans spans {};
+
+    const double r = shape.cornerRadius;
+    const double dy = std::fabs((double)y - shape.centerY) - shape.halfY;
+
+    if (dy <= r + TangentMargin)
+    {
+        const double w = (dy <= 0.0) ? r : std::sqrt(std::max(r * r - dy * dy, 0.0));
+        const double extent = shape.halfX + w;
+
+        const double outerLo = std::floor(shape.centerX - extent - EdgeMargin);
+        const double outerHi = std::ceil(shape.centerX + extent + EdgeMargin) + 1.0;
+        spans.outer0 = (uint32_t)std::clamp(outerLo, 0.0, (double)m_Width);
+        spans.outer1 = (uint32_t)std::clamp(outerHi, (double)spans.outer0, (double)m_Width);
+
+        spans.inner0 = spans.outer0;
+        spans.inner1 = spans.outer0;
+        if (dy < r - TangentMargin)
+        {
+            const double innerLo = std::ceil(shape.centerX - extent + EdgeMargin);
+            const double innerHi = std::floor(shape.centerX + extent - EdgeMargin) + 1.0;
+            if (innerHi > innerLo)
+            {
+                spans.inner0 = (uint32_t)std::clamp(innerLo, (double)spans.outer0, (double)spans.outer1);
+                spans.inner1 = (uint32_t)std::clamp(innerHi, (double)spans.inner0, (double)spans.outer1);
+            }
+        }
+    }
+
+    const double cr = shape.circleRadius + EdgeMargin;
+    if (std::fabs((double)y - shape.circleY) <= cr)
+    {
+        const double lo = std::floor(shape.circleX[0] - cr);
+        const double hi = std::ceil(shape.circleX[2] + cr) + 1.0;
+        spans.circle0 = (uint32_t)std::clamp(lo, 0.0, (double)m_Width);
+        spans.circle1 = (uint32_t)std::clamp(hi, (double)spans.circle0, (double)m_Width);
+    }
+
+    return spans;
+}
+
+void CpuCompositor::ShadeRange
+(
+    const WindowShape& shape,
+    const uint32_t& y,
+    const uint32_t& x0,
+    const uint32_t& x1,
+    const uint64_t* bg,
+    const uint64_t* blur,
+    uint64_t* out
+) const
+{
+    if (x1 <= x0)
+        return;
+
+    switch (m_SimdLevel)
+    {
+#if VR_SIMD_X86
+        case SimdLevel::AVX2:
+            CompositeRowAVX2(shape, y, x0, x1, bg, blur, out, m_CircleColors);
+            break;
+        case SimdLevel::SSE41:
+            CompositeRowSSE41(shape, y, x0, x1, bg, blur, out, m_CircleColors);
+            break;
+#endif
+        default:
+            CompositeRowScalar(shape, y, x0, x1, bg, blur, out, m_CircleColors);
+            break;
+    }
+}
+
+
+CompositeTimings CpuCompositor::Benchmark(const CompositeParams& params, const uint32_t& iterations)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    const CompositeMode mode = m_Mode;
+    CpuFrame frame;
+    CompositeTimings timings {};
+
+    for (CompositeMode m : { CompositeMode::PerPixel, CompositeMode::Spans })
+    {
+        m_Mode = m;
+        Composite(params, frame);
+
+        auto t0 = clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+            Composite(params, frame);
+        auto t1 = clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / std::max(1u, iterations);
+        if (m == CompositeMode::PerPixel)
+            timings.perPixelMs = ms;
+        else
+            timings.spansMs = ms;
+    }
+
+    // RGBA16F frame followed by a conversion pass, against the fused row-pair kernel.
+    P010Frame p010;
+    p010.Resize(m_Width, m_Height);
+    const DirtyRect full { 0, 0, m_Width, m_Height };
+
+    auto t0 = clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        Composite(params, frame);
+        ColorConverter::Convert(frame, p010);
+    }
+    auto t1 = clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+        CompositeP010(params, CpuOverlay {}, full, p010);
+    auto t2 = clock::now();
+    TiledFrame tiles;
+    for (uint32_t i = 0; i < iterations; ++i)
+        CompositeTiles(params, CpuOverlay {}, full, tiles, p010);
+    auto t3 = clock::now();
+
+    timings.tiledP010Ms = std::chrono::duration<double, std::milli>(t3 - t2).count() / std::max(1u, iterations);
+    timings.separateP010Ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / std::max(1u, iterations);
+    timings.fusedP010Ms = std::chrono::duration<double, std::milli>(t2 - t1).count() / std::max(1u, iterations);
+
+    // The conversion on its own, scalar against SIMD, each checked against the shader port.
+    const SimdLevel converterLevel = ColorConverter::GetSimdLevel();
+    for (SimdLevel level : { SimdLevel::Scalar, converterLevel })
+    {
+        ColorConverter::SetSimdLevel(level);
+
+        auto c0 = clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+            ColorConverter::Convert(frame, p010);
+        auto c1 = clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(c1 - c0).count() / std::max(1u, iterations);
+        if (level == SimdLevel::Scalar)
+            timings.convertScalarMs = ms;
+        else
+            timings.convertSimdMs = ms;
+
+        timings.convertMismatches += ColorConverter::CountMismatches(frame, p010);
+    }
+    ColorConverter::SetSimdLevel(converterLevel);
+
+    m_Mode = mode;
+    return timings;
+}
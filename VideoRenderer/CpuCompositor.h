@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "CpuFrame.h"
+#include "Simd.h"
+
+
+// Same inputs ShapeCS.hlsl reads from CSConstants.
+struct CompositeParams
+{
+    float scale = 0.0f;
+    float sizeX = 0.0f;
+    float sizeY = 0.0f;
+
+    bool operator==(const CompositeParams&) const = default;
+};
+
+// Half-open pixel rectangle.
+struct DirtyRect
+{
+    uint32_t x0 = 0;
+    uint32_t y0 = 0;
+    uint32_t x1 = 0;
+    uint32_t y1 = 0;
+
+    bool IsEmpty() const { return x1 <= x0 || y1 <= y0; }
+
+    void Union(const DirtyRect& other)
+    {
+        if (other.IsEmpty())
+            return;
+        if (IsEmpty())
+        {
+            *this = other;
+            return;
+        }
+
+        x0 = std::min(x0, other.x0);
+        y0 = std::min(y0, other.y0);
+        x1 = std::max(x1, other.x1);
+        y1 = std::max(y1, other.y1);
+    }
+};
+
+// Premultiplied B8G8R8A8 pixels drawn over the composite inside `rect`, e.g. text read back from a
+// D2D bitmap. `pixels` points at the pixel (rect.x0, rect.y0).
+struct CpuOverlay
+{
+    DirtyRect rect;
+    const uint8_t* pixels = nullptr;
+    size_t pitch = 0;
+
+    bool IsEmpty() const { return !pixels || rect.IsEmpty(); }
+};
+
+enum class CompositeMode : uint8_t
+{
+    PerPixel,   // SDF for every pixel, like CSMain
+    Spans       // analytic row intervals, SDF only near edges and circles
+};
+
+struct WindowShape
+{
+    float centerX;
+    float centerY;
+    float halfX;
+    float halfY;
+    float cornerRadius;
+
+    float circleX[3];
+    float circleY;
+    float circleRadius;
+};
+
+// Per row: [outer0, outer1) may touch the window, [inner0, inner1) is certainly inside it,
+// [circle0, circle1) may touch a traffic-light circle.
+struct RowSpans
+{
+    uint32_t outer0 = 0;
+    uint32_t outer1 = 0;
+    uint32_t inner0 = 0;
+    uint32_t inner1 = 0;
+    uint32_t circle0 = 0;
+    uint32_t circle1 = 0;
+};
+
+enum class TileClass : uint8_t
+{
+    Outside,    // plain background
+    Inside,     // entirely blurred, no circle
+    Edge        // window border or circles, spans + SDF
+};
+
+// Tile counts for one CompositeTiles call. Outside and inside tiles are the trivial ones.
+struct TileStats
+{
+    uint32_t outside = 0;
+    uint32_t inside = 0;
+    uint32_t edge = 0;
+    uint32_t text = 0;      // tiles that also blended the overlay, any class
+    uint32_t skipped = 0;   // outside the dirty region, left untouched
+
+    uint32_t GetTrivial() const { return outside + inside; }
+
+    void Add(const TileStats& other)
+    {
+        outside += other.outside;
+        inside += other.inside;
+        edge += other.edge;
+        text += other.text;
+        skipped += other.skipped;
+    }
+};
+
+struct CompositeTimings
+{
+    double perPixelMs = 0.0;
+    double spansMs = 0.0;
+    double separateP010Ms = 0.0;    // spans into RGBA16F, then convert
+    double fusedP010Ms = 0.0;       // CompositeP010
+    double tiledP010Ms = 0.0;       // CompositeTiles
+    double convertScalarMs = 0.0;   // ColorConverter::Convert alone, scalar
+    double convertSimdMs = 0.0;     // same at ColorConverter's detected level
+    uint64_t convertMismatches = 0; // codes differing from the shader port, both levels
+};
+
+
+class CpuCompositor
+{
+    private:
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        SimdLevel m_SimdLevel = SimdLevel::Scalar;
+        CompositeMode m_Mode = CompositeMode::Spans;
+
+        std::vector<uint64_t> m_Background;
+        std::vector<uint64_t> m_Blurred;
+        P010Frame m_BackgroundP010;
+        P010Frame m_BlurredP010;
+        uint64_t m_CircleColors[3] {};
+
+        CompositeParams m_LastParams;
+        bool m_bHasHistory = false;
+
+
+    public:
+        CpuCompositor(const uint32_t& width, const uint32_t& height);
+
+        bool SetLayers(const CpuImage& background, const CpuImage& blurred);
+
+        void Composite(const CompositeParams& params, CpuFrame& frame) const;
+
+        // Recomposites only the pixels whose coverage can differ from the previous call on the same
+        // frame and returns their bounds. An unchanged window costs nothing.
+        DirtyRect CompositeIncremental(const CompositeParams& params, CpuFrame& frame);
+        void InvalidateHistory() { m_bHasHistory = false; }
+
+        // Copies `region` of `composite` into `frame` and blends the overlay over it, for frames that
+        // leave the renderer in system memory with their text instead of in a texture D2D draws on.
+        void BlendOverlay(const CpuFrame& composite, const CpuOverlay& overlay, const DirtyRect& region,
+            CpuFrame& frame) const;
+
+        // Composites, blends the overlay and writes limited-range BT.709 P010 straight into `frame`,
+        // one row pair at a time, without ever holding a full RGBA16F frame. Only the row pairs and
+        // columns covering `region` are rewritten; `frame` keeps the rest from earlier calls.
+        void CompositeP010(const CompositeParams& params, const CpuOverlay& overlay, const DirtyRect& region,
+            P010Frame& frame) const;
+
+        // Same output as CompositeP010, but scheduled as one job per TiledFrame tile touching `region`:
+        // classify, composite into `tiles`, blend the overlay, convert into `p010`. Edge and text
+        // tiles are queued first. Trivial tiles copy the layers and their precomputed P010 planes
+        // instead of running the SDF or the converter.
+        TileStats CompositeTiles(const CompositeParams& params, const CpuOverlay& overlay, const DirtyRect& region,
+            TiledFrame& tiles, P010Frame& p010) const;
+
+        // Pixels that can differ from the plain background for this geometry.
+        static DirtyRect GetShapeBounds(const CompositeParams& params, const uint32_t& width, const uint32_t& height);
+
+        // Average milliseconds per frame of each mode over the same geometry.
+        CompositeTimings Benchmark(const CompositeParams& params, const uint32_t& iterations);
+
+        SimdLevel GetSimdLevel() const { return m_SimdLevel; }
+        void SetSimdLevel(const SimdLevel& level) { m_SimdLevel = level; }
+
+        CompositeMode GetMode() const { return m_Mode; }
+        void SetMode(const CompositeMode& mode) { m_Mode = mode; }
+
+
+    private:
+        static WindowShape MakeShape(const CompositeParams& params, const uint32_t& width, const uint32_t& height);
+        void CompositeRows(const WindowShape& shape, CpuFrame& frame, const uint32_t& y0, const uint32_t& y1) const;
+        void CompositeRowSpans(const WindowShape& shape, const uint32_t& y, const uint32_t& x0, const uint32_t& x1,
+            const uint64_t* bg, const uint64_t* blur, uint64_t* out) const;
+        RowSpans ComputeRowSpans(const WindowShape& shape, const uint32_t& y) const;
+        void ShadeRange(const WindowShape& shape, const uint32_t& y, const uint32_t& x0, const uint32_t& x1,
+            const uint64_t* bg, const uint64_t* blur, uint64_t* out) const;
+
+        void CompositeTile(const WindowShape& shape, const uint32_t& index, const TileClass& tileClass,
+            const CpuOverlay* pOverlay, TiledFrame& tiles, P010Frame& p010) const;
+
+        static void ConvertLayer(const CpuImage& image, std::vector<uint64_t>& layer);
+        static void ConvertLayerP010(const std::vector<uint64_t>& layer, const uint32_t& width, const uint32_t& height,
+            P010Frame& p010);
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "PixelFormat.h"
+
+
+// Decoded 8-bit image, RGBA byte order (R in the low byte), tightly packed.
+struct CpuImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::shared_ptr<const uint32_t[]> pixels;
+
+    const uint32_t* Row(const uint32_t& y) const { return pixels.get() + (size_t)y * width; }
+    bool IsValid() const { return pixels && width > 0 && height > 0; }
+};
+
+// RGBA16F frame, one packed uint64_t per pixel in R16G16B16A16_FLOAT memory order.
+struct CpuFrame
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint64_t> pixels;
+
+    void Resize(const uint32_t& w, const uint32_t& h)
+    {
+        width = w;
+        height = h;
+        pixels.resize((size_t)w * h);
+    }
+
+    uint64_t* Row(const uint32_t& y)                { return pixels.data() + (size_t)y * width; }
+    const uint64_t* Row(const uint32_t& y) const    { return pixels.data() + (size_t)y * width; }
+    size_t GetPitch() const                         { return (size_t)width * sizeof(uint64_t); }
+};
+
+// 4:2:0 10-bit frame in P010 memory layout: codes in the high 10 bits of each uint16_t, Cb/Cr
+// interleaved in a half-height chroma plane.
+struct P010Frame
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint16_t> luma;
+    std::vector<uint16_t> chroma;
+
+    void Resize(const uint32_t& w, const uint32_t& h)
+    {
+        width = w;
+        height = h;
+        luma.resize((size_t)w * h);
+        chroma.resize((size_t)GetChromaWidth() * 2 * ((h + 1) / 2));
+    }
+
+    uint32_t GetChromaWidth() const { return (width + 1) / 2; }
+
+    uint16_t* LumaRow(const uint32_t& y)                { return luma.data() + (size_t)y * width; }
+    const uint16_t* LumaRow(const uint32_t& y) const    { return luma.data() + (size_t)y * width; }
+    uint16_t* ChromaRow(const uint32_t& cy)             { return chroma.data() + (size_t)cy * GetChromaWidth() * 2; }
+    const uint16_t* ChromaRow(const uint32_t& cy) const { return chroma.data() + (size_t)cy * GetChromaWidth() * 2; }
+    size_t GetLumaPitch() const                         { return (size_t)width * sizeof(uint16_t); }
+    size_t GetChromaPitch() const                       { return (size_t)GetChromaWidth() * 2 * sizeof(uint16_t); }
+};
+
+// Any OutputFormat in FFmpeg's memory layout: luma, then either one interleaved Cb/Cr plane or
+// separate Cb and Cr planes. Samples wider than 8 bits are little-endian uint16_t.
+struct YuvFrame
+{
+    OutputFormat format = OutputFormat::P010;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> planes[3];
+    size_t pitches[3] {};
+
+    void Resize(const OutputFormat& f, const uint32_t& w, const uint32_t& h)
+    {
+        const FormatInfo info = GetFormatInfo(f);
+        const uint32_t bytes = info.GetBytesPerSample();
+        const uint32_t chromaWidth = (w + (1u << info.shiftX) - 1) >> info.shiftX;
+        const uint32_t chromaHeight = (h + (1u << info.shiftY) - 1) >> info.shiftY;
+
+        format = f;
+        width = w;
+        height = h;
+
+        pitches[0] = (size_t)w * bytes;
+        pitches[1] = (size_t)chromaWidth * bytes * (info.bInterleaved ? 2 : 1);
+        pitches[2] = info.bInterleaved ? 0 : pitches[1];
+
+        planes[0].resize(pitches[0] * h);
+        planes[1].resize(pitches[1] * chromaHeight);
+        planes[2].resize(pitches[2] * chromaHeight);
+    }
+
+    template <typename T>
+    T* PlaneRow(const uint32_t& plane, const uint32_t& y)
+    {
+        return reinterpret_cast<T*>(planes[plane].data() + pitches[plane] * y);
+    }
+};
+
+// RGBA16F frame stored as TileSize x TileSize tiles, each contiguous with a row stride of TileSize.
+// Tiles on the right and bottom edges are only partly used.
+struct TiledFrame
+{
+    static constexpr uint32_t TileSize = 64;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    std::vector<uint64_t> pixels;
+
+    void Resize(const uint32_t& w, const uint32_t& h)
+    {
+        width = w;
+        height = h;
+        tilesX = (w + TileSize - 1) / TileSize;
+        tilesY = (h + TileSize - 1) / TileSize;
+        pixels.resize((size_t)tilesX * tilesY * TileSize * TileSize);
+    }
+
+    uint32_t GetTileCount() const { return tilesX * tilesY; }
+
+    uint64_t* Tile(const uint32_t& index)               { return pixels.data() + (size_t)index * TileSize * TileSize; }
+    const uint64_t* Tile(const uint32_t& index) const   { return pixels.data() + (size_t)index * TileSize * TileSize; }
+
+    uint64_t At(const uint32_t& x, const uint32_t& y) const
+    {
+        return Tile((y / TileSize) * tilesX + x / TileSize)[(y % TileSize) * TileSize + x % TileSize];
+    }
+};
@@ -0,0 +1,292 @@
+#include "DWriteGlyphSource.h"
+#include "HResult.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+// Collects the glyph runs a layout draws instead of drawing them.
+class GlyphRunCollector : public IDWriteTextRenderer
+{
+    private:
+        DWriteGlyphSource& m_Source;
+        ULONG m_RefCount = 1;
+
+
+    public:
+        explicit GlyphRunCollector(DWriteGlyphSource& source)
+            : m_Source(source)
+        {}
+
+        IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv) override
+        {
+            if (riid == __uuidof(IUnknown) || riid == __uuidof(IDWritePixelSnapping) || riid == __uuidof(IDWriteTextRenderer))
+            {
+                *ppv = static_cast<IDWriteTextRenderer*>(this);
+                AddRef();
+                return S_OK;
+            }
+
+            *ppv = nullptr;
+            return E_NOINTERFACE;
+        }
+        IFACEMETHODIMP_(ULONG) AddRef() override { return ++m_RefCount; }
+        IFACEMETHODIMP_(ULONG) Release() override { return --m_RefCount; }
+
+        IFACEMETHODIMP IsPixelSnappingDisabled(void*, BOOL* pIsDisabled) override
+        {
+            *pIsDisabled = TRUE;
+            return S_OK;
+        }
+        IFACEMETHODIMP GetCurrentTransform(void*, DWRITE_MATRIX* pTransform) override
+        {
+            *pTransform = DWRITE_MATRIX { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+            return S_OK;
+        }
+        IFACEMETHODIMP GetPixelsPerDip(void*, FLOAT* pPixelsPerDip) override
+        {
+            *pPixelsPerDip = 1.0f;
+            return S_OK;
+        }
+
+        IFACEMETHODIMP DrawGlyphRun(void*, FLOAT baselineOriginX, FLOAT baselineOriginY, DWRITE_MEASURING_MODE,
+            const DWRITE_GLYPH_RUN* glyphRun, const DWRITE_GLYPH_RUN_DESCRIPTION* glyphRunDescription, IUnknown*) override
+        {
+            m_Source.AddRun(D2D1::Point2F(baselineOriginX, baselineOriginY), *glyphRun,
+                m_Source.m_TextOffset + glyphRunDescription->textPosition, glyphRunDescription->stringLength,
+                glyphRunDescription->clusterMap);
+            return S_OK;
+        }
+        IFACEMETHODIMP DrawUnderline(void*, FLOAT, FLOAT, const DWRITE_UNDERLINE*, IUnknown*) override { return S_OK; }
+        IFACEMETHODIMP DrawStrikethrough(void*, FLOAT, FLOAT, const DWRITE_STRIKETHROUGH*, IUnknown*) override { return S_OK; }
+        IFACEMETHODIMP DrawInlineObject(void*, FLOAT, FLOAT, IDWriteInlineObject*, BOOL, BOOL, IUnknown*) override { return S_OK; }
+};
+
+
+static bool SameColor(const GlyphColor& a, const GlyphColor& b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+
+DWriteGlyphSource::DWriteGlyphSource(IDWriteFactory* pFactory, DWriteRasterizer& fonts)
+    : m_pFactory(pFactory)
+    , m_Fonts(fonts)
+{}
+
+
+bool DWriteGlyphSource::Shape(const std::wstring& text, const std::vector<GlyphColor>& colors, const std::wstring& family,
+    const float& emSize, const float& maxWidth, const float& maxHeight, CodeGlyphs& glyphs, GlyphRect& bounds)
+{
+    glyphs.Clear();
+    bounds = GlyphRect {};
+
+    if (colors.size() != text.size())
+    {
+        std::cerr << "Code colors do not match the code\n";
+        return false;
+    }
+    if (!CreateFormat(family, emSize))
+        return false;
+
+    m_pGlyphs = &glyphs;
+    m_pColors = &colors;
+
+    bool bResult = true;
+    if (m_Grid.Build(m_pFactory.Get(), m_pFormat.Get(), text))
+    {
+        bounds = GlyphRect { 0.0f, 0.0f, m_Grid.GetWidth(), m_Grid.GetHeight() };
+
+        for (uint32_t line = 0; line < m_Grid.GetLineCount() && bResult; ++line)
+        {
+            const uint32_t start = m_Grid.GetLineStart(line);
+            const uint32_t end = m_Grid.GetLineEnd(line);
+            if (end <= start)
+                continue;
+
+            if (!m_Grid.IsShaped(line))
+            {
+                m_Advances.assign(end - start, m_Grid.GetAdvance());
+                m_GridClusters.resize(end - start);
+                for (uint32_t i = 0; i < end - start; ++i)
+                    m_GridClusters[i] = (uint16_t)i;
+
+                DWRITE_GLYPH_RUN run {};
+                run.fontFace = m_Grid.GetFontFace();
+                run.fontEmSize = m_Grid.GetEmSize();
+                run.glyphCount = end - start;
+                run.glyphIndices = m_Grid.GetGlyphs() + start;
+                run.glyphAdvances = m_Advances.data();
+                AddRun(m_Grid.GetPosition(start), run, start, end - start, m_GridClusters.data());
+                continue;
+            }
+
+            // Ligatures, surrogate pairs and font fallback need the shaper, one line at a time.
+            Microsoft::WRL::ComPtr<IDWriteTextLayout> pLine;
+            HRESULT hr = m_pFactory->CreateTextLayout(text.c_str() + start, end - start, m_pFormat.Get(),
+                maxWidth, m_Grid.GetHeight(), &pLine);
+            if (FAILED(hr))
+            {
+                PrintHR("CreateTextLayout(code line)", hr);
+                bResult = false;
+                break;
+            }
+
+            bResult = AddLayout(pLine.Get(), m_Grid.GetLineTop(line), start);
+        }
+    }
+    else
+    {
+        Microsoft::WRL::ComPtr<IDWriteTextLayout> pLayout;
+        DWRITE_TEXT_METRICS metrics {};
+        HRESULT hr = m_pFactory->CreateTextLayout(text.c_str(), (UINT32)text.size(), m_pFormat.Get(), maxWidth, maxHeight, &pLayout);
+        if (SUCCEEDED(hr))
+            hr = pLayout->GetMetrics(&metrics);
+        if (FAILED(hr))
+        {
+            PrintHR("CreateTextLayout(code)", hr);
+            bResult = false;
+        }
+        else
+        {
+            bounds = GlyphRect { metrics.left, metrics.top, metrics.left + metrics.width, metrics.top + metrics.height };
+            bResult = AddLayout(pLayout.Get(), 0.0f, 0);
+        }
+    }
+
+    m_pGlyphs = nullptr;
+    m_pColors = nullptr;
+
+    if (!bResult)
+    {
+        glyphs.Clear();
+        return false;
+    }
+
+    glyphs.End();
+    return true;
+}
+
+void DWriteGlyphSource::Draw(ID2D1DeviceContext* pContext, const D2D1_POINT_2F& origin, const GlyphRun& run, ID2D1Brush* pBrush)
+{
+    IDWriteFontFace* pFace = m_Fonts.GetFontFace(run.font);
+    if (!pFace || run.glyphCount == 0)
+        return;
+
+    m_DrawOffsets.resize(run.glyphCount);
+    for (uint32_t g = 0; g < run.glyphCount; ++g)
+        m_DrawOffsets[g] = DWRITE_GLYPH_OFFSET { run.offsets[g].advance, run.offsets[g].ascender };
+
+    DWRITE_GLYPH_RUN glyphRun {};
+    glyphRun.fontFace = pFace;
+    glyphRun.fontEmSize = run.emSize;
+    glyphRun.glyphCount = run.glyphCount;
+    glyphRun.glyphIndices = run.glyphs;
+    glyphRun.glyphAdvances = run.advances;
+    glyphRun.glyphOffsets = m_DrawOffsets.data();
+    glyphRun.bidiLevel = run.bidiLevel;
+
+    const D2D1_POINT_2F baseline = D2D1::Point2F(std::round(origin.x + run.x), std::round(origin.y + run.y));
+    pContext->DrawGlyphRun(baseline, &glyphRun, pBrush, DWRITE_MEASURING_MODE_NATURAL);
+}
+
+
+bool DWriteGlyphSource::CreateFormat(const std::wstring& family, const float& emSize)
+{
+    if (m_pFormat && m_Family == family && m_EmSize == emSize)
+        return true;
+
+    m_pFormat.Reset();
+    HRESULT hr = m_pFactory->CreateTextFormat(family.c_str(), nullptr, DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL,
+        DWRITE_FONT_STRETCH_NORMAL, emSize, L"en-us", &m_pFormat);
+    if (FAILED(hr))
+    {
+        PrintHR("CreateTextFormat(code)", hr);
+        return false;
+    }
+
+    m_pFormat->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+    m_pFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_LEADING);
+    m_pFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_NEAR);
+
+    m_Family = family;
+    m_EmSize = emSize;
+    return true;
+}
+
+bool DWriteGlyphSource::AddLayout(IDWriteTextLayout* pLayout, const float& y, const uint32_t& textOffset)
+{
+    m_TextOffset = textOffset;
+
+    GlyphRunCollector collector(*this);
+    HRESULT hr = pLayout->Draw(nullptr, &collector, 0.0f, y);
+    if (FAILED(hr))
+    {
+        std::cerr << "Failed to collect the code glyph runs\n";
+        return false;
+    }
+
+    return true;
+}
+
+void DWriteGlyphSource::AddRun(const D2D1_POINT_2F& baseline, const DWRITE_GLYPH_RUN& glyphRun, const uint32_t& textStart,
+    const uint32_t& textLength, const UINT16* clusters)
+{
+    if (glyphRun.glyphCount == 0 || textLength == 0)
+        return;
+
+    const std::vector<GlyphColor>& colors = *m_pColors;
+
+    DWRITE_FONT_METRICS metrics {};
+    glyphRun.fontFace->GetMetrics(&metrics);
+    const float scale = glyphRun.fontEmSize / std::max<float>(metrics.designUnitsPerEm, 1.0f);
+
+    m_Offsets.resize(glyphRun.glyphCount);
+    for (UINT32 g = 0; g < glyphRun.glyphCount; ++g)
+    {
+        m_Offsets[g] = glyphRun.glyphOffsets
+            ? GlyphOffset { glyphRun.glyphOffsets[g].advanceOffset, glyphRun.glyphOffsets[g].ascenderOffset }
+            : GlyphOffset {};
+    }
+
+    GlyphRun run;
+    run.y = baseline.y;
+    run.font = m_Fonts.GetFontId(glyphRun.fontFace);
+    run.emSize = glyphRun.fontEmSize;
+    run.ascent = metrics.ascent * scale;
+    run.descent = metrics.descent * scale;
+    run.bidiLevel = glyphRun.bidiLevel;
+
+    // A new piece starts where the color changes on a cluster boundary. Right-to-left glyphs run
+    // against the text, so those runs keep the color they start with.
+    const bool bSplit = (glyphRun.bidiLevel & 1) == 0;
+    float x = baseline.x;
+    for (uint32_t first = 0, last = 1; first < textLength; first = last++)
+    {
+        while (last < textLength && (!bSplit || clusters[last] == clusters[last - 1]
+            || SameColor(colors[textStart + last], colors[textStart + first])))
+            ++last;
+
+        const uint32_t firstGlyph = bSplit ? clusters[first] : 0;
+        const uint32_t endGlyph = bSplit && last < textLength ? clusters[last] : glyphRun.glyphCount;
+
+        m_Clusters.resize(last - first);
+        for (uint32_t c = first; c < last; ++c)
+            m_Clusters[c - first] = (uint16_t)(clusters[c] - firstGlyph);
+
+        run.x = x;
+        run.color = colors[textStart + first];
+        run.textStart = textStart + first;
+        run.textLength = last - first;
+        run.glyphCount = endGlyph - firstGlyph;
+        run.glyphs = glyphRun.glyphIndices + firstGlyph;
+        run.advances = glyphRun.glyphAdvances + firstGlyph;
+        run.offsets = m_Offsets.data() + firstGlyph;
+        run.clusters = m_Clusters.data();
+        m_pGlyphs->AddRun(run);
+
+        for (uint32_t g = firstGlyph; g < endGlyph; ++g)
+            x += glyphRun.glyphAdvances[g];
+    }
+}
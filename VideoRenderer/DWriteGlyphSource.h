@@ -0,0 +1,61 @@
+#pragma once
+
+#include <d2d1_1.h>
+#include <dwrite.h>
+#include <wrl/client.h>
+
+#include <string>
+#include <vector>
+
+#include "DWriteRasterizer.h"
+#include "GlyphSource.h"
+#include "MonoGrid.h"
+
+
+// GlyphSource over DirectWrite, with font ids from the DWriteRasterizer it is paired with.
+// Fixed-pitch code goes on a MonoGrid and only its shaped lines go through a text layout; any
+// other font is laid out as one paragraph. Runs are split where the color changes between clusters,
+// as drawing effects would split them. Also draws the runs back with Direct2D.
+class DWriteGlyphSource : public GlyphSource
+{
+    friend class GlyphRunCollector;
+
+    private:
+        Microsoft::WRL::ComPtr<IDWriteFactory> m_pFactory;
+        DWriteRasterizer& m_Fonts;
+        Microsoft::WRL::ComPtr<IDWriteTextFormat> m_pFormat;
+        std::wstring m_Family;
+        float m_EmSize = 0.0f;
+        MonoGrid m_Grid;
+
+        // While shaping.
+        CodeGlyphs* m_pGlyphs = nullptr;
+        const std::vector<GlyphColor>* m_pColors = nullptr;
+        uint32_t m_TextOffset = 0;      // code unit the layout being collected starts at
+
+        std::vector<uint16_t> m_GridClusters;
+        std::vector<uint16_t> m_Clusters;
+        std::vector<float> m_Advances;
+        std::vector<GlyphOffset> m_Offsets;
+        std::vector<DWRITE_GLYPH_OFFSET> m_DrawOffsets;
+
+
+    public:
+        DWriteGlyphSource(IDWriteFactory* pFactory, DWriteRasterizer& fonts);
+
+        bool Shape(const std::wstring& text, const std::vector<GlyphColor>& colors, const std::wstring& family,
+            const float& emSize, const float& maxWidth, const float& maxHeight, CodeGlyphs& glyphs, GlyphRect& bounds) override;
+
+        // Draws glyphs CodeGlyphs handed back, offset by `origin`, with the baseline snapped to whole
+        // pixels where DrawTextLayout puts it.
+        void Draw(ID2D1DeviceContext* pContext, const D2D1_POINT_2F& origin, const GlyphRun& run, ID2D1Brush* pBrush);
+
+
+    private:
+        bool CreateFormat(const std::wstring& family, const float& emSize);
+        bool AddLayout(IDWriteTextLayout* pLayout, const float& y, const uint32_t& textOffset);
+
+        // Code units [textStart, textStart + textLength) drawn by `glyphRun` with the given cluster map.
+        void AddRun(const D2D1_POINT_2F& baseline, const DWRITE_GLYPH_RUN& glyphRun, const uint32_t& textStart,
+            const uint32_t& textLength, const UINT16* clusters);
+};
@@ -0,0 +1,80 @@
+#include "DWriteRasterizer.h"
+#include "HResult.h"
+
+#include <iostream>
+
+
+DWriteRasterizer::DWriteRasterizer(IDWriteFactory* pFactory)
+    : m_pFactory(pFactory)
+{}
+
+
+uint32_t DWriteRasterizer::GetFontId(IDWriteFontFace* pFace)
+{
+    for (size_t i = 0; i < m_Faces.size(); ++i)
+    {
+        if (m_Faces[i].Get() == pFace)
+            return (uint32_t)i;
+    }
+
+    m_Faces.emplace_back(pFace);
+    return (uint32_t)m_Faces.size() - 1;
+}
+
+bool DWriteRasterizer::Rasterize(const uint32_t& font, const uint16_t& glyph, const float& emSize, const uint8_t& subpixel,
+    GlyphBitmap& bitmap)
+{
+    bitmap.left = bitmap.top = 0;
+    bitmap.width = bitmap.height = 0;
+    bitmap.coverage.clear();
+
+    if (font >= m_Faces.size())
+        return false;
+
+    const UINT16 index = glyph;
+    const FLOAT advance = 0.0f;
+    const DWRITE_GLYPH_OFFSET offset {};
+
+    DWRITE_GLYPH_RUN run {};
+    run.fontFace = m_Faces[font].Get();
+    run.fontEmSize = emSize;
+    run.glyphCount = 1;
+    run.glyphIndices = &index;
+    run.glyphAdvances = &advance;
+    run.glyphOffsets = &offset;
+
+    Microsoft::WRL::ComPtr<IDWriteGlyphRunAnalysis> pAnalysis;
+    HRESULT hr = m_pFactory->CreateGlyphRunAnalysis(&run, 1.0f, nullptr, DWRITE_RENDERING_MODE_NATURAL_SYMMETRIC,
+        DWRITE_MEASURING_MODE_NATURAL, subpixel * 0.25f, 0.0f, &pAnalysis);
+    if (FAILED(hr))
+    {
+        PrintHR("CreateGlyphRunAnalysis", hr);
+        return false;
+    }
+
+    RECT bounds {};
+    hr = pAnalysis->GetAlphaTextureBounds(DWRITE_TEXTURE_CLEARTYPE_3x1, &bounds);
+    if (FAILED(hr))
+        return false;
+
+    // Blank glyphs come back with empty bounds.
+    if (bounds.right <= bounds.left || bounds.bottom <= bounds.top)
+        return true;
+
+    const uint32_t width = (uint32_t)(bounds.right - bounds.left);
+    const uint32_t height = (uint32_t)(bounds.bottom - bounds.top);
+    m_Texture.resize((size_t)width * height * 3);
+    hr = pAnalysis->CreateAlphaTexture(DWRITE_TEXTURE_CLEARTYPE_3x1, &bounds, m_Texture.data(), (UINT32)m_Texture.size());
+    if (FAILED(hr))
+        return false;
+
+    bitmap.left = bounds.left;
+    bitmap.top = bounds.top;
+    bitmap.width = width;
+    bitmap.height = height;
+    bitmap.coverage.resize((size_t)width * height);
+    for (size_t i = 0; i < bitmap.coverage.size(); ++i)
+        bitmap.coverage[i] = (uint8_t)((m_Texture[i * 3] + m_Texture[i * 3 + 1] + m_Texture[i * 3 + 2] + 1) / 3);
+
+    return true;
+}
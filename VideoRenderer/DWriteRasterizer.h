@@ -0,0 +1,30 @@
+#pragma once
+
+#include <dwrite.h>
+#include <wrl/client.h>
+
+#include <vector>
+
+#include "GlyphAtlas.h"
+
+
+// GlyphRasterizer over DirectWrite's glyph run analysis, with font ids handed out per font face.
+// ClearType's three coverage samples per pixel are averaged into grayscale.
+class DWriteRasterizer : public GlyphRasterizer
+{
+    private:
+        Microsoft::WRL::ComPtr<IDWriteFactory> m_pFactory;
+        std::vector<Microsoft::WRL::ComPtr<IDWriteFontFace>> m_Faces;
+        std::vector<uint8_t> m_Texture;
+
+
+    public:
+        explicit DWriteRasterizer(IDWriteFactory* pFactory);
+
+        // Id of `pFace` for GlyphAtlas, the same one every time the face is passed in.
+        uint32_t GetFontId(IDWriteFontFace* pFace);
+        IDWriteFontFace* GetFontFace(const uint32_t& font) const { return font < m_Faces.size() ? m_Faces[font].Get() : nullptr; }
+
+        bool Rasterize(const uint32_t& font, const uint16_t& glyph, const float& emSize, const uint8_t& subpixel,
+            GlyphBitmap& bitmap) override;
+};
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
 #include <numbers>
 
+#include "Simd.h"
+
 
 float EaseInSine(float x);
 float EaseOutSine(float x);
@@ -46,3 +49,40 @@ float EaseInOutBounce(float x);
 
 float EaseInAEDoubleBack(float x);
 float EaseOutAEDoubleBack(float x);
+
+
+// Batched: out[i] = EaseX(x[i]) for count values. With AVX2 the sines, cosines and powers of two
+// are single-precision polynomials and the rest is exact float arithmetic; the scalar functions
+// above run in double. Largest absolute difference from them over [0, 1]:
+//   Sine               1.2e-7
+//   Cubic              6.0e-8
+//   Expo               6.0e-8
+//   Circ               8.4e-7 (1 - x*x cancels near the ends, in float)
+//   Elastic            1.3e-7
+//   AEDoubleBack       1.8e-7
+// Without AVX2 they call the scalar functions. x and out may be the same array.
+void EaseInSine(const float* x, float* out, const size_t& count);
+void EaseOutSine(const float* x, float* out, const size_t& count);
+void EaseInOutSine(const float* x, float* out, const size_t& count);
+
+void EaseInCubic(const float* x, float* out, const size_t& count);
+void EaseOutCubic(const float* x, float* out, const size_t& count);
+void EaseInOutCubic(const float* x, float* out, const size_t& count);
+
+void EaseInExpo(const float* x, float* out, const size_t& count);
+void EaseOutExpo(const float* x, float* out, const size_t& count);
+void EaseInOutExpo(const float* x, float* out, const size_t& count);
+
+void EaseInCirc(const float* x, float* out, const size_t& count);
+void EaseOutCirc(const float* x, float* out, const size_t& count);
+void EaseInOutCirc(const float* x, float* out, const size_t& count);
+
+void EaseInElastic(const float* x, float* out, const size_t& count);
+void EaseOutElastic(const float* x, float* out, const size_t& count);
+void EaseInOutElastic(const float* x, float* out, const size_t& count);
+
+void EaseInAEDoubleBack(const float* x, float* out, const size_t& count);
+void EaseOutAEDoubleBack(const float* x, float* out, const size_t& count);
+
+SimdLevel GetEasingSimdLevel();
+void SetEasingSimdLevel(const SimdLevel& level);
@@ -0,0 +1,448 @@
+#include "Easing.h"
+#include "KeyframeCurve.h"
+#include "Simd.h"
+
+#include <cstring>
+
+
+static SimdLevel& GetLevel()
+{
+    static SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+SimdLevel GetEasingSimdLevel()
+{
+    return GetLevel();
+}
+
+void SetEasingSimdLevel(const SimdLevel& level)
+{
+    GetLevel() = level;
+}
+
+
+#if VR_SIMD_X86
+// Single-precision polynomial approximations after Cephes sinf/cosf/exp2f. Plain mul/add, no FMA,
+// so results do not depend on which AVX2 machine runs them.
+
+// Both sin(x) and cos(x). The argument is reduced to |r| <= pi/4 around the nearest multiple of
+// pi/2 in three steps (Cody-Waite), which stays accurate for the |x| < 100 the curves produce.
+VR_TARGET_AVX2 static inline void SinCos8(const __m256& x, __m256& sinOut, __m256& cosOut)
+{
+    const __m256 q = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(q, _mm256_set1_ps(1.5703125f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(4.837512969970703125e-4f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(7.54978995489188216e-8f)));
+
+    const __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 s = _mm256_set1_ps(-1.9515295891e-4f);
+    s = _mm256_add_ps(_mm256_mul_ps(s, r2), _mm256_set1_ps(8.3321608736e-3f));
+    s = _mm256_add_ps(_mm256_mul_ps(s, r2), _mm256_set1_ps(-1.6666654611e-1f));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, r2), r), r);
+
+    __m256 c = _mm256_set1_ps(2.443315711809948e-5f);
+    c = _mm256_add_ps(_mm256_mul_ps(c, r2), _mm256_set1_ps(-1.388731625493765e-3f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, r2), _mm256_set1_ps(4.166664568298827e-2f));
+    c = _mm256_mul_ps(_mm256_mul_ps(c, r2), r2);
+    c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+    // Quadrant q mod 4: (sin, cos) = (s, c), (c, -s), (-s, -c), (-c, s)
+    const __m256i qi = _mm256_cvtps_epi32(q);
+    const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(qi, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(qi, _mm256_set1_epi32(2)), 30));
+    const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_and_si256(_mm256_add_epi32(qi, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+
+    sinOut = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign);
+    cosOut = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign);
+}
+
+VR_TARGET_AVX2 static inline __m256 Sin8(const __m256& x)
+{
+    __m256 s, c;
+    SinCos8(x, s, c);
+    return s;
+}
+
+VR_TARGET_AVX2 static inline __m256 Cos8(const __m256& x)
+{
+    __m256 s, c;
+    SinCos8(x, s, c);
+    return c;
+}
+
+// 2^y as 2^round(y) * 2^f with |f| <= 0.5. Underflows to 0 below -126.
+VR_TARGET_AVX2 static inline __m256 Exp2_8(const __m256& y)
+{
+    const __m256 clamped = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-127.0f)), _mm256_set1_ps(127.0f));
+    const __m256 n = _mm256_round_ps(clamped, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256 f = _mm256_sub_ps(clamped, n);
+
+    __m256 p = _mm256_set1_ps(1.535336188319500e-4f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.339887440266574e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.618437357674640e-3f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.550332471162809e-2f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.402264791363012e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.931472028550421e-1f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+
+    const __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    const __m256 scale = _mm256_castsi256_ps(e);
+    return _mm256_and_ps(_mm256_mul_ps(p, scale), _mm256_cmp_ps(n, _mm256_set1_ps(-127.0f), _CMP_GT_OQ));
+}
+
+VR_TARGET_AVX2 static inline __m256 Select(const __m256& mask, const __m256& a, const __m256& b)
+{
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+VR_TARGET_AVX2 static inline __m256 Equal(const __m256& x, const float& v)
+{
+    return _mm256_cmp_ps(x, _mm256_set1_ps(v), _CMP_EQ_OQ);
+}
+
+VR_TARGET_AVX2 static inline __m256 Less(const __m256& x, const float& v)
+{
+    return _mm256_cmp_ps(x, _mm256_set1_ps(v), _CMP_LT_OQ);
+}
+
+
+VR_TARGET_AVX2 static inline __m256 InSine8(const __m256& x)
+{
+    return _mm256_sub_ps(_mm256_set1_ps(1.0f), Cos8(_mm256_mul_ps(x, _mm256_set1_ps(1.57079633f))));
+}
+
+VR_TARGET_AVX2 static inline __m256 OutSine8(const __m256& x)
+{
+    return Sin8(_mm256_mul_ps(x, _mm256_set1_ps(1.57079633f)));
+}
+
+VR_TARGET_AVX2 static inline __m256 InOutSine8(const __m256& x)
+{
+    const __m256 c = Cos8(_mm256_mul_ps(x, _mm256_set1_ps(3.14159265f)));
+    return _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), c), _mm256_set1_ps(0.5f));
+}
+
+VR_TARGET_AVX2 static inline __m256 InCubic8(const __m256& x)
+{
+    return _mm256_mul_ps(_mm256_mul_ps(x, x), x);
+}
+
+VR_TARGET_AVX2 static inline __m256 OutCubic8(const __m256& x)
+{
+    const __m256 u = _mm256_sub_ps(_mm256_set1_ps(1.0f), x);
+    return _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_mul_ps(u, u), u));
+}
+
+VR_TARGET_AVX2 static inline __m256 InOutCubic8(const __m256& x)
+{
+    const __m256 u = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(-2.0f)), _mm256_set1_ps(2.0f));
+    const __m256 lo = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(x, x), x), _mm256_set1_ps(4.0f));
+    const __m256 hi = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(u, u), u), _mm256_set1_ps(0.5f)));
+    return Select(Less(x, 0.5f), lo, hi);
+}
+
+VR_TARGET_AVX2 static inline __m256 InExpo8(const __m256& x)
+{
+    const __m256 v = Exp2_8(_mm256_sub_ps(_mm256_mul_ps(x, _mm256_set1_ps(10.0f)), _mm256_set1_ps(10.0f)));
+    return _mm256_andnot_ps(Equal(x, 0.0f), v);
+}
+
+VR_TARGET_AVX2 static inline __m256 OutExpo8(const __m256& x)
+{
+    const __m256 v = _mm256_sub_ps(_mm256_set1_ps(1.0f), Exp2_8(_mm256_mul_ps(x, _mm256_set1_ps(-10.0f))));
+    return Select(Equal(x, 1.0f), _mm256_set1_ps(1.0f), v);
+}
+
+VR_TARGET_AVX2 static inline __m256 InOutExpo8(const __m256& x)
+{
+    const __m256 y = _mm256_mul_ps(x, _mm256_set1_ps(20.0f));
+    const __m256 lo = _mm256_mul_ps(Exp2_8(_mm256_sub_ps(y, _mm256_set1_ps(10.0f))), _mm256_set1_ps(0.5f));
+    const __m256 hi = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(2.0f), Exp2_8(_mm256_sub_ps(_mm256_set1_ps(10.0f), y))),
+        _mm256_set1_ps(0.5f));
+
+    __m256 v = Select(Less(x, 0.5f), lo, hi);
+    v = Select(Equal(x, 1.0f), _mm256_set1_ps(1.0f), v);
+    return _mm256_andnot_ps(Equal(x, 0.0f), v);
+}
+
+VR_TARGET_AVX2 static inline __m256 InCirc8(const __m256& x)
+{
+    return _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x, x))));
+}
+
+VR_TARGET_AVX2 static inline __m256 OutCirc8(const __m256& x)
+{
+    const __m256 u = _mm256_sub_ps(x, _mm256_set1_ps(1.0f));
+    return _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(u, u)));
+}
+
+VR_TARGET_AVX2 static inline __m256 InOutCirc8(const __m256& x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 a = _mm256_add_ps(x, x);
+    const __m256 b = _mm256_sub_ps(_mm256_set1_ps(2.0f), a);
+
+    const __m256 lo = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_sqrt_ps(_mm256_sub_ps(one, _mm256_mul_ps(a, a)))), half);
+    const __m256 hi = _mm256_mul_ps(_mm256_add_ps(_mm256_sqrt_ps(_mm256_sub_ps(one, _mm256_mul_ps(b, b))), one), half);
+    return Select(Less(x, 0.5f), lo, hi);
+}
+
+VR_TARGET_AVX2 static inline __m256 InElastic8(const __m256& x)
+{
+    const __m256 a = _mm256_sub_ps(_mm256_mul_ps(x, _mm256_set1_ps(10.0f)), _mm256_set1_ps(10.0f));
+    const __m256 s = Sin8(_mm256_mul_ps(_mm256_sub_ps(a, _mm256_set1_ps(0.75f)), _mm256_set1_ps(2.09439510f)));
+    __m256 v = _mm256_xor_ps(_mm256_mul_ps(Exp2_8(a), s), _mm256_set1_ps(-0.0f));
+
+    v = Select(Equal(x, 1.0f), _mm256_set1_ps(1.0f), v);
+    return _mm256_andnot_ps(Equal(x, 0.0f), v);
+}
+
+VR_TARGET_AVX2 static inline __m256 OutElastic8(const __m256& x)
+{
+    const __m256 a = _mm256_mul_ps(x, _mm256_set1_ps(10.0f));
+    const __m256 s = Sin8(_mm256_mul_ps(_mm256_sub_ps(a, _mm256_set1_ps(0.75f)), _mm256_set1_ps(2.09439510f)));
+    __m256 v = _mm256_add_ps(_mm256_mul_ps(Exp2_8(_mm256_xor_ps(a, _mm256_set1_ps(-0.0f))), s), _mm256_set1_ps(1.0f));
+
+    v = Select(Equal(x, 1.0f), _mm256_set1_ps(1.0f), v);
+    return _mm256_andnot_ps(Equal(x, 0.0f), v);
+}
+
+VR_TARGET_AVX2 static inline __m256 InOutElastic8(const __m256& x)
+{
+    const __m256 y = _mm256_sub_ps(_mm256_mul_ps(x, _mm256_set1_ps(20.0f)), _mm256_set1_ps(10.0f));
+    const __m256 s = Sin8(_mm256_mul_ps(_mm256_sub_ps(y, _mm256_set1_ps(1.125f)), _mm256_set1_ps(1.39626340f)));
+
+    const __m256 lo = _mm256_mul_ps(_mm256_mul_ps(Exp2_8(y), s), _mm256_set1_ps(-0.5f));
+    const __m256 hi = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(Exp2_8(_mm256_xor_ps(y, _mm256_set1_ps(-0.0f))), s),
+        _mm256_set1_ps(0.5f)), _mm256_set1_ps(1.0f));
+
+    __m256 v = Select(Less(x, 0.5f), lo, hi);
+    v = Select(Equal(x, 1.0f), _mm256_set1_ps(1.0f), v);
+    return _mm256_andnot_ps(Equal(x, 0.0f), v);
+}
+
+// KeyframeCurve with InOutSine segments, clamped outside the first and last key. Every lane
+// evaluates the segment it falls into with one cosine.
+template <size_t N>
+VR_TARGET_AVX2 static inline __m256 KeyframeCurve8(const __m256& x, const std::array<Keyframe, N>& keys)
+{
+    __m256 k0 = _mm256_set1_ps(keys[0].t);
+    __m256 k1 = _mm256_set1_ps(keys[1].t);
+    __m256 v0 = _mm256_set1_ps(keys[0].v);
+    __m256 v1 = _mm256_set1_ps(keys[1].v);
+    for (size_t i = 1; i + 1 < N; ++i)
+    {
+        const __m256 inNext = _mm256_cmp_ps(x, _mm256_set1_ps(keys[i].t), _CMP_GE_OQ);
+        k0 = Select(inNext, _mm256_set1_ps(keys[i].t), k0);
+        k1 = Select(inNext, _mm256_set1_ps(keys[i + 1].t), k1);
+        v0 = Select(inNext, _mm256_set1_ps(keys[i].v), v0);
+        v1 = Select(inNext, _mm256_set1_ps(keys[i + 1].v), v1);
+    }
+
+    const __m256 s = _mm256_div_ps(_mm256_sub_ps(x, k0), _mm256_sub_ps(k1, k0));
+    const __m256 e = InOutSine8(s);
+    __m256 out = _mm256_add_ps(v0, _mm256_mul_ps(e, _mm256_sub_ps(v1, v0)));
+
+    out = Select(_mm256_cmp_ps(x, _mm256_set1_ps(keys[0].t), _CMP_LE_OQ), _mm256_set1_ps(keys[0].v), out);
+    return Select(_mm256_cmp_ps(x, _mm256_set1_ps(keys[N - 1].t), _CMP_GE_OQ), _mm256_set1_ps(keys[N - 1].v), out);
+}
+
+VR_TARGET_AVX2 static inline __m256 InAEDoubleBack8(const __m256& x)
+{
+    return KeyframeCurve8(x, InAEDoubleBackCurve.GetKeys());
+}
+
+VR_TARGET_AVX2 static inline __m256 OutAEDoubleBack8(const __m256& x)
+{
+    return KeyframeCurve8(x, OutAEDoubleBackCurve.GetKeys());
+}
+
+
+// The tail goes through the same kernel via a padded copy, so a value does not depend on where in
+// the span it sits.
+template <__m256 (*Kernel)(const __m256&)>
+VR_TARGET_AVX2 static void ApplyAVX2(const float* x, float* out, const size_t& count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, Kernel(_mm256_loadu_ps(x + i)));
+
+    if (i < count)
+    {
+        alignas(32) float tail[8] {};
+        std::memcpy(tail, x + i, (count - i) * sizeof(float));
+        _mm256_store_ps(tail, Kernel(_mm256_load_ps(tail)));
+        std::memcpy(out + i, tail, (count - i) * sizeof(float));
+    }
+}
+
+#endif
+
+static void ApplyScalar(float (*fn)(float), const float* x, float* out, const size_t& count)
+{
+    for (size_t i = 0; i < count; ++i)
+        out[i] = fn(x[i]);
+}
+
+void EaseInSine(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InSine8>(x, out, count);
+#endif
+    ApplyScalar(EaseInSine, x, out, count);
+}
+
+void EaseOutSine(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<OutSine8>(x, out, count);
+#endif
+    ApplyScalar(EaseOutSine, x, out, count);
+}
+
+void EaseInOutSine(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InOutSine8>(x, out, count);
+#endif
+    ApplyScalar(EaseInOutSine, x, out, count);
+}
+
+
+void EaseInCubic(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InCubic8>(x, out, count);
+#endif
+    ApplyScalar(EaseInCubic, x, out, count);
+}
+
+void EaseOutCubic(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<OutCubic8>(x, out, count);
+#endif
+    ApplyScalar(EaseOutCubic, x, out, count);
+}
+
+void EaseInOutCubic(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InOutCubic8>(x, out, count);
+#endif
+    ApplyScalar(EaseInOutCubic, x, out, count);
+}
+
+
+void EaseInExpo(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InExpo8>(x, out, count);
+#endif
+    ApplyScalar(EaseInExpo, x, out, count);
+}
+
+void EaseOutExpo(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<OutExpo8>(x, out, count);
+#endif
+    ApplyScalar(EaseOutExpo, x, out, count);
+}
+
+void EaseInOutExpo(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InOutExpo8>(x, out, count);
+#endif
+    ApplyScalar(EaseInOutExpo, x, out, count);
+}
+
+
+void EaseInCirc(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InCirc8>(x, out, count);
+#endif
+    ApplyScalar(EaseInCirc, x, out, count);
+}
+
+void EaseOutCirc(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<OutCirc8>(x, out, count);
+#endif
+    ApplyScalar(EaseOutCirc, x, out, count);
+}
+
+void EaseInOutCirc(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InOutCirc8>(x, out, count);
+#endif
+    ApplyScalar(EaseInOutCirc, x, out, count);
+}
+
+
+void EaseInElastic(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InElastic8>(x, out, count);
+#endif
+    ApplyScalar(EaseInElastic, x, out, count);
+}
+
+void EaseOutElastic(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<OutElastic8>(x, out, count);
+#endif
+    ApplyScalar(EaseOutElastic, x, out, count);
+}
+
+void EaseInOutElastic(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InOutElastic8>(x, out, count);
+#endif
+    ApplyScalar(EaseInOutElastic, x, out, count);
+}
+
+
+void EaseInAEDoubleBack(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<InAEDoubleBack8>(x, out, count);
+#endif
+    ApplyScalar(EaseInAEDoubleBack, x, out, count);
+}
+
+void EaseOutAEDoubleBack(const float* x, float* out, const size_t& count)
+{
+#if VR_SIMD_X86
+    if (GetLevel() == SimdLevel::AVX2)
+        return ApplyAVX2<OutAEDoubleBack8>(x, out, count);
+#endif
+    ApplyScalar(EaseOutAEDoubleBack, x, out, count);
+}
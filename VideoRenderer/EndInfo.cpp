@@ -49,6 +49,12 @@ EndInfo::EndInfo(const int& n, const D2D1_POINT_2F& windowSize, const float& hea
     outFile.close();
 }
 
+EndInfo::EndInfo(const D2D1_POINT_2F& windowSize, const float& headerY)
+    : m_WindowX(windowSize.x)
+    , m_WindowY(windowSize.y)
+    , m_HeaderY(headerY)
+{}
+
 
 std::wstring EndInfo::AfterPrefix(const std::wstring& s, const std::wstring& prefix)
 {
@@ -17,6 +17,7 @@ class EndInfo
 	public:
 		EndInfo(const int& n);
 		EndInfo(const int& n, const D2D1_POINT_2F& windowSize, const float& headerY);
+		EndInfo(const D2D1_POINT_2F& windowSize, const float& headerY);
 
 
 	private:
@@ -0,0 +1,161 @@
+#include "FramePipeline.h"
+#include "ColorConverter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+using PipelineClock = std::chrono::high_resolution_clock;
+
+static double MillisecondsSince(const PipelineClock::time_point& t0)
+{
+    return std::chrono::duration<double, std::milli>(PipelineClock::now() - t0).count();
+}
+
+
+FramePipeline::FramePipeline(VideoEncoder* pEncoder, const uint32_t& depth)
+    : m_pEncoder(pEncoder)
+    , m_Depth(std::max(depth, 1u))
+    , m_Free(m_Depth)
+    , m_ToConvert(m_Depth + 1)
+    , m_ToEncode(m_Depth + 1)
+{
+    m_Frames.reserve(m_Depth);
+    for (uint32_t i = 0; i < m_Depth; ++i)
+    {
+        m_Frames.push_back(std::make_unique<PipelineFrame>());
+        m_Free.TryPush(m_Frames.back().get());
+    }
+}
+
+FramePipeline::~FramePipeline()
+{
+    if (m_ConvertThread.joinable() || m_EncodeThread.joinable())
+        Finish();
+}
+
+
+void FramePipeline::Start()
+{
+    m_ConvertThread = std::thread([this]() { ConvertLoop(); });
+    m_EncodeThread = std::thread([this]() { EncodeLoop(); });
+}
+
+PipelineFrame* FramePipeline::Acquire()
+{
+    auto t0 = PipelineClock::now();
+    PipelineFrame* pFrame = m_Free.Pop();
+    m_RenderStats.waitMs += MillisecondsSince(t0);
+
+    // The buffer stays owned by m_Frames; only the encode thread may push to m_Free.
+    return m_bFailed.load() ? nullptr : pFrame;
+}
+
+void FramePipeline::Submit(PipelineFrame* pFrame)
+{
+    m_ToConvert.Push(pFrame);
+}
+
+void FramePipeline::Close(const bool& bFinalize)
+{
+    if (m_bClosed)
+        return;
+
+    m_bFinalize = bFinalize;
+    m_bClosed = true;
+    m_ToConvert.Push(nullptr);
+}
+
+bool FramePipeline::Finish()
+{
+    Close();
+
+    if (m_ConvertThread.joinable())
+        m_ConvertThread.join();
+    if (m_EncodeThread.joinable())
+        m_EncodeThread.join();
+
+    return !m_bFailed.load();
+}
+
+
+void FramePipeline::ConvertLoop()
+{
+    while (true)
+    {
+        auto t0 = PipelineClock::now();
+        PipelineFrame* pFrame = m_ToConvert.Pop();
+        m_ConvertStats.waitMs += MillisecondsSince(t0);
+
+        if (!pFrame)
+        {
+            m_ToEncode.Push(nullptr);
+            return;
+        }
+
+        auto t1 = PipelineClock::now();
+        if (!m_bFailed.load() && !pFrame->bRepeat)
+        {
+            if (pFrame->bHasRgba)
+                ColorConverter::Convert(pFrame->rgba, m_pEncoder->GetOutputFormat(), pFrame->yuv);
+            else if (!ColorConverter::Repack(pFrame->p010, m_pEncoder->GetOutputFormat(), pFrame->yuv))
+            {
+                std::cerr << "Cannot repack P010 into " << GetFormatInfo(m_pEncoder->GetOutputFormat()).name << "\n";
+                m_bFailed.store(true);
+            }
+        }
+        m_ConvertStats.busyMs += MillisecondsSince(t1);
+        ++m_ConvertStats.frames;
+
+        m_ToEncode.Push(pFrame);
+    }
+}
+
+void FramePipeline::EncodeLoop()
+{
+    while (true)
+    {
+        auto t0 = PipelineClock::now();
+        PipelineFrame* pFrame = m_ToEncode.Pop();
+        m_EncodeStats.waitMs += MillisecondsSince(t0);
+
+        if (!pFrame)
+        {
+            if (m_bFinalize && !m_pEncoder->Finalize())
+                m_bFailed.store(true);
+            return;
+        }
+
+        // After a failure frames still cycle back so the render thread never blocks forever.
+        auto t1 = PipelineClock::now();
+        if (!m_bFailed.load() && !(pFrame->bRepeat ? m_pEncoder->RepeatFrame() : m_pEncoder->EncodeFrame(pFrame->yuv)))
+        {
+            std::cerr << "Failed to encode frame " << pFrame->number << "\n";
+            m_bFailed.store(true);
+        }
+        m_EncodeStats.busyMs += MillisecondsSince(t1);
+        ++m_EncodeStats.frames;
+
+        m_Free.Push(pFrame);
+    }
+}
+
+
+void FramePipeline::PrintStats() const
+{
+    auto Print = [](const char* name, const StageStats& s)
+    {
+        const double n = (double)std::max<uint64_t>(s.frames, 1);
+        std::cout << "  " << name << ": " << s.busyMs / n << " ms/frame busy, " << s.waitMs / n << " ms/frame waiting\n";
+    };
+
+    std::cout << "Pipeline (depth " << m_Depth << "):\n";
+    Print("render ", m_RenderStats);
+    Print("convert", m_ConvertStats);
+    Print("encode ", m_EncodeStats);
+
+    std::cout << "  convert queue " << m_ToConvert.GetAverageOccupancy() << '/' << m_ToConvert.GetCapacity()
+        << " avg, encode queue " << m_ToEncode.GetAverageOccupancy() << '/' << m_ToEncode.GetCapacity()
+        << " avg, render stalled on " << m_Free.GetEmptyWaits() << " buffers\n";
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "CpuFrame.h"
+#include "SpscRing.h"
+#include "VideoEncoder.h"
+
+
+// A recycled frame buffer. The render stage fills either `rgba` or `p010`, the convert stage
+// turns it into `yuv` in the encoder's format, the encode stage sends `yuv`. A repeat frame
+// carries no pixels and is sent as the previous frame again.
+struct PipelineFrame
+{
+    uint32_t number = 0;
+    bool bRepeat = false;
+    bool bHasRgba = false;
+    uint64_t serial = 0;        // Renderer output frame rgba or p010 holds; 0 if it came from elsewhere
+    CpuFrame rgba;
+    P010Frame p010;
+    YuvFrame yuv;
+};
+
+struct StageStats
+{
+    uint64_t frames = 0;
+    double busyMs = 0.0;
+    double waitMs = 0.0;
+};
+
+
+// Render -> convert -> encode, one thread per stage after the first, connected by SPSC rings.
+// `depth` buffers circulate; when all are in flight Acquire blocks, which throttles rendering to
+// the slowest stage. A null frame marks the end of the stream.
+class FramePipeline
+{
+    private:
+        VideoEncoder* m_pEncoder = nullptr;
+        uint32_t m_Depth = 0;
+
+        std::vector<std::unique_ptr<PipelineFrame>> m_Frames;
+        SpscRing<PipelineFrame*> m_Free;
+        SpscRing<PipelineFrame*> m_ToConvert;
+        SpscRing<PipelineFrame*> m_ToEncode;
+
+        std::thread m_ConvertThread;
+        std::thread m_EncodeThread;
+        std::atomic<bool> m_bFailed { false };
+        bool m_bClosed = false;
+        bool m_bFinalize = false;
+
+        StageStats m_RenderStats;
+        StageStats m_ConvertStats;
+        StageStats m_EncodeStats;
+
+
+    public:
+        FramePipeline(VideoEncoder* pEncoder, const uint32_t& depth);
+        ~FramePipeline();
+
+        void Start();
+
+        // Render-thread side. Acquire returns nullptr once a later stage has failed.
+        PipelineFrame* Acquire();
+        void Submit(PipelineFrame* pFrame);
+
+        // Ends the stream without waiting for it. With bFinalize the encode thread also finalizes
+        // the encoder after the last frame, so the caller can move on while the codec flushes.
+        void Close(const bool& bFinalize = false);
+
+        // Flushes the stages and joins them; false if any frame failed to convert or encode.
+        bool Finish();
+
+        void AddRenderTime(const double& ms) { m_RenderStats.busyMs += ms; ++m_RenderStats.frames; }
+        void PrintStats() const;
+
+
+    private:
+        void ConvertLoop();
+        void EncodeLoop();
+};
@@ -0,0 +1,287 @@
+#include "GaussianBlur.h"
+#include "Hash.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+static constexpr uint32_t StripPixels = 16;
+static constexpr uint32_t StripLanes = StripPixels * 4;
+static constexpr uint32_t TileSize = 32;
+
+
+// Running-sum box of width 2r+1 down one strip of `lanes` bytes, edges clamped. Sums stay in uint32
+// and are scaled by a 16.16 reciprocal.
+static void BoxStripScalar(const uint8_t* src, uint8_t* dst, const size_t& pitch, const uint32_t& height,
+    const uint32_t& lanes, const uint32_t& r, const uint32_t& mul)
+{
+    const uint32_t last = height - 1;
+    uint32_t acc[StripLanes];
+
+    for (uint32_t i = 0; i < lanes; ++i)
+        acc[i] = src[i] * (r + 1);
+    for (uint32_t k = 1; k <= r; ++k)
+    {
+        const uint8_t* row = src + std::min(k, last) * pitch;
+        for (uint32_t i = 0; i < lanes; ++i)
+            acc[i] += row[i];
+    }
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint8_t* out = dst + y * pitch;
+        const uint8_t* add = src + std::min(y + r + 1, last) * pitch;
+        const uint8_t* sub = src + (y > r ? y - r : 0) * pitch;
+
+        for (uint32_t i = 0; i < lanes; ++i)
+        {
+            out[i] = (uint8_t)std::min((acc[i] * mul + 32768u) >> 16, 255u);
+            acc[i] += add[i];
+            acc[i] -= sub[i];
+        }
+    }
+}
+
+#if VR_SIMD_X86
+
+VR_TARGET_AVX2 static inline __m256i LoadLanes8(const uint8_t* p)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+
+// Same arithmetic as BoxStripScalar for a full 16-pixel strip, all 64 sums kept in registers.
+VR_TARGET_AVX2 static void BoxStripAVX2(const uint8_t* src, uint8_t* dst, const size_t& pitch, const uint32_t& height,
+    const uint32_t& r, const uint32_t& mul)
+{
+    constexpr uint32_t Vectors = StripLanes / 8;
+    const uint32_t last = height - 1;
+    const __m256i vMul = _mm256_set1_epi32((int)mul);
+    const __m256i vRound = _mm256_set1_epi32(32768);
+    const __m256i vMax = _mm256_set1_epi32(255);
+    const __m256i vFirst = _mm256_set1_epi32((int)(r + 1));
+    const __m256i vPick = _mm256_setr_epi8
+    (
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+    );
+
+    __m256i acc[Vectors];
+    for (uint32_t v = 0; v < Vectors; ++v)
+        acc[v] = _mm256_mullo_epi32(LoadLanes8(src + v * 8), vFirst);
+    for (uint32_t k = 1; k <= r; ++k)
+    {
+        const uint8_t* row = src + std::min(k, last) * pitch;
+        for (uint32_t v = 0; v < Vectors; ++v)
+            acc[v] = _mm256_add_epi32(acc[v], LoadLanes8(row + v * 8));
+    }
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint8_t* out = dst + y * pitch;
+        const uint8_t* add = src + std::min(y + r + 1, last) * pitch;
+        const uint8_t* sub = src + (y > r ? y - r : 0) * pitch;
+
+        for (uint32_t v = 0; v < Vectors; ++v)
+        {
+            __m256i q = _mm256_add_epi32(_mm256_mullo_epi32(acc[v], vMul), vRound);
+            q = _mm256_min_epu32(_mm256_srli_epi32(q, 16), vMax);
+            q = _mm256_shuffle_epi8(q, vPick);
+
+            const uint64_t bytes = (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(q))
+                | ((uint64_t)(uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(q, 1)) << 32);
+            std::memcpy(out + v * 8, &bytes, sizeof(bytes));
+
+            acc[v] = _mm256_sub_epi32(_mm256_add_epi32(acc[v], LoadLanes8(add + v * 8)), LoadLanes8(sub + v * 8));
+        }
+    }
+}
+
+#endif
+
+
+void GaussianBlur::GetBoxSizes(const float& sigma, uint32_t sizes[3])
+{
+    // Box widths whose cascade has the requested variance (Kovesi, "Fast almost-Gaussian filtering").
+    constexpr int Passes = 3;
+    const double s2 = (double)sigma * sigma;
+
+    int lower = (int)std::floor(std::sqrt(12.0 * s2 / Passes + 1.0));
+    if (lower % 2 == 0)
+        --lower;
+    lower = std::max(lower, 1);
+    const int upper = lower + 2;
+
+    const int m = (int)std::lround((12.0 * s2 - Passes * lower * lower - 4.0 * Passes * lower - 3.0 * Passes)
+        / (-4.0 * lower - 4.0));
+
+    for (int i = 0; i < Passes; ++i)
+        sizes[i] = (uint32_t)(i < m ? lower : upper);
+}
+
+void GaussianBlur::BlurColumns(const uint32_t* src, uint32_t* dst, const uint32_t& width, const uint32_t& height,
+    const uint32_t& size)
+{
+    static const SimdLevel level = DetectSimdLevel();
+
+    const uint32_t r = size / 2;
+    const uint32_t mul = (65536u + size / 2) / size;
+    const size_t pitch = (size_t)width * sizeof(uint32_t);
+    const uint32_t strips = (width + StripPixels - 1) / StripPixels;
+
+    ThreadPool::Get().ParallelFor(strips, [&](uint32_t strip)
+    {
+        const uint32_t x0 = strip * StripPixels;
+        const uint32_t pixels = std::min(x0 + StripPixels, width) - x0;
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(src + x0);
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst + x0);
+
+#if VR_SIMD_X86
+        if (level == SimdLevel::AVX2 && pixels == StripPixels)
+        {
+            BoxStripAVX2(in, out, pitch, height, r, mul);
+            return;
+        }
+#endif
+        BoxStripScalar(in, out, pitch, height, pixels * 4, r, mul);
+    });
+}
+
+void GaussianBlur::Transpose(const uint32_t* src, uint32_t* dst, const uint32_t& width, const uint32_t& height)
+{
+    const uint32_t tilesX = (width + TileSize - 1) / TileSize;
+    const uint32_t tilesY = (height + TileSize - 1) / TileSize;
+
+    ThreadPool::Get().ParallelFor(tilesX * tilesY, [&](uint32_t tile)
+    {
+        const uint32_t x0 = (tile % tilesX) * TileSize;
+        const uint32_t y0 = (tile / tilesX) * TileSize;
+        const uint32_t x1 = std::min(x0 + TileSize, width);
+        const uint32_t y1 = std::min(y0 + TileSize, height);
+
+        for (uint32_t x = x0; x < x1; ++x)
+            for (uint32_t y = y0; y < y1; ++y)
+                dst[(size_t)x * height + y] = src[(size_t)y * width + x];
+    });
+}
+
+void GaussianBlur::Dim(uint32_t* pixels, const size_t& count, const float& amount)
+{
+    uint8_t lut[256];
+    for (uint32_t i = 0; i < 256; ++i)
+        lut[i] = (uint8_t)std::lround(i * (1.0f - amount) + DimTone * amount);
+
+    constexpr uint32_t Chunk = 1u << 16;
+    const uint32_t chunks = (uint32_t)((count + Chunk - 1) / Chunk);
+
+    ThreadPool::Get().ParallelFor(chunks, [&](uint32_t chunk)
+    {
+        const size_t i0 = (size_t)chunk * Chunk;
+        const size_t i1 = std::min(i0 + Chunk, count);
+
+        for (size_t i = i0; i < i1; ++i)
+        {
+            const uint32_t p = pixels[i];
+            pixels[i] = lut[p & 0xFF] | ((uint32_t)lut[(p >> 8) & 0xFF] << 8) | ((uint32_t)lut[(p >> 16) & 0xFF] << 16)
+                | (p & 0xFF000000u);
+        }
+    });
+}
+
+
+bool GaussianBlur::Apply(const CpuImage& source, const BlurSettings& settings, CpuImage& result)
+{
+    if (!source.IsValid())
+    {
+        std::cerr << "GaussianBlur: invalid source image\n";
+        return false;
+    }
+
+    const float radius = settings.radius;
+    if (radius <= 0.5f && settings.dim <= 0.0f)
+    {
+        result = source;
+        return true;
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+    auto t0 = clock::now();
+
+    uint32_t sizes[3] = { 1, 1, 1 };
+    if (radius > 0.5f)
+        GetBoxSizes(radius, sizes);
+
+    const size_t count = (size_t)source.width * source.height;
+    std::shared_ptr<uint32_t[]> a(new uint32_t[count]);
+    std::shared_ptr<uint32_t[]> b(new uint32_t[count]);
+
+    const uint32_t w = source.width;
+    const uint32_t h = source.height;
+
+    BlurColumns(source.pixels.get(), a.get(), w, h, sizes[0]);
+    BlurColumns(a.get(), b.get(), w, h, sizes[1]);
+    BlurColumns(b.get(), a.get(), w, h, sizes[2]);
+
+    Transpose(a.get(), b.get(), w, h);
+    BlurColumns(b.get(), a.get(), h, w, sizes[0]);
+    BlurColumns(a.get(), b.get(), h, w, sizes[1]);
+    BlurColumns(b.get(), a.get(), h, w, sizes[2]);
+    Transpose(a.get(), b.get(), h, w);
+
+    if (settings.dim > 0.0f)
+        Dim(b.get(), count, std::min(settings.dim, 1.0f));
+
+    result.width = source.width;
+    result.height = source.height;
+    result.pixels = std::move(b);
+
+    auto t1 = clock::now();
+    std::cout << "Blurred " << source.width << 'x' << source.height << " background (radius " << radius << ", dim " << settings.dim << ", boxes "
+        << sizes[0] << '/' << sizes[1] << '/' << sizes[2] << ") in "
+        << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms\n";
+    return true;
+}
+
+bool GaussianBlur::ApplyCached(const CpuImage& source, const BlurSettings& settings, CpuImage& result)
+{
+    using Key = std::tuple<uint64_t, float, float>;
+
+    static std::mutex mutex;
+    static std::map<Key, CpuImage> cache;
+
+    const Key key { HashImage(source), settings.radius, settings.dim };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(key);
+        if (it != cache.end())
+        {
+            result = it->second;
+            return true;
+        }
+    }
+
+    if (!Apply(source, settings, result))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.emplace(key, result);
+    return true;
+}
+
+uint64_t GaussianBlur::HashImage(const CpuImage& image)
+{
+    if (!image.IsValid())
+        return 0;
+
+    const uint64_t dims = ((uint64_t)image.width << 32) | image.height;
+    return HashBytes(image.pixels.get(), (size_t)image.width * image.height * sizeof(uint32_t), dims);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuFrame.h"
+
+
+// Defaults reproduce the hand-made bgN_blurred.png assets: a ~100 px Gaussian, then 75% of the way
+// towards a dark gray.
+struct BlurSettings
+{
+    float radius = 100.0f;
+    float dim = 0.75f;
+
+    bool operator==(const BlurSettings&) const = default;
+};
+
+
+class GaussianBlur
+{
+    public:
+        static constexpr uint8_t DimTone = 22;
+        static constexpr uint32_t Version = 1;     // bump when the output changes, invalidates AssetCache entries
+
+        // Approximates a Gaussian with standard deviation `settings.radius` pixels by three box passes
+        // per axis. Only a vertical kernel exists: it runs over 16-pixel column strips with the sums
+        // held across a whole row segment, and the horizontal passes reuse it on a transposed copy.
+        static bool Apply(const CpuImage& source, const BlurSettings& settings, CpuImage& result);
+
+        // Apply() memoized on (pixel hash, settings), so every slide sharing a background reuses one
+        // result for the life of the process.
+        static bool ApplyCached(const CpuImage& source, const BlurSettings& settings, CpuImage& result);
+
+        static uint64_t HashImage(const CpuImage& image);
+
+
+    private:
+        static void GetBoxSizes(const float& sigma, uint32_t sizes[3]);
+        static void BlurColumns(const uint32_t* src, uint32_t* dst, const uint32_t& width, const uint32_t& height,
+            const uint32_t& size);
+        static void Transpose(const uint32_t* src, uint32_t* dst, const uint32_t& width, const uint32_t& height);
+        static void Dim(uint32_t* pixels, const size_t& count, const float& amount);
+};
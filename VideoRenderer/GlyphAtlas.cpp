@@ -0,0 +1,246 @@
+#include "GlyphAtlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+// Glyphs are keyed at 1/64 px sizes; a shelf takes glyphs up to this much shorter than itself.
+static constexpr float SizeSteps = 64.0f;
+static constexpr uint32_t ShelfSlack = 4;
+static constexpr uint32_t GlyphPadding = 1;
+
+
+// floor(x / 255) for x up to 65535, the same in every blend kernel.
+static inline uint32_t DivideBy255(const uint32_t& x)
+{
+    return (x * 0x8081u) >> 23;
+}
+
+static inline uint64_t MakeKey(const uint32_t& font, const uint16_t& glyph, const uint16_t& size, const uint8_t& subpixel)
+{
+    return ((uint64_t)(font & 0xFFFFu) << 48) | ((uint64_t)glyph << 32) | ((uint64_t)size << 16) | subpixel;
+}
+
+
+// Source-over of a solid premultiplied color scaled by coverage onto premultiplied BGRA8.
+static void BlendRowScalar(const uint8_t* coverage, uint8_t* dst, const uint32_t& count, const uint32_t& alpha,
+    const uint8_t color[3])
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (coverage[i] == 0)
+            continue;
+
+        const uint32_t a = DivideBy255(coverage[i] * alpha + 128);
+        const uint32_t inv = 255 - a;
+        uint8_t* p = dst + (size_t)i * 4;
+
+        p[0] = (uint8_t)DivideBy255(color[0] * a + p[0] * inv + 128);
+        p[1] = (uint8_t)DivideBy255(color[1] * a + p[1] * inv + 128);
+        p[2] = (uint8_t)DivideBy255(color[2] * a + p[2] * inv + 128);
+        p[3] = (uint8_t)DivideBy255(255 * a + p[3] * inv + 128);
+    }
+}
+
+
+#if VR_SIMD_X86
+
+VR_TARGET_SSE41 static void BlendRowSSE41(const uint8_t* coverage, uint8_t* dst, const uint32_t& count,
+    const uint32_t& alpha, const uint8_t color[3])
+{
+    const __m128i zero      = _mm_setzero_si128();
+    const __m128i k255      = _mm_set1_epi16(255);
+    const __m128i k128_16   = _mm_set1_epi16(128);
+    const __m128i k128_32   = _mm_set1_epi32(128);
+    const __m128i kDiv      = _mm_set1_epi16((short)0x8081);
+    const __m128i kDiv32    = _mm_set1_epi32(0x8081);
+    const __m128i alpha32   = _mm_set1_epi32((int)alpha);
+    const __m128i src       = _mm_setr_epi16(color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+
+    // Spread the low byte of pixel 0/1 (or 2/3) across the four 16-bit channels of each pixel.
+    const __m128i spreadLo  = _mm_setr_epi8(0, -1, 0, -1, 0, -1, 0, -1, 4, -1, 4, -1, 4, -1, 4, -1);
+    const __m128i spreadHi  = _mm_setr_epi8(8, -1, 8, -1, 8, -1, 8, -1, 12, -1, 12, -1, 12, -1, 12, -1);
+
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        int32_t cov4;
+        std::memcpy(&cov4, coverage + i, sizeof(cov4));
+        if (cov4 == 0)
+            continue;
+
+        __m128i a = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(cov4));
+        a = _mm_srli_epi32(_mm_mullo_epi32(_mm_add_epi32(_mm_mullo_epi32(a, alpha32), k128_32), kDiv32), 23);
+
+        const __m128i aLo = _mm_shuffle_epi8(a, spreadLo);
+        const __m128i aHi = _mm_shuffle_epi8(a, spreadHi);
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + (size_t)i * 4));
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+
+        lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(src, aLo), _mm_mullo_epi16(lo, _mm_sub_epi16(k255, aLo))), k128_16);
+        hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(src, aHi), _mm_mullo_epi16(hi, _mm_sub_epi16(k255, aHi))), k128_16);
+        lo = _mm_srli_epi16(_mm_mulhi_epu16(lo, kDiv), 7);
+        hi = _mm_srli_epi16(_mm_mulhi_epu16(hi, kDiv), 7);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (size_t)i * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    BlendRowScalar(coverage + i, dst + (size_t)i * 4, count - i, alpha, color);
+}
+
+#endif
+
+
+GlyphAtlas::GlyphAtlas(GlyphRasterizer& rasterizer, const uint32_t& size)
+    : m_Rasterizer(rasterizer)
+    , m_Size(std::min(size, 65535u))
+    , m_SimdLevel(DetectSimdLevel())
+{
+    m_Pixels.assign((size_t)m_Size * m_Size, 0);
+    m_Stats.capacity = (uint64_t)m_Size * m_Size;
+}
+
+
+void GlyphAtlas::Clear()
+{
+    m_Entries.clear();
+    m_Shelves.clear();
+    m_NextShelfY = 0;
+    m_Stats.glyphs = 0;
+    m_Stats.usedPixels = 0;
+}
+
+bool GlyphAtlas::Allocate(const uint32_t& width, const uint32_t& height, uint32_t& x, uint32_t& y)
+{
+    const uint32_t w = width + GlyphPadding;
+    const uint32_t h = height + GlyphPadding;
+    if (w > m_Size || h > m_Size)
+        return false;
+
+    for (Shelf& shelf : m_Shelves)
+    {
+        if (h <= shelf.height && h + ShelfSlack >= shelf.height && shelf.x + w <= m_Size)
+        {
+            x = shelf.x;
+            y = shelf.y;
+            shelf.x += w;
+            m_Stats.usedPixels += (uint64_t)w * shelf.height;
+            return true;
+        }
+    }
+
+    if (m_NextShelfY + h > m_Size)
+        return false;
+
+    m_Shelves.push_back(Shelf { m_NextShelfY, h, w });
+    x = 0;
+    y = m_NextShelfY;
+    m_NextShelfY += h;
+    m_Stats.usedPixels += (uint64_t)w * h;
+    return true;
+}
+
+const GlyphAtlas::Entry* GlyphAtlas::Find(const uint32_t& font, const uint16_t& glyph, const float& emSize,
+    const uint8_t& subpixel)
+{
+    const uint16_t size = (uint16_t)std::clamp(std::lround(emSize * SizeSteps), 1l, 65535l);
+    const uint64_t key = MakeKey(font, glyph, size, subpixel);
+
+    auto it = m_Entries.find(key);
+    if (it != m_Entries.end())
+    {
+        ++m_Stats.hits;
+        return &it->second;
+    }
+
+    ++m_Stats.misses;
+    if (!m_Rasterizer.Rasterize(font, glyph, size / SizeSteps, subpixel, m_Scratch))
+        return nullptr;
+
+    Entry entry {};
+    entry.width = (uint16_t)m_Scratch.width;
+    entry.height = (uint16_t)m_Scratch.height;
+    entry.left = (int16_t)m_Scratch.left;
+    entry.top = (int16_t)m_Scratch.top;
+
+    // Blank glyphs such as spaces are cached too, so they stop counting as misses.
+    if (entry.width > 0 && entry.height > 0)
+    {
+        uint32_t x = 0, y = 0;
+        if (!Allocate(entry.width, entry.height, x, y))
+        {
+            Clear();
+            ++m_Stats.resets;
+            if (!Allocate(entry.width, entry.height, x, y))
+                return nullptr;
+        }
+
+        entry.x = (uint16_t)x;
+        entry.y = (uint16_t)y;
+        for (uint32_t row = 0; row < entry.height; ++row)
+        {
+            std::memcpy(m_Pixels.data() + (size_t)(y + row) * m_Size + x,
+                m_Scratch.coverage.data() + (size_t)row * m_Scratch.width, entry.width);
+        }
+    }
+
+    ++m_Stats.glyphs;
+    return &m_Entries.emplace(key, entry).first->second;
+}
+
+
+void GlyphAtlas::DrawGlyph(const GlyphTarget& target, const uint32_t& font, const uint16_t& glyph, const float& emSize,
+    const float& x, const float& y, const GlyphColor& color)
+{
+    if (!target.pixels || target.rect.IsEmpty() || color.a <= 0.0f)
+        return;
+
+    const long quarters = std::lround(std::floor(x * 4.0f));
+    const long penX = quarters >> 2;
+    const long penY = std::lround(y);
+
+    const Entry* pEntry = Find(font, glyph, emSize, (uint8_t)(quarters & 3));
+    if (!pEntry || pEntry->width == 0 || pEntry->height == 0)
+        return;
+
+    const long gx0 = penX + pEntry->left;
+    const long gy0 = penY + pEntry->top;
+    const long x0 = std::max<long>(gx0, target.rect.x0);
+    const long y0 = std::max<long>(gy0, target.rect.y0);
+    const long x1 = std::min<long>(gx0 + pEntry->width, target.rect.x1);
+    const long y1 = std::min<long>(gy0 + pEntry->height, target.rect.y1);
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    const uint32_t alpha = (uint32_t)std::lround(std::clamp(color.a, 0.0f, 1.0f) * 255.0f);
+    const uint8_t bgr[3] =
+    {
+        (uint8_t)std::lround(std::clamp(color.b, 0.0f, 1.0f) * 255.0f),
+        (uint8_t)std::lround(std::clamp(color.g, 0.0f, 1.0f) * 255.0f),
+        (uint8_t)std::lround(std::clamp(color.r, 0.0f, 1.0f) * 255.0f)
+    };
+
+    for (long row = y0; row < y1; ++row)
+    {
+        const uint8_t* coverage = m_Pixels.data() + (size_t)(pEntry->y + row - gy0) * m_Size + pEntry->x + (x0 - gx0);
+        uint8_t* dst = target.pixels + (size_t)(row - target.rect.y0) * target.pitch + (size_t)(x0 - target.rect.x0) * 4;
+        BlendRow(coverage, dst, (uint32_t)(x1 - x0), alpha, bgr);
+    }
+}
+
+void GlyphAtlas::BlendRow(const uint8_t* coverage, uint8_t* dst, const uint32_t& count, const uint32_t& alpha,
+    const uint8_t color[3]) const
+{
+#if VR_SIMD_X86
+    if (m_SimdLevel != SimdLevel::Scalar)
+    {
+        BlendRowSSE41(coverage, dst, count, alpha, color);
+        return;
+    }
+#endif
+
+    BlendRowScalar(coverage, dst, count, alpha, color);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "CpuCompositor.h"
+#include "Simd.h"
+
+
+// 8-bit coverage of one glyph, with its top-left corner relative to the pen position.
+struct GlyphBitmap
+{
+    int32_t left = 0;
+    int32_t top = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> coverage;
+};
+
+// Turns (font, glyph, size, subpixel offset) into coverage. Fonts are whatever ids the
+// implementation hands out; the atlas only uses them as part of the key.
+class GlyphRasterizer
+{
+    public:
+        virtual ~GlyphRasterizer() = default;
+
+        // `subpixel` is the pen's horizontal offset in quarter pixels, 0 to 3.
+        virtual bool Rasterize(const uint32_t& font, const uint16_t& glyph, const float& emSize, const uint8_t& subpixel,
+            GlyphBitmap& bitmap) = 0;
+};
+
+// Premultiplied B8G8R8A8 pixels covering `rect`; `pixels` points at the pixel (rect.x0, rect.y0).
+struct GlyphTarget
+{
+    DirtyRect rect;
+    uint8_t* pixels = nullptr;
+    size_t pitch = 0;
+};
+
+struct GlyphColor
+{
+    float r = 0.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+    float a = 1.0f;
+};
+
+struct AtlasStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint32_t resets = 0;        // times the atlas filled up and started over
+    uint32_t glyphs = 0;        // cached right now
+    uint64_t usedPixels = 0;    // shelf area handed out, including the padding on each shelf
+    uint64_t capacity = 0;
+
+    double GetHitRate() const   { return hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0; }
+    double GetOccupancy() const { return capacity > 0 ? (double)usedPixels / (double)capacity : 0.0; }
+};
+
+
+// Caches rasterized glyphs in one square coverage texture, packed into shelves, and blends them
+// onto a GlyphTarget. Each (font, glyph, size, quarter-pixel offset) is rasterized once until the
+// atlas fills up, at which point it is cleared and refilled. Not thread-safe.
+class GlyphAtlas
+{
+    private:
+        struct Entry
+        {
+            uint16_t x = 0;
+            uint16_t y = 0;
+            uint16_t width = 0;
+            uint16_t height = 0;
+            int16_t left = 0;
+            int16_t top = 0;
+        };
+
+        struct Shelf
+        {
+            uint32_t y = 0;
+            uint32_t height = 0;
+            uint32_t x = 0;
+        };
+
+        GlyphRasterizer& m_Rasterizer;
+        uint32_t m_Size;
+        std::vector<uint8_t> m_Pixels;
+        std::vector<Shelf> m_Shelves;
+        uint32_t m_NextShelfY = 0;
+        std::unordered_map<uint64_t, Entry> m_Entries;
+        GlyphBitmap m_Scratch;
+
+        AtlasStats m_Stats;
+        SimdLevel m_SimdLevel;
+
+
+    public:
+        explicit GlyphAtlas(GlyphRasterizer& rasterizer, const uint32_t& size = 2048);
+
+        // Blends `glyph` in `color` (straight alpha) with the pen at (x, y) in target pixels.
+        void DrawGlyph(const GlyphTarget& target, const uint32_t& font, const uint16_t& glyph, const float& emSize,
+            const float& x, const float& y, const GlyphColor& color);
+
+        void Clear();
+        const AtlasStats& GetStats() const { return m_Stats; }
+        SimdLevel GetSimdLevel() const { return m_SimdLevel; }
+
+
+    private:
+        const Entry* Find(const uint32_t& font, const uint16_t& glyph, const float& emSize, const uint8_t& subpixel);
+        bool Allocate(const uint32_t& width, const uint32_t& height, uint32_t& x, uint32_t& y);
+
+        void BlendRow(const uint8_t* coverage, uint8_t* dst, const uint32_t& count, const uint32_t& alpha,
+            const uint8_t color[3]) const;
+};
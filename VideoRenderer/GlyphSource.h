@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CodeGlyphs.h"
+
+
+// Lays the code out into glyph runs: picks the font, shapes the text and positions the glyphs.
+// Font ids must be those of the GlyphRasterizer the atlas is built over, so the two come in pairs.
+// DWriteGlyphSource and DWriteRasterizer are the DirectWrite pair; a FreeType and HarfBuzz pair can
+// implement both interfaces without touching CodeGlyphs or GlyphAtlas.
+class GlyphSource
+{
+    public:
+        virtual ~GlyphSource() = default;
+
+        // Replaces `glyphs` with `text` in `family` at `emSize` pixels, code unit i in colors[i], within
+        // a box of maxWidth by maxHeight. `bounds` gets the extent of the text, from the top-left of the box.
+        virtual bool Shape(const std::wstring& text, const std::vector<GlyphColor>& colors, const std::wstring& family,
+            const float& emSize, const float& maxWidth, const float& maxHeight, CodeGlyphs& glyphs, GlyphRect& bounds) = 0;
+};
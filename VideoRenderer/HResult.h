@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef NOMINMAX
+    #define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <iostream>
+
+
+// Reports a failed Windows call as "<what> failed: 0x<hr>".
+inline void PrintHR(const char* what, HRESULT hr)
+{
+    std::cerr << what << " failed: 0x" << std::hex << hr << std::dec << "\n";
+}
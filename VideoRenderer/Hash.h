@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// Fast non-cryptographic 64-bit hash for cache keys: 8 bytes per step, multiply-xorshift mixing.
+inline uint64_t HashBytes(const void* data, const size_t& size, uint64_t seed = 0x9E3779B97F4A7C15ull)
+{
+    constexpr uint64_t Mul = 0xFF51AFD7ED558CCDull;
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed ^ (size * Mul);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t v;
+        std::memcpy(&v, p + i, sizeof(v));
+        h = (h ^ (v * Mul)) * 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 29;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p + i, size - i);
+    h = (h ^ (tail * Mul)) * 0xC4CEB9FE1A85EC53ull;
+
+    h ^= h >> 33;
+    h *= Mul;
+    h ^= h >> 33;
+    return h;
+}
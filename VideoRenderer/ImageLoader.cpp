@@ -0,0 +1,81 @@
+#include "ImageLoader.h"
+
+#include <iostream>
+
+#if defined(_WIN32)
+    #include <wincodec.h>
+    #include <wrl/client.h>
+
+    #include "HResult.h"
+
+    #pragma comment(lib, "windowscodecs.lib")
+#endif
+
+
+bool ImageLoader::LoadRGBA8(const std::wstring& path, CpuImage& image)
+{
+#if defined(_WIN32)
+    Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+    HRESULT hr = CoCreateInstance
+    (
+        CLSID_WICImagingFactory,
+        nullptr,
+        CLSCTX_INPROC_SERVER,
+        IID_PPV_ARGS(&factory)
+    );
+    if (FAILED(hr))
+    {
+        PrintHR("CoCreateInstance(WICImagingFactory)", hr);
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+    hr = factory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ,
+        WICDecodeMetadataCacheOnDemand, &decoder);
+    if (FAILED(hr))
+    {
+        std::wcerr << L"Failed to open image " << path << L"\n";
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+    hr = decoder->GetFrame(0, &frame);
+    if (FAILED(hr))
+    {
+        PrintHR("IWICBitmapDecoder::GetFrame", hr);
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+    hr = factory->CreateFormatConverter(&converter);
+    if (SUCCEEDED(hr))
+    {
+        hr = converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA,
+            WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+    }
+    if (FAILED(hr))
+    {
+        PrintHR("WIC format conversion to RGBA8", hr);
+        return false;
+    }
+
+    UINT width = 0, height = 0;
+    converter->GetSize(&width, &height);
+
+    std::shared_ptr<uint32_t[]> pixels(new uint32_t[(size_t)width * height]);
+    hr = converter->CopyPixels(nullptr, width * 4, width * height * 4, reinterpret_cast<BYTE*>(pixels.get()));
+    if (FAILED(hr))
+    {
+        PrintHR("IWICBitmapSource::CopyPixels", hr);
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels = std::move(pixels);
+    return true;
+#else
+    std::cerr << "PNG decoding needs WIC and is only available on Windows\n";
+    return false;
+#endif
+}
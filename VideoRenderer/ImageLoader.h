@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+#include "CpuFrame.h"
+
+
+class ImageLoader
+{
+    public:
+        // Decodes to RGBA8, matching what DirectX::CreateWICTextureFromFile uploads for 8-bit PNGs.
+        static bool LoadRGBA8(const std::wstring& path, CpuImage& image);
+};
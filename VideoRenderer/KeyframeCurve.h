@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <type_traits>
+
+
+// constexpr easing shapes for KeyframeCurve segments. std::cos is not constexpr, so at compile time
+// Cos falls back to a reduced Taylor series that agrees with it to double precision.
+namespace CurveEase
+{
+    constexpr double Cos(double x)
+    {
+        if (!std::is_constant_evaluated())
+            return std::cos(x);
+
+        // Reduce to [0, pi/2] by evenness, period and cos(pi - y) = -cos(y)
+        constexpr double Pi = std::numbers::pi;
+        x = x < 0 ? -x : x;
+        x -= 2 * Pi * (double)(long long)(x / (2 * Pi));
+        if (x > Pi)
+            x = 2 * Pi - x;
+
+        double sign = 1.0;
+        if (x > Pi / 2)
+        {
+            x = Pi - x;
+            sign = -1.0;
+        }
+
+        const double x2 = x * x;
+        double term = 1.0;
+        double sum = 1.0;
+        for (int k = 1; k <= 12; ++k)
+        {
+            term *= -x2 / ((2 * k - 1) * (2 * k));
+            sum += term;
+        }
+        return sign * sum;
+    }
+
+    // Same as EaseInOutSine, including its 3.1415927 for pi.
+    struct InOutSine
+    {
+        constexpr float operator()(const float& x) const { return (float)(-(Cos(3.1415927 * x) - 1) / 2); }
+    };
+}
+
+
+struct Keyframe
+{
+    float t;
+    float v;
+};
+
+template <size_t Size>
+class CurveTable;
+
+
+// Piecewise curve through N keyframes, each segment eased by `Ease` from one value to the next and
+// clamped to the first and last value outside them. Everything is constexpr, so curves are defined
+// as constants, their keys can feed the batched AVX2 evaluation in EasingBatch.cpp, and they can be
+// baked into a CurveTable at compile time.
+template <typename Ease, size_t N>
+class KeyframeCurve
+{
+    static_assert(N >= 2, "A curve needs at least two keyframes");
+
+    private:
+        std::array<Keyframe, N> m_Keys;
+
+
+    public:
+        constexpr explicit KeyframeCurve(const std::array<Keyframe, N>& keys)
+            : m_Keys(keys)
+        {}
+
+        constexpr const std::array<Keyframe, N>& GetKeys() const { return m_Keys; }
+
+        constexpr float operator()(const float& x) const
+        {
+            if (x <= m_Keys[0].t)
+                return m_Keys[0].v;
+            if (x >= m_Keys[N - 1].t)
+                return m_Keys[N - 1].v;
+
+            size_t i = 1;
+            while (i < N - 1 && x >= m_Keys[i].t)
+                ++i;
+
+            const Keyframe& k0 = m_Keys[i - 1];
+            const Keyframe& k1 = m_Keys[i];
+            const float s = (x - k0.t) / (k1.t - k0.t);
+            return std::lerp(k0.v, k1.v, Ease {}(s));
+        }
+
+        template <size_t Size>
+        constexpr CurveTable<Size> Bake() const
+        {
+            return CurveTable<Size>(*this, m_Keys[0].t, m_Keys[N - 1].t);
+        }
+};
+
+
+// `Size` evenly spaced samples of a curve between two times, linearly interpolated. Each lookup
+// is one fetch pair and a lerp; the error against the curve is at most h^2 / 8 * max|f''| with
+// h the sample spacing, and MaxError measures it.
+template <size_t Size>
+class CurveTable
+{
+    static_assert(Size >= 2, "A table needs at least two samples");
+
+    private:
+        float m_T0 = 0.0f;
+        float m_T1 = 1.0f;
+        float m_Scale = 0.0f;
+        std::array<float, Size> m_Values {};
+
+
+    public:
+        template <typename Curve>
+        constexpr CurveTable(const Curve& curve, const float& t0, const float& t1)
+            : m_T0(t0)
+            , m_T1(t1)
+            , m_Scale((float)(Size - 1) / (t1 - t0))
+        {
+            for (size_t i = 0; i < Size; ++i)
+                m_Values[i] = curve(t0 + (t1 - t0) * (float)i / (float)(Size - 1));
+        }
+
+        constexpr float operator()(const float& x) const
+        {
+            if (!(x > m_T0))
+                return m_Values[0];
+            if (x >= m_T1)
+                return m_Values[Size - 1];
+
+            const float pos = (x - m_T0) * m_Scale;
+            const size_t i = std::min((size_t)pos, Size - 2);
+            const float frac = pos - (float)i;
+            return m_Values[i] + (m_Values[i + 1] - m_Values[i]) * frac;
+        }
+
+        // Largest absolute difference from `curve` over `samples` evenly spaced points.
+        template <typename Curve>
+        constexpr float MaxError(const Curve& curve, const size_t& samples) const
+        {
+            float maxError = 0.0f;
+            for (size_t i = 0; i < samples; ++i)
+            {
+                const float x = m_T0 + (m_T1 - m_T0) * (float)i / (float)(samples - 1);
+                const float e = curve(x) - (*this)(x);
+                maxError = std::max(maxError, e < 0 ? -e : e);
+            }
+            return maxError;
+        }
+};
+
+
+// The After Effects "double back" curves: a small overshoot before settling at 1.
+inline constexpr KeyframeCurve<CurveEase::InOutSine, 4> InAEDoubleBackCurve
+({{
+    { 0.0f,     0.0f },
+    { 0.1667f,  0.01f },
+    { 0.3333f,  -0.02f },
+    { 1.0f,     1.0f }
+}});
+
+inline constexpr KeyframeCurve<CurveEase::InOutSine, 4> OutAEDoubleBackCurve
+({{
+    { 0.0f,     0.0f },
+    { 0.6667f,  1.02f },
+    { 0.8333f,  0.99f },
+    { 1.0f,     1.0f }
+}});
+
+// Baked at compile time. Largest absolute error against the curves over [0, 1], as measured by
+// MaxError and checked by VideoRenderer --test: 2.2e-5 for both, against 1.8e-7 for the batched
+// AVX2 curves.
+inline constexpr float CurveTableMaxError = 2.2e-5f;
+inline constexpr CurveTable<256> InAEDoubleBackTable = InAEDoubleBackCurve.Bake<256>();
+inline constexpr CurveTable<256> OutAEDoubleBackTable = OutAEDoubleBackCurve.Bake<256>();
@@ -0,0 +1,258 @@
+#include "MonoGrid.h"
+#include "HResult.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+// Hands one line of the code to the text analyzer, left to right in the format's locale.
+class LineAnalysisSource : public IDWriteTextAnalysisSource
+{
+    private:
+        const WCHAR* m_pText;
+        UINT32 m_Length;
+        const WCHAR* m_pLocale;
+        ULONG m_RefCount = 1;
+
+
+    public:
+        LineAnalysisSource(const WCHAR* pText, const UINT32& length, const WCHAR* pLocale)
+            : m_pText(pText)
+            , m_Length(length)
+            , m_pLocale(pLocale)
+        {}
+
+        IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv) override
+        {
+            if (riid == __uuidof(IUnknown) || riid == __uuidof(IDWriteTextAnalysisSource))
+            {
+                *ppv = static_cast<IDWriteTextAnalysisSource*>(this);
+                AddRef();
+                return S_OK;
+            }
+
+            *ppv = nullptr;
+            return E_NOINTERFACE;
+        }
+        IFACEMETHODIMP_(ULONG) AddRef() override { return ++m_RefCount; }
+        IFACEMETHODIMP_(ULONG) Release() override { return --m_RefCount; }
+
+        IFACEMETHODIMP GetTextAtPosition(UINT32 position, const WCHAR** text, UINT32* length) override
+        {
+            *text = position < m_Length ? m_pText + position : nullptr;
+            *length = position < m_Length ? m_Length - position : 0;
+            return S_OK;
+        }
+        IFACEMETHODIMP GetTextBeforePosition(UINT32 position, const WCHAR** text, UINT32* length) override
+        {
+            *text = position > 0 && position <= m_Length ? m_pText : nullptr;
+            *length = position > 0 && position <= m_Length ? position : 0;
+            return S_OK;
+        }
+        IFACEMETHODIMP_(DWRITE_READING_DIRECTION) GetParagraphReadingDirection() override
+        {
+            return DWRITE_READING_DIRECTION_LEFT_TO_RIGHT;
+        }
+        IFACEMETHODIMP GetLocaleName(UINT32 position, UINT32* length, const WCHAR** locale) override
+        {
+            *length = m_Length - std::min(position, m_Length);
+            *locale = m_pLocale;
+            return S_OK;
+        }
+        IFACEMETHODIMP GetNumberSubstitution(UINT32 position, UINT32* length, IDWriteNumberSubstitution** substitution) override
+        {
+            *length = m_Length - std::min(position, m_Length);
+            *substitution = nullptr;
+            return S_OK;
+        }
+};
+
+// Keeps the script ranges of a line; the rest of the analysis is not asked for.
+class ScriptAnalysisSink : public IDWriteTextAnalysisSink
+{
+    private:
+        ULONG m_RefCount = 1;
+
+
+    public:
+        struct Range
+        {
+            UINT32 start;
+            UINT32 length;
+            DWRITE_SCRIPT_ANALYSIS analysis;
+        };
+        std::vector<Range> m_Ranges;
+
+        IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv) override
+        {
+            if (riid == __uuidof(IUnknown) || riid == __uuidof(IDWriteTextAnalysisSink))
+            {
+                *ppv = static_cast<IDWriteTextAnalysisSink*>(this);
+                AddRef();
+                return S_OK;
+            }
+
+            *ppv = nullptr;
+            return E_NOINTERFACE;
+        }
+        IFACEMETHODIMP_(ULONG) AddRef() override { return ++m_RefCount; }
+        IFACEMETHODIMP_(ULONG) Release() override { return --m_RefCount; }
+
+        IFACEMETHODIMP SetScriptAnalysis(UINT32 position, UINT32 length, const DWRITE_SCRIPT_ANALYSIS* analysis) override
+        {
+            m_Ranges.push_back(Range { position, length, *analysis });
+            return S_OK;
+        }
+        IFACEMETHODIMP SetLineBreakpoints(UINT32, UINT32, const DWRITE_LINE_BREAKPOINT*) override { return S_OK; }
+        IFACEMETHODIMP SetBidiLevel(UINT32, UINT32, UINT8, UINT8) override { return S_OK; }
+        IFACEMETHODIMP SetNumberSubstitution(UINT32, UINT32, IDWriteNumberSubstitution*) override { return S_OK; }
+};
+
+
+bool MonoGrid::Build(IDWriteFactory* pFactory, IDWriteTextFormat* pFormat, const std::wstring& code)
+{
+    m_pFontFace.Reset();
+    m_LineStarts.clear();
+    m_LineEnds.clear();
+    m_Lines.clear();
+    m_Glyphs.clear();
+    m_Shaped.clear();
+    m_ShapedCount = 0;
+    m_Width = 0.0f;
+
+    Microsoft::WRL::ComPtr<IDWriteFontCollection> pCollection;
+    pFormat->GetFontCollection(&pCollection);
+    if (!pCollection)
+        return false;
+
+    WCHAR family[256] {};
+    if (FAILED(pFormat->GetFontFamilyName(family, 256)))
+        return false;
+
+    UINT32 index = 0;
+    BOOL bExists = FALSE;
+    if (FAILED(pCollection->FindFamilyName(family, &index, &bExists)) || !bExists)
+        return false;
+
+    Microsoft::WRL::ComPtr<IDWriteFontFamily> pFamily;
+    Microsoft::WRL::ComPtr<IDWriteFont> pFont;
+    if (FAILED(pCollection->GetFontFamily(index, &pFamily))
+        || FAILED(pFamily->GetFirstMatchingFont(pFormat->GetFontWeight(), pFormat->GetFontStretch(), pFormat->GetFontStyle(), &pFont))
+        || FAILED(pFont->CreateFontFace(&m_pFontFace)))
+        return false;
+
+    DWRITE_FONT_METRICS metrics {};
+    m_pFontFace->GetMetrics(&metrics);
+    m_EmSize = pFormat->GetFontSize();
+    const float scale = m_EmSize / std::max<float>(metrics.designUnitsPerEm, 1.0f);
+    m_Ascent = metrics.ascent * scale;
+    m_LineHeight = (metrics.ascent + metrics.descent + metrics.lineGap) * scale;
+
+    // Narrow and wide glyphs must advance alike, or the grid does not hold.
+    const UINT32 probes[3] = { L' ', L'i', L'W' };
+    UINT16 probeGlyphs[3] {};
+    DWRITE_GLYPH_METRICS probeMetrics[3] {};
+    if (FAILED(m_pFontFace->GetGlyphIndices(probes, 3, probeGlyphs))
+        || FAILED(m_pFontFace->GetDesignGlyphMetrics(probeGlyphs, 3, probeMetrics, FALSE))
+        || probeMetrics[0].advanceWidth != probeMetrics[1].advanceWidth
+        || probeMetrics[0].advanceWidth != probeMetrics[2].advanceWidth)
+    {
+        std::cout << "Code font is not fixed-pitch, laying code out as a paragraph\n";
+        m_pFontFace.Reset();
+        return false;
+    }
+    m_Advance = probeMetrics[0].advanceWidth * scale;
+
+    const uint32_t n = (uint32_t)code.size();
+    std::vector<UINT32> codePoints(code.begin(), code.end());
+    m_Glyphs.resize(n);
+    if (n > 0 && FAILED(m_pFontFace->GetGlyphIndices(codePoints.data(), n, m_Glyphs.data())))
+    {
+        m_pFontFace.Reset();
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<IDWriteTextAnalyzer> pAnalyzer;
+    HRESULT hr = pFactory->CreateTextAnalyzer(&pAnalyzer);
+    if (FAILED(hr))
+    {
+        PrintHR("CreateTextAnalyzer", hr);
+        m_pFontFace.Reset();
+        return false;
+    }
+
+    WCHAR locale[LOCALE_NAME_MAX_LENGTH] {};
+    if (FAILED(pFormat->GetLocaleName(locale, LOCALE_NAME_MAX_LENGTH)))
+        locale[0] = L'\0';
+
+    m_Lines.resize(n);
+    uint32_t start = 0;
+    while (true)
+    {
+        const uint32_t line = (uint32_t)m_LineStarts.size();
+        const uint32_t end = std::min((uint32_t)code.find(L'\n', start), n);
+
+        bool bShaped = !ShapesNominally(pAnalyzer.Get(), code.c_str() + start, end - start, m_Glyphs.data() + start, locale);
+        uint32_t lastInk = start;
+        for (uint32_t i = start; i < end; ++i)
+        {
+            if (m_Glyphs[i] == 0)
+                bShaped = true;
+            if (code[i] != L' ')
+                lastInk = i + 1;
+            m_Lines[i] = line;
+        }
+        if (end < n)
+            m_Lines[end] = line;
+
+        m_LineStarts.push_back(start);
+        m_LineEnds.push_back(end);
+        m_Shaped.push_back(bShaped);
+        m_ShapedCount += bShaped ? 1 : 0;
+        m_Width = std::max(m_Width, (lastInk - start) * m_Advance);
+
+        if (end >= n)
+            break;
+        start = end + 1;
+    }
+
+    return true;
+}
+
+bool MonoGrid::ShapesNominally(IDWriteTextAnalyzer* pAnalyzer, const wchar_t* text, const uint32_t& length,
+    const UINT16* nominal, const wchar_t* locale) const
+{
+    if (length == 0)
+        return true;
+
+    LineAnalysisSource source(text, length, locale);
+    ScriptAnalysisSink sink;
+    if (FAILED(pAnalyzer->AnalyzeScript(&source, 0, length, &sink)))
+        return false;
+
+    // With no features given the shaper applies the font's defaults, ligatures and contextual
+    // alternates included. Anything but one unchanged glyph per code unit leaves the grid.
+    const UINT32 maxGlyphs = length * 3 / 2 + 16;
+    std::vector<UINT16> clusterMap(length);
+    std::vector<DWRITE_SHAPING_TEXT_PROPERTIES> textProps(length);
+    std::vector<UINT16> glyphs(maxGlyphs);
+    std::vector<DWRITE_SHAPING_GLYPH_PROPERTIES> glyphProps(maxGlyphs);
+
+    for (const ScriptAnalysisSink::Range& range : sink.m_Ranges)
+    {
+        UINT32 count = 0;
+        HRESULT hr = pAnalyzer->GetGlyphs(text + range.start, range.length, m_pFontFace.Get(), FALSE, FALSE, &range.analysis,
+            locale, nullptr, nullptr, nullptr, 0, maxGlyphs, clusterMap.data(), textProps.data(), glyphs.data(),
+            glyphProps.data(), &count);
+        if (FAILED(hr) || count != range.length)
+            return false;
+
+        for (UINT32 i = 0; i < range.length; ++i)
+        {
+            if (clusterMap[i] != i || glyphs[i] != nominal[range.start + i])
+                return false;
+        }
+    }
+
+    return true;
+}
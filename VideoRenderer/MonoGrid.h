@@ -0,0 +1,69 @@
+#pragma once
+
+#include <d2d1_1.h>
+#include <dwrite.h>
+#include <wrl/client.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Fixed-pitch layout of the code. Every code unit takes one column, so where anything goes follows
+// from its line and column alone. Each line is shaped once with the font's default features; lines
+// that do not come out as one nominal glyph per code unit (surrogate pairs, characters missing from
+// the font, ligatures or contextual alternates) are marked as shaped and left to the general text
+// layout, placed on the same grid.
+class MonoGrid
+{
+    private:
+        Microsoft::WRL::ComPtr<IDWriteFontFace> m_pFontFace;
+        float m_EmSize = 0.0f;
+        float m_Advance = 0.0f;
+        float m_LineHeight = 0.0f;
+        float m_Ascent = 0.0f;
+        float m_Width = 0.0f;
+
+        std::vector<uint32_t> m_LineStarts;     // first code unit of each line
+        std::vector<uint32_t> m_LineEnds;       // its '\n' or the end of the code
+        std::vector<uint32_t> m_Lines;          // line of each code unit
+        std::vector<UINT16> m_Glyphs;           // nominal glyph of each code unit
+        std::vector<bool> m_Shaped;
+        uint32_t m_ShapedCount = 0;
+
+
+    public:
+        // False if the format's font cannot be found or is not fixed-pitch.
+        bool Build(IDWriteFactory* pFactory, IDWriteTextFormat* pFormat, const std::wstring& code);
+
+        uint32_t GetLineCount() const               { return (uint32_t)m_LineStarts.size(); }
+        uint32_t GetLineStart(const uint32_t& line) const { return m_LineStarts[line]; }
+        uint32_t GetLineEnd(const uint32_t& line) const   { return m_LineEnds[line]; }
+        bool IsShaped(const uint32_t& line) const   { return m_Shaped[line]; }
+        uint32_t GetShapedCount() const             { return m_ShapedCount; }
+
+        uint32_t GetLine(const uint32_t& index) const   { return m_Lines[index]; }
+        uint32_t GetColumn(const uint32_t& index) const { return index - m_LineStarts[m_Lines[index]]; }
+
+        // Pen position on the baseline of code unit `index`, relative to the top-left of the block.
+        D2D1_POINT_2F GetPosition(const uint32_t& index) const
+        {
+            return D2D1::Point2F(GetColumn(index) * m_Advance, m_Lines[index] * m_LineHeight + m_Ascent);
+        }
+        float GetLineTop(const uint32_t& line) const { return line * m_LineHeight; }
+
+        IDWriteFontFace* GetFontFace() const    { return m_pFontFace.Get(); }
+        float GetEmSize() const                 { return m_EmSize; }
+        float GetAdvance() const                { return m_Advance; }
+        const UINT16* GetGlyphs() const         { return m_Glyphs.data(); }
+
+        // Like DWRITE_TEXT_METRICS: the widest line without trailing whitespace, and every line.
+        float GetWidth() const  { return m_Width; }
+        float GetHeight() const { return GetLineCount() * m_LineHeight; }
+
+
+    private:
+        // True if the font shapes `text` into its nominal glyphs, one per code unit.
+        bool ShapesNominally(IDWriteTextAnalyzer* pAnalyzer, const wchar_t* text, const uint32_t& length, const UINT16* nominal,
+            const wchar_t* locale) const;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+
+
+enum class OutputFormat : uint8_t
+{
+    P010,       // 4:2:0 10-bit, codes in the high bits, Cb/Cr interleaved
+    NV12,       // 4:2:0 8-bit, Cb/Cr interleaved
+    YUV420P10,  // planar, codes in the low bits
+    YUV422P10,
+    YUV444P10
+};
+
+// Where subsampled chroma sits relative to luma, and therefore how it is filtered. 4:2:0 takes the
+// 2x2 box average of the shader, centered between four luma samples. 4:2:2 is co-sited with the
+// even luma column, as H.264/HEVC require, using a [1 2 1] / 4 horizontal filter.
+enum class ChromaSiting : uint8_t
+{
+    None,
+    Center,
+    Left
+};
+
+
+template <OutputFormat F>
+struct FormatTraits;
+
+template <>
+struct FormatTraits<OutputFormat::P010>
+{
+    static constexpr const char* Name = "p010le";
+    static constexpr uint32_t BitDepth = 10;
+    static constexpr uint32_t ShiftX = 1;
+    static constexpr uint32_t ShiftY = 1;
+    static constexpr bool bInterleaved = true;
+    static constexpr bool bMsbAligned = true;
+    static constexpr ChromaSiting Siting = ChromaSiting::Center;
+};
+
+template <>
+struct FormatTraits<OutputFormat::NV12>
+{
+    static constexpr const char* Name = "nv12";
+    static constexpr uint32_t BitDepth = 8;
+    static constexpr uint32_t ShiftX = 1;
+    static constexpr uint32_t ShiftY = 1;
+    static constexpr bool bInterleaved = true;
+    static constexpr bool bMsbAligned = false;
+    static constexpr ChromaSiting Siting = ChromaSiting::Center;
+};
+
+template <>
+struct FormatTraits<OutputFormat::YUV420P10>
+{
+    static constexpr const char* Name = "yuv420p10le";
+    static constexpr uint32_t BitDepth = 10;
+    static constexpr uint32_t ShiftX = 1;
+    static constexpr uint32_t ShiftY = 1;
+    static constexpr bool bInterleaved = false;
+    static constexpr bool bMsbAligned = false;
+    static constexpr ChromaSiting Siting = ChromaSiting::Center;
+};
+
+template <>
+struct FormatTraits<OutputFormat::YUV422P10>
+{
+    static constexpr const char* Name = "yuv422p10le";
+    static constexpr uint32_t BitDepth = 10;
+    static constexpr uint32_t ShiftX = 1;
+    static constexpr uint32_t ShiftY = 0;
+    static constexpr bool bInterleaved = false;
+    static constexpr bool bMsbAligned = false;
+    static constexpr ChromaSiting Siting = ChromaSiting::Left;
+};
+
+template <>
+struct FormatTraits<OutputFormat::YUV444P10>
+{
+    static constexpr const char* Name = "yuv444p10le";
+    static constexpr uint32_t BitDepth = 10;
+    static constexpr uint32_t ShiftX = 0;
+    static constexpr uint32_t ShiftY = 0;
+    static constexpr bool bInterleaved = false;
+    static constexpr bool bMsbAligned = false;
+    static constexpr ChromaSiting Siting = ChromaSiting::None;
+};
+
+
+// Runtime view of FormatTraits, for code that only learns the format after probing the encoder.
+struct FormatInfo
+{
+    const char* name = "";
+    uint32_t bitDepth = 0;
+    uint32_t shiftX = 0;
+    uint32_t shiftY = 0;
+    bool bInterleaved = false;
+    bool bMsbAligned = false;
+    ChromaSiting siting = ChromaSiting::None;
+
+    uint32_t GetBytesPerSample() const { return bitDepth > 8 ? 2u : 1u; }
+    uint32_t GetPlaneCount() const { return bInterleaved ? 2u : 3u; }
+};
+
+template <OutputFormat F>
+constexpr FormatInfo MakeFormatInfo()
+{
+    using T = FormatTraits<F>;
+    return FormatInfo { T::Name, T::BitDepth, T::ShiftX, T::ShiftY, T::bInterleaved, T::bMsbAligned, T::Siting };
+}
+
+constexpr FormatInfo GetFormatInfo(const OutputFormat& format)
+{
+    switch (format)
+    {
+        case OutputFormat::NV12:        return MakeFormatInfo<OutputFormat::NV12>();
+        case OutputFormat::YUV420P10:   return MakeFormatInfo<OutputFormat::YUV420P10>();
+        case OutputFormat::YUV422P10:   return MakeFormatInfo<OutputFormat::YUV422P10>();
+        case OutputFormat::YUV444P10:   return MakeFormatInfo<OutputFormat::YUV444P10>();
+        default:                        return MakeFormatInfo<OutputFormat::P010>();
+    }
+}
@@ -1,20 +1,31 @@
 #include "Renderer.h"
 #include "Easing.h"
+#include "AssetCache.h"
+#include "ColorConverter.h"
+#include "HResult.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <combaseapi.h>
-#include <WICTextureLoader.h>
 
 
-static void PrintHR(const char* what, HRESULT hr)
+// Share of the code animation a character takes to fade in once its turn comes.
+static constexpr float DecoderFade = 0.01f;
+
+static constexpr float HeaderFontSize = 60.0f;
+static constexpr size_t LayoutCacheSize = 16;
+
+static D2D1_RECT_F ToRect(const GlyphRect& rect)
 {
-    std::cerr << what << " failed: 0x" << std::hex << hr << std::dec << "\n";
+    return D2D1::RectF(rect.left, rect.top, rect.right, rect.bottom);
 }
 
 
-Renderer::Renderer(const uint16_t& width, const uint16_t& height)
+Renderer::Renderer(const uint16_t& width, const uint16_t& height, const RenderBackend& backend)
     : m_Width(width)
     , m_Height(height)
+    , m_Backend(backend)
     , m_HeaderPosition(0, 0)
     , m_CodePosition(0, 0)
     , m_CodeSize(0, 0)
@@ -22,13 +33,11 @@ Renderer::Renderer(const uint16_t& width, const uint16_t& height)
     , m_StartSize(0, 0)
     , m_MidSize(0, 0)
     , m_EndSize(0, 0)
-    , m_CurrentSize(0, 0)
 {}
 
 Renderer::~Renderer()
 {
     delete m_pSyntaxHighlighter;
-    delete m_pHeaderState;
 
     if (m_COMInitialized)
     {
@@ -51,15 +60,68 @@ bool Renderer::Initialize(Slide* pSlide)
         return false;
     }
 
-    m_pSlide = pSlide;
+    if (m_bSystemMemory && m_Backend == RenderBackend::GPU)
+    {
+        std::cout << "The GPU backend renders into D3D11 textures, creating a device anyway\n";
+        m_bSystemMemory = false;
+    }
 
     if (!CreateDevices())           return false;
-    if (!CreateRenderTargets())     return false;
-    if (!CreateD2DTargets())        return false;
-    if (!CreateComputePipeline())   return false;
-    if (!LoadBackgroundTexture())   return false;
-    if (!LoadBlurredTexture())      return false;
 
+    if (m_bSystemMemory)
+    {
+        if (!CreateSoftwareTargets())   return false;
+    }
+    else if (IsFused())
+    {
+        if (!CreateOverlayTargets())    return false;
+    }
+    else
+    {
+        if (!CreateRenderTargets())     return false;
+        if (!CreateD2DTargets())        return false;
+    }
+
+    if (m_Backend == RenderBackend::GPU)
+    {
+        if (!CreateComputePipeline())   return false;
+    }
+
+    if (!InitBrushes())
+        return false;
+
+    if (m_TextBackend == TextBackend::Atlas && !IsFused())
+    {
+        std::cout << "Atlas text needs a fused CPU backend, drawing it with Direct2D\n";
+        m_TextBackend = TextBackend::Direct2D;
+    }
+    m_pGlyphRasterizer = std::make_unique<DWriteRasterizer>(m_pDWriteFactory.Get());
+    m_pGlyphSource = std::make_unique<DWriteGlyphSource>(m_pDWriteFactory.Get(), *m_pGlyphRasterizer);
+    if (m_TextBackend == TextBackend::Atlas)
+        m_pGlyphAtlas = std::make_unique<GlyphAtlas>(*m_pGlyphRasterizer);
+
+    if (!LoadSlide(pSlide))
+        return false;
+
+    std::cout << "Renderer initialized\n";
+    return true;
+}
+
+bool Renderer::LoadSlide(Slide* pSlide, const EndInfo* pPrevEnd)
+{
+    const std::wstring prevHeader = m_Header;
+
+    m_pSlide = pSlide;
+    m_PrevHeader.clear();
+    m_bHeaderChanged = false;
+    m_bHasLastComposite = false;
+    m_bHasLastText = false;
+    m_OutputBase = m_OutputSerial + 1;
+
+    if (!LoadLayers())
+        return false;
+
+    delete m_pSyntaxHighlighter;
     m_pSyntaxHighlighter = new SyntaxHighlighter(pSlide);
     if (!m_pSyntaxHighlighter)
     {
@@ -67,37 +129,35 @@ bool Renderer::Initialize(Slide* pSlide)
         return false;
     }
 
-    if (!InitBrushes())
-        return false;
-
-    m_Tokens = m_pSyntaxHighlighter->Tokenize();
+    m_pSyntaxHighlighter->Tokenize();
 
     m_Header = pSlide->m_Header;
     m_Code = pSlide->m_Code;
 
-    DWRITE_TEXT_METRICS mcode {};
-    m_pCodeLayout = GetTextMetrics(&mcode, pSlide->m_Code, L"Consolas ligaturized v3", pSlide->m_FontSize);
+    GlyphRect mcode {};
+    if (!BuildCodeGlyphs(mcode))
+        return false;
+
+    const float codeWidth = mcode.right - mcode.left;
+    const float codeHeight = mcode.bottom - mcode.top;
     m_CodePosition = D2D1::Point2F
     (
-        (3840 - mcode.width) * 0.5f - mcode.left,
-        (2160 - mcode.height) * 0.5f - mcode.top + 50.0f
+        (m_Width - codeWidth) * 0.5f - mcode.left,
+        (m_Height - codeHeight) * 0.5f - mcode.top + 50.0f
     );
-    m_CodeSize = D2D1::Point2F(mcode.width, mcode.height);
+    m_CodeSize = D2D1::Point2F(codeWidth, codeHeight);
 
     DWRITE_TEXT_METRICS mheader {};
-    m_pHeaderLayout = GetTextMetrics(&mheader, pSlide->m_Header, L"Segoe UI", 60.0f);
+    const CachedLayout* pHeader = GetCachedLayout(pSlide->m_Header, L"Segoe UI", HeaderFontSize);
+    m_pHeaderLayout = pHeader ? pHeader->pLayout : nullptr;
+    if (pHeader)
+        mheader = pHeader->metrics;
     m_HeaderPosition = D2D1::Point2F
     (
-        (3840 - mheader.width) * 0.5f - mheader.left,
-        (2160 - mcode.height - mheader.height - 200) * 0.5f - mheader.top + 50.0f
+        (m_Width - mheader.width) * 0.5f - mheader.left,
+        (m_Height - codeHeight - mheader.height - 200) * 0.5f - mheader.top + 50.0f
     );
 
-    for (const Token& token : m_Tokens)
-    {
-        DWRITE_TEXT_RANGE range = { token.start, token.length };
-        m_pCodeLayout->SetDrawingEffect(SyntaxHighlighter::GetBrush(token).Get(), range);
-    }
-
     InitDecoderStates();
 
     m_CodeDuration = pSlide->m_CodeDuration;
@@ -107,25 +167,28 @@ bool Renderer::Initialize(Slide* pSlide)
     {
         m_StartSize = D2D1::Point2F(0, 0);
         m_StartScale = 0;
-        m_StartY = 1080;
+        m_StartY = m_Height * 0.5f;
     }
     else if (pSlide->m_SlideNo > 1)
     {
-        EndInfo prevEndInfo(pSlide->m_SlideNo - 1);
+        // Back to back, the previous slide's end state and header are still in memory.
+        const EndInfo prevEndInfo = pPrevEnd ? *pPrevEnd : EndInfo(pSlide->m_SlideNo - 1);
 
         m_StartSize = D2D1::Point2F(prevEndInfo.m_WindowX, prevEndInfo.m_WindowY);
         m_StartScale = 1;
         m_StartY = prevEndInfo.m_HeaderY;
 
-        Slide prevSlide(pSlide->m_SlideNo - 1);
-        m_PrevHeader = prevSlide.m_Header;
-
-        if (m_Header.compare(m_PrevHeader) != 0)
+        if (pPrevEnd)
         {
-            m_pHeaderState = new HeaderState();
-            m_pHeaderState->prevPos = D2D1::Point2F(m_HeaderPosition.x, m_StartY);
-            m_pHeaderState->pos = m_HeaderPosition;
+            m_PrevHeader = prevHeader;
         }
+        else
+        {
+            Slide prevSlide(pSlide->m_SlideNo - 1);
+            m_PrevHeader = prevSlide.m_Header;
+        }
+
+        m_bHeaderChanged = m_Header.compare(m_PrevHeader) != 0;
     }
 
     m_MidSize = D2D1::Point2F(m_CodeSize.x + 200, m_CodeSize.y + 300);
@@ -135,7 +198,7 @@ bool Renderer::Initialize(Slide* pSlide)
     {
         m_EndSize = D2D1::Point2F(0, 0);
         m_EndScale = 0;
-        m_EndY = 1080;
+        m_EndY = m_Height * 0.5f;
     }
     else
     {
@@ -146,118 +209,117 @@ bool Renderer::Initialize(Slide* pSlide)
 
     EndInfo endinfo(pSlide->m_SlideNo, m_EndSize, m_EndY);
 
-    std::cout << "Renderer initialized\n";
     return true;
 }
 
 bool Renderer::InitBrushes()
 {
-    HRESULT hr = m_pD2DContext->CreateSolidColorBrush(Colors::Function, &Brushes::Function);
+    HRESULT hr = m_pD2DContext->CreateSolidColorBrush(Colors::Function, &m_Brushes.Function);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Function", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Class, &Brushes::Class);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Class, &m_Brushes.Class);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Class", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::EnumVal, &Brushes::EnumVal);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::EnumVal, &m_Brushes.EnumVal);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for EnumVal", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Parameter, &Brushes::Parameter);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Parameter, &m_Brushes.Parameter);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Parameter", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::LocalVar, &Brushes::LocalVar);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::LocalVar, &m_Brushes.LocalVar);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for LocalVar", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::MemberVar, &Brushes::MemberVar);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::MemberVar, &m_Brushes.MemberVar);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for MemberVar", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Keyword, &Brushes::Keyword);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Keyword, &m_Brushes.Keyword);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Keyword", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::ControlStatement, &Brushes::ControlStatement);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::ControlStatement, &m_Brushes.ControlStatement);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for ControlStatement", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Preprocessor, &Brushes::Preprocessor);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Preprocessor, &m_Brushes.Preprocessor);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Preprocessor", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Comment, &Brushes::Comment);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Comment, &m_Brushes.Comment);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Comment", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Macro, &Brushes::Macro);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Macro, &m_Brushes.Macro);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Macro", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::UEMacro, &Brushes::UEMacro);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::UEMacro, &m_Brushes.UEMacro);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for UEMacro", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Number, &Brushes::Number);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Number, &m_Brushes.Number);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Number", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::StringLiteral, &Brushes::StringLiteral);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::StringLiteral, &m_Brushes.StringLiteral);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for StringLiteral", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::CharLiteral, &Brushes::CharLiteral);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::CharLiteral, &m_Brushes.CharLiteral);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for CharLiteral", hr);
         return false;
     }
 
-    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Other, &Brushes::Other);
+    hr = m_pD2DContext->CreateSolidColorBrush(Colors::Other, &m_Brushes.Other);
     if (FAILED(hr))
     {
         PrintHR("CreateSolidColorBrush for Other", hr);
@@ -277,45 +339,15 @@ bool Renderer::InitBrushes()
 
 bool Renderer::CreateDevices()
 {
-    UINT deviceFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
-#if defined(_DEBUG)
-    deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-
-    D3D_FEATURE_LEVEL levels[] =
-    {
-        D3D_FEATURE_LEVEL_11_1,
-        D3D_FEATURE_LEVEL_11_0,
-        D3D_FEATURE_LEVEL_10_1,
-        D3D_FEATURE_LEVEL_10_0
-    };
-
-    D3D_FEATURE_LEVEL created {};
-    HRESULT hr = D3D11CreateDevice
-    (
-        nullptr,
-        D3D_DRIVER_TYPE_HARDWARE,
-        nullptr,
-        deviceFlags,
-        levels,
-        _countof(levels),
-        D3D11_SDK_VERSION,
-        &m_pD3DDevice,
-        &created,
-        &m_pD3DContext
-    );
-    if (FAILED(hr))
-    {
-        PrintHR("D3D11CreateDevice", hr);
+    if (!m_bSystemMemory && !CreateD3DDevice())
         return false;
-    }
 
     D2D1_FACTORY_OPTIONS fo {};
 #if defined(_DEBUG)
     fo.debugLevel = D2D1_DEBUG_LEVEL_INFORMATION;
 #endif
 
-    hr = D2D1CreateFactory
+    HRESULT hr = D2D1CreateFactory
     (
         D2D1_FACTORY_TYPE_SINGLE_THREADED,
         __uuidof(ID2D1Factory1),
@@ -340,6 +372,10 @@ bool Renderer::CreateDevices()
         return false;
     }
 
+    // Without D3D11 the D2D context comes from the WIC render target in CreateSoftwareTargets.
+    if (m_bSystemMemory)
+        return true;
+
     Microsoft::WRL::ComPtr<IDXGIDevice> dxgiDevice;
     hr = m_pD3DDevice.As(&dxgiDevice);
     if (FAILED(hr))
@@ -365,6 +401,44 @@ bool Renderer::CreateDevices()
     return true;
 }
 
+bool Renderer::CreateD3DDevice()
+{
+    UINT deviceFlags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+#if defined(_DEBUG)
+    deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+    D3D_FEATURE_LEVEL levels[] =
+    {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0,
+        D3D_FEATURE_LEVEL_10_1,
+        D3D_FEATURE_LEVEL_10_0
+    };
+
+    D3D_FEATURE_LEVEL created {};
+    HRESULT hr = D3D11CreateDevice
+    (
+        nullptr,
+        D3D_DRIVER_TYPE_HARDWARE,
+        nullptr,
+        deviceFlags,
+        levels,
+        _countof(levels),
+        D3D11_SDK_VERSION,
+        &m_pD3DDevice,
+        &created,
+        &m_pD3DContext
+    );
+    if (FAILED(hr))
+    {
+        PrintHR("D3D11CreateDevice", hr);
+        return false;
+    }
+
+    return true;
+}
+
 bool Renderer::CreateRenderTargets()
 {
     D3D11_TEXTURE2D_DESC tex {};
@@ -429,6 +503,81 @@ bool Renderer::CreateD2DTargets()
     return true;
 }
 
+bool Renderer::CreateOverlayTargets()
+{
+    // Text goes into its own 8-bit bitmap instead of the RGBA16F render texture, which the fused
+    // path never creates; CompositeFused reads back just the text bounds.
+    D2D1_BITMAP_PROPERTIES1 bp {};
+    bp.pixelFormat      = D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED);
+    bp.dpiX             = 96.0f;
+    bp.dpiY             = 96.0f;
+    bp.bitmapOptions    = D2D1_BITMAP_OPTIONS_TARGET;
+
+    HRESULT hr = m_pD2DContext->CreateBitmap(D2D1::SizeU(m_Width, m_Height), nullptr, 0, &bp, &m_pD2DTargetBitmap);
+    if (FAILED(hr))
+    {
+        PrintHR("CreateBitmap(overlay)", hr);
+        return false;
+    }
+
+    bp.bitmapOptions = D2D1_BITMAP_OPTIONS_CPU_READ | D2D1_BITMAP_OPTIONS_CANNOT_DRAW;
+
+    hr = m_pD2DContext->CreateBitmap(D2D1::SizeU(m_Width, m_Height), nullptr, 0, &bp, &m_pOverlayReadback);
+    if (FAILED(hr))
+    {
+        PrintHR("CreateBitmap(overlay readback)", hr);
+        return false;
+    }
+
+    m_pD2DContext->SetTarget(m_pD2DTargetBitmap.Get());
+    return true;
+}
+
+bool Renderer::CreateSoftwareTargets()
+{
+    // Same 8-bit premultiplied overlay as CreateOverlayTargets, but in a WIC bitmap that D2D's
+    // software rasterizer draws into and ReadOverlay locks directly.
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_pWICFactory));
+    if (FAILED(hr))
+    {
+        PrintHR("CoCreateInstance(WICImagingFactory)", hr);
+        return false;
+    }
+
+    hr = m_pWICFactory->CreateBitmap(m_Width, m_Height, GUID_WICPixelFormat32bppPBGRA, WICBitmapCacheOnLoad, &m_pOverlayBitmap);
+    if (FAILED(hr))
+    {
+        PrintHR("IWICImagingFactory::CreateBitmap(overlay)", hr);
+        return false;
+    }
+
+    const D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties
+    (
+        D2D1_RENDER_TARGET_TYPE_SOFTWARE,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED),
+        96.0f,
+        96.0f
+    );
+
+    Microsoft::WRL::ComPtr<ID2D1RenderTarget> pTarget;
+    hr = m_pD2DFactory->CreateWicBitmapRenderTarget(m_pOverlayBitmap.Get(), &props, &pTarget);
+    if (FAILED(hr))
+    {
+        PrintHR("CreateWicBitmapRenderTarget", hr);
+        return false;
+    }
+
+    hr = pTarget.As(&m_pD2DContext);
+    if (FAILED(hr))
+    {
+        PrintHR("Query ID2D1DeviceContext", hr);
+        return false;
+    }
+
+    std::cout << "Rendering without a D3D11 device, text through D2D's software rasterizer\n";
+    return true;
+}
+
 bool Renderer::CreateComputePipeline()
 {
     UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
@@ -484,41 +633,72 @@ bool Renderer::CreateComputePipeline()
     return true;
 }
 
-void Renderer::RenderCompute(const float& time, const float& progress01)
+AnimationKeys Renderer::GetAnimationKeys() const
 {
-    m_CurrentSize = m_MidSize;
-    
-    if (time <= 0.5f)
-    {
-        m_CurrentSize = D2D1::Point2F
-        (
-            std::lerp(m_StartSize.x, m_MidSize.x, EaseOutAEDoubleBack(LerpTime(time, 0, 0.5f))),
-            std::lerp(m_StartSize.y, m_MidSize.y, EaseOutAEDoubleBack(LerpTime(time, 0, 0.5f)))
-        );
-        m_CurrentScale = std::lerp(m_StartScale, 1.0f, EaseOutAEDoubleBack(LerpTime(time, 0, 0.5f)));
+    AnimationKeys keys {};
+    keys.duration       = m_Duration;
+    keys.codeDuration   = m_CodeDuration;
+    keys.startSizeX     = m_StartSize.x;
+    keys.startSizeY     = m_StartSize.y;
+    keys.midSizeX       = m_MidSize.x;
+    keys.midSizeY       = m_MidSize.y;
+    keys.endSizeX       = m_EndSize.x;
+    keys.endSizeY       = m_EndSize.y;
+    keys.startScale     = m_StartScale;
+    keys.endScale       = m_EndScale;
+    keys.bHeaderChanged = m_bHeaderChanged;
+    return keys;
+}
 
-        m_HeaderPosition.y = std::lerp(m_StartY, m_MidY, EaseOutAEDoubleBack(LerpTime(time, 0, 0.5f)));
+void Renderer::RenderCompute(const FrameState& state)
+{
+    const TextState text = GetTextState(state);
+    m_bTextChanged = !m_bHasLastText || !(text == m_LastText);
+    m_LastText = text;
+    m_bHasLastText = true;
+    m_CompositeDirty = DirtyRect {};
+
+    if (IsFused())
+        m_PendingComposite = state.window;
+    else if (m_Backend == RenderBackend::CPU)
+        CompositeCpu(state.window);
+    else
+        DispatchCompute(state.time, state.window);
+}
+
+DirtyRect Renderer::CollectDirtyRegion(const CompositeParams& params)
+{
+    // Everything outside the old and new window bounds is plain background already, so only that
+    // region and, if the text changes, whatever text was drawn last frame need to be recomposited.
+    DirtyRect region {};
+    if (!m_bHasLastComposite)
+    {
+        region = DirtyRect { 0, 0, m_Width, m_Height };
     }
-    else if (time >= m_Duration - 0.5f)
+    else if (!(params == m_LastComposite))
     {
-        m_CurrentSize = D2D1::Point2F
-        (
-            std::lerp(m_MidSize.x, m_EndSize.x, EaseInAEDoubleBack(LerpTime(time, m_Duration - 0.5f, 0.5f))),
-            std::lerp(m_MidSize.y, m_EndSize.y, EaseInAEDoubleBack(LerpTime(time, m_Duration - 0.5f, 0.5f)))
-        );
-        m_CurrentScale = std::lerp(1.0f, m_EndScale, EaseInAEDoubleBack(LerpTime(time, m_Duration - 0.5f, 0.5f)));
-
-        m_HeaderPosition.y = std::lerp(m_MidY, m_EndY, EaseInAEDoubleBack(LerpTime(time, m_Duration - 0.5f, 0.5f)));
+        region = CpuCompositor::GetShapeBounds(m_LastComposite, m_Width, m_Height);
+        region.Union(CpuCompositor::GetShapeBounds(params, m_Width, m_Height));
     }
+    if (m_bTextChanged)
+        region.Union(m_LastTextBounds);
 
-    if (m_pHeaderState && time <= 0.5f)
-    {
-        m_pHeaderState->prevScale   = std::lerp(1, 0, EaseInOutSine(LerpTime(time, 0, 0.5f)));
-        m_pHeaderState->scale       = std::lerp(0, 1, EaseInOutSine(LerpTime(time, 0, 0.5f)));
+    m_LastComposite = params;
+    m_bHasLastComposite = true;
+    return region;
+}
 
-        m_pHeaderState->prevOpacity = std::lerp(1, 0, EaseInOutSine(LerpTime(time, 0, 0.5f)));
-        m_pHeaderState->opacity     = std::lerp(0, 1, EaseInOutSine(LerpTime(time, 0, 0.5f)));
-    }
+void Renderer::DispatchCompute(const float& time, const CompositeParams& params)
+{
+    const DirtyRect region = CollectDirtyRegion(params);
+    if (region.IsEmpty())
+        return;
+
+    // Whole thread groups run, so the shader also rewrites up to 31 pixels past the region.
+    const UINT gx = (region.x1 - region.x0 + 31) / 32;
+    const UINT gy = (region.y1 - region.y0 + 31) / 32;
+    m_CompositeDirty = DirtyRect { region.x0, region.y0, std::min<uint32_t>(region.x0 + gx * 32, m_Width),
+        std::min<uint32_t>(region.y0 + gy * 32, m_Height) };
 
     D3D11_MAPPED_SUBRESOURCE mapped {};
     HRESULT hr = m_pD3DContext->Map(m_pCSConstants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
@@ -528,11 +708,15 @@ void Renderer::RenderCompute(const float& time, const float& progress01)
         c->Resolution[0]    = static_cast<float>(m_Width);
         c->Resolution[1]    = static_cast<float>(m_Height);
         c->Time             = time;
-        c->Scale            = m_CurrentScale;
-        c->rSize[0]         = m_CurrentSize.x;
-        c->rSize[1]         = m_CurrentSize.y;
+        c->Scale            = params.scale;
+        c->rSize[0]         = params.sizeX;
+        c->rSize[1]         = params.sizeY;
         c->rSizeInitial[0]  = 0;
         c->rSizeInitial[1]  = 0;
+        c->Origin[0]        = static_cast<float>(region.x0);
+        c->Origin[1]        = static_cast<float>(region.y0);
+        c->Padding[0]       = 0;
+        c->Padding[1]       = 0;
         m_pD3DContext->Unmap(m_pCSConstants.Get(), 0);
     }
 
@@ -548,8 +732,6 @@ void Renderer::RenderCompute(const float& time, const float& progress01)
     UINT initialCounts[] = { 0 };
     m_pD3DContext->CSSetUnorderedAccessViews(0, 1, uavs, initialCounts);
 
-    UINT gx = (m_Width + 31) / 32;
-    UINT gy = (m_Height + 31) / 32;
     m_pD3DContext->Dispatch(gx, gy, 1);
 
     ID3D11ShaderResourceView* nullSRV[] = { nullptr, nullptr };
@@ -559,27 +741,345 @@ void Renderer::RenderCompute(const float& time, const float& progress01)
     m_pD3DContext->CSSetUnorderedAccessViews(0, 1, nullUAVs, initialCounts);
 
     m_pD3DContext->CSSetShader(nullptr, nullptr, 0);
+}
+
+void Renderer::CompositeCpu(const CompositeParams& params)
+{
+    m_CompositeDirty = m_pCpuCompositor->CompositeIncremental(params, m_CpuFrame);
+
+    // Without a render texture the text is blended on in EndFrame instead.
+    if (m_bSystemMemory)
+        return;
+
+    DirtyRect region = m_CompositeDirty;
+    if (m_bTextChanged)
+        region.Union(m_LastTextBounds);
+    if (region.IsEmpty())
+        return;
+    m_CompositeDirty = region;
+
+    D3D11_BOX box {};
+    box.left    = region.x0;
+    box.top     = region.y0;
+    box.front   = 0;
+    box.right   = region.x1;
+    box.bottom  = region.y1;
+    box.back    = 1;
+
+    m_pD3DContext->UpdateSubresource(m_pRenderTex.Get(), 0, &box, m_CpuFrame.Row(region.y0) + region.x0,
+        (UINT)m_CpuFrame.GetPitch(), 0);
+}
+
+void Renderer::CompositeCpuOverlay()
+{
+    // The output frame still has last frame's text where the composite does not.
+    DirtyRect region = m_CompositeDirty;
+    if (m_bTextChanged)
+    {
+        region.Union(m_LastTextBounds);
+        region.Union(m_TextBounds);
+    }
+    if (region.IsEmpty())
+        return;
+
+    CpuOverlay overlay {};
+    ReadOverlay(m_OverlayPixels, overlay);
+    m_pCpuCompositor->BlendOverlay(m_CpuFrame, overlay, region, m_OutputFrame);
+    m_OutputChanges[m_OutputSerial % OutputHistory] = region;
+}
+
+void Renderer::CompositeFused()
+{
+    DirtyRect region = CollectDirtyRegion(m_PendingComposite);
+    if (m_bTextChanged)
+        region.Union(m_TextBounds);
+    if (region.IsEmpty())
+    {
+        m_LastTileStats = TileStats {};
+        m_LastTileStats.skipped = m_TiledFrame.GetTileCount();
+        m_TotalTileStats.Add(m_LastTileStats);
+        return;
+    }
+
+    CpuOverlay overlay {};
+    D2D1_MAPPED_RECT mapped {};
+    bool bMapped = false;
+
+    if (m_pGlyphAtlas || m_bSystemMemory)
+    {
+        ReadOverlay(m_OverlayPixels, overlay);
+    }
+    else if (!m_TextBounds.IsEmpty())
+    {
+        const D2D1_POINT_2U point = D2D1::Point2U(m_TextBounds.x0, m_TextBounds.y0);
+        const D2D1_RECT_U rect = D2D1::RectU(m_TextBounds.x0, m_TextBounds.y0, m_TextBounds.x1, m_TextBounds.y1);
 
-    if (time <= 0.5f || time >= m_Duration - 0.5f)
-        m_CodeAnimProgress = 0;
-    else if (time >= 0.5f && time <= m_CodeDuration + 0.5f)
-        m_CodeAnimProgress = EaseInOutSine(LerpTime(time, 0.5f, m_CodeDuration));
-    else if (time >= m_Duration - 1.5f && time <= m_Duration - 0.5f)
-        m_CodeAnimProgress = 1 - EaseInOutSine(LerpTime(time, m_Duration - 1.5f, 1));
+        HRESULT hr = m_pOverlayReadback->CopyFromBitmap(&point, m_pD2DTargetBitmap.Get(), &rect);
+        if (SUCCEEDED(hr))
+            hr = m_pOverlayReadback->Map(D2D1_MAP_OPTIONS_READ, &mapped);
+
+        if (FAILED(hr))
+        {
+            PrintHR("Overlay readback", hr);
+        }
+        else
+        {
+            bMapped = true;
+            overlay.rect    = m_TextBounds;
+            overlay.pitch   = mapped.pitch;
+            overlay.pixels  = mapped.bits + (size_t)m_TextBounds.y0 * mapped.pitch + (size_t)m_TextBounds.x0 * 4;
+        }
+    }
+
+    // Dirty tiles are rewritten whole, but pixels outside the region come out as they were.
+    m_OutputChanges[m_OutputSerial % OutputHistory] = region;
+    if (m_Backend == RenderBackend::CPUTiled)
+    {
+        m_LastTileStats = m_pCpuCompositor->CompositeTiles(m_PendingComposite, overlay, region, m_TiledFrame, m_P010Frame);
+        m_TotalTileStats.Add(m_LastTileStats);
+    }
     else
-        m_CodeAnimProgress = 1;
+    {
+        m_pCpuCompositor->CompositeP010(m_PendingComposite, overlay, region, m_P010Frame);
+    }
+
+    if (bMapped)
+        m_pOverlayReadback->Unmap();
+}
+
+void Renderer::BenchmarkCompositor(const uint32_t& iterations)
+{
+    if (!m_pCpuCompositor)
+    {
+        std::cerr << "Compositor benchmark needs the CPU backend\n";
+        return;
+    }
+
+    CompositeParams params {};
+    params.scale = 1.0f;
+    params.sizeX = m_MidSize.x;
+    params.sizeY = m_MidSize.y;
+
+    CompositeTimings timings = m_pCpuCompositor->Benchmark(params, iterations);
+    std::cout << "Compositor benchmark (" << iterations << " frames, " << GetSimdLevelName(m_pCpuCompositor->GetSimdLevel())
+        << "): per-pixel " << timings.perPixelMs << " ms/frame, spans " << timings.spansMs << " ms/frame\n";
+    std::cout << "To P010: composite + convert " << timings.separateP010Ms << " ms/frame, fused "
+        << timings.fusedP010Ms << " ms/frame, tiled " << timings.tiledP010Ms << " ms/frame\n";
+    std::cout << "RGBA16F -> P010 alone: scalar " << timings.convertScalarMs << " ms/frame, "
+        << GetSimdLevelName(ColorConverter::GetSimdLevel()) << ' ' << timings.convertSimdMs << " ms/frame, "
+        << timings.convertMismatches << " codes differ from the shader\n";
 }
 
 void Renderer::BeginFrame()
 {
+    m_TextBounds = DirtyRect {};
+    m_AtlasPrefix = 0;
+    m_AtlasFadeAlpha = 0.0f;
     m_pD2DContext->BeginDraw();
+
+    if (IsFused() || m_bSystemMemory)
+        m_pD2DContext->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+
+    // The render texture keeps last frame's text. If it is unchanged it is only redrawn where the
+    // composite just painted over it; anywhere else it would be blended onto itself.
+    m_bTextClipped = !IsFused() && !m_bSystemMemory && !m_bTextChanged;
+    if (m_bTextClipped)
+    {
+        const D2D1_RECT_F clip = D2D1::RectF((float)m_CompositeDirty.x0, (float)m_CompositeDirty.y0,
+            (float)m_CompositeDirty.x1, (float)m_CompositeDirty.y1);
+        m_pD2DContext->PushAxisAlignedClip(clip, D2D1_ANTIALIAS_MODE_ALIASED);
+    }
 }
 
 void Renderer::EndFrame()
+{
+    if (m_bTextClipped)
+        m_pD2DContext->PopAxisAlignedClip();
+
+    HRESULT hr = m_pD2DContext->EndDraw();
+    if (FAILED(hr))
+        PrintHR("D2D EndDraw", hr);
+
+    if (IsFused() || m_bSystemMemory)
+    {
+        m_OutputChanges[++m_OutputSerial % OutputHistory] = DirtyRect {};
+        if (IsFused())
+            CompositeFused();
+        else
+            CompositeCpuOverlay();
+    }
+
+    m_LastTextBounds = m_TextBounds;
+}
+
+void Renderer::EndFrame(RenderSlot& slot)
 {
     HRESULT hr = m_pD2DContext->EndDraw();
     if (FAILED(hr))
         PrintHR("D2D EndDraw", hr);
+
+    // The readback bitmap is reused by the next frame, so the slot keeps its own copy.
+    ReadOverlay(slot.overlayPixels, slot.overlay);
+}
+
+DirtyRect Renderer::GetOutputChanges(const uint64_t& serial) const
+{
+    if (serial < m_OutputBase || serial > m_OutputSerial || m_OutputSerial - serial >= OutputHistory)
+        return DirtyRect { 0, 0, m_Width, m_Height };
+
+    DirtyRect region {};
+    for (uint64_t s = serial + 1; s <= m_OutputSerial; ++s)
+        region.Union(m_OutputChanges[s % OutputHistory]);
+    return region;
+}
+
+bool Renderer::ReadOverlay(std::vector<uint8_t>& pixels, CpuOverlay& overlay)
+{
+    overlay = CpuOverlay {};
+    if (m_TextBounds.IsEmpty())
+        return true;
+
+    const DirtyRect& bounds = m_TextBounds;
+    const size_t rowBytes = (size_t)(bounds.x1 - bounds.x0) * 4;
+    pixels.resize(rowBytes * (bounds.y1 - bounds.y0));
+    if (!CopyOverlay(bounds, pixels.data(), rowBytes))
+        return false;
+
+    // D2D drew everything but the code, which goes on top from the atlas.
+    if (m_pGlyphAtlas)
+    {
+        const GlyphTarget target { bounds, pixels.data(), rowBytes };
+        m_CodeGlyphs.DrawPrefix(*m_pGlyphAtlas, target, m_CodePosition.x, m_CodePosition.y, m_AtlasPrefix);
+        if (m_AtlasFadeAlpha > 0.0f)
+            m_CodeGlyphs.DrawCluster(*m_pGlyphAtlas, target, m_CodePosition.x, m_CodePosition.y, m_AtlasFadeIndex, m_AtlasFadeAlpha);
+    }
+
+    overlay.rect   = bounds;
+    overlay.pitch  = rowBytes;
+    overlay.pixels = pixels.data();
+    return true;
+}
+
+bool Renderer::CopyOverlay(const DirtyRect& bounds, uint8_t* pixels, const size_t& pitch)
+{
+    const size_t rowBytes = (size_t)(bounds.x1 - bounds.x0) * 4;
+    const uint32_t rows = bounds.y1 - bounds.y0;
+
+    if (m_pOverlayBitmap)
+    {
+        const WICRect rect { (INT)bounds.x0, (INT)bounds.y0, (INT)(bounds.x1 - bounds.x0), (INT)rows };
+        Microsoft::WRL::ComPtr<IWICBitmapLock> pLock;
+        UINT stride = 0;
+        UINT size = 0;
+        BYTE* pData = nullptr;
+
+        HRESULT hr = m_pOverlayBitmap->Lock(&rect, WICBitmapLockRead, &pLock);
+        if (SUCCEEDED(hr))
+            hr = pLock->GetStride(&stride);
+        if (SUCCEEDED(hr))
+            hr = pLock->GetDataPointer(&size, &pData);
+        if (FAILED(hr))
+        {
+            PrintHR("Overlay bitmap lock", hr);
+            return false;
+        }
+
+        for (uint32_t y = 0; y < rows; ++y)
+            std::memcpy(pixels + y * pitch, pData + (size_t)y * stride, rowBytes);
+        return true;
+    }
+
+    const D2D1_POINT_2U point = D2D1::Point2U(bounds.x0, bounds.y0);
+    const D2D1_RECT_U rect = D2D1::RectU(bounds.x0, bounds.y0, bounds.x1, bounds.y1);
+
+    D2D1_MAPPED_RECT mapped {};
+    HRESULT hr = m_pOverlayReadback->CopyFromBitmap(&point, m_pD2DTargetBitmap.Get(), &rect);
+    if (SUCCEEDED(hr))
+        hr = m_pOverlayReadback->Map(D2D1_MAP_OPTIONS_READ, &mapped);
+
+    if (FAILED(hr))
+    {
+        PrintHR("Overlay readback", hr);
+        return false;
+    }
+
+    for (uint32_t y = 0; y < rows; ++y)
+        std::memcpy(pixels + y * pitch, mapped.bits + (size_t)(bounds.y0 + y) * mapped.pitch + (size_t)bounds.x0 * 4, rowBytes);
+    m_pOverlayReadback->Unmap();
+    return true;
+}
+
+void Renderer::CompositeSlot(const FrameState& state, RenderSlot& slot) const
+{
+    // The slot's buffers hold whatever frame it rendered last, not the previous frame, so the
+    // dirty region is taken against that frame's window and text.
+    const CompositeParams& params = state.window;
+
+    DirtyRect region {};
+    if (!slot.bHasHistory)
+    {
+        region = DirtyRect { 0, 0, m_Width, m_Height };
+    }
+    else if (!(params == slot.lastParams))
+    {
+        region = CpuCompositor::GetShapeBounds(slot.lastParams, m_Width, m_Height);
+        region.Union(CpuCompositor::GetShapeBounds(params, m_Width, m_Height));
+    }
+
+    const TextState text = GetTextState(state);
+    if (!slot.bHasHistory || !(text == slot.lastText))
+    {
+        region.Union(slot.lastTextBounds);
+        region.Union(slot.overlay.rect);
+    }
+
+    slot.lastParams = params;
+    slot.lastText = text;
+    slot.lastTextBounds = slot.overlay.rect;
+    slot.bHasHistory = true;
+
+    slot.tileStats = TileStats {};
+    if (region.IsEmpty())
+    {
+        slot.tileStats.skipped = slot.tiles.GetTileCount();
+        return;
+    }
+
+    if (m_Backend == RenderBackend::CPUTiled)
+        slot.tileStats = m_pCpuCompositor->CompositeTiles(params, slot.overlay, region, slot.tiles, slot.p010);
+    else
+        m_pCpuCompositor->CompositeP010(params, slot.overlay, region, slot.p010);
+}
+
+void Renderer::AddTextBounds(const D2D1_POINT_2F& position, IDWriteTextLayout* pLayout, const float& scale)
+{
+    DWRITE_OVERHANG_METRICS ov {};
+    if (!pLayout || FAILED(pLayout->GetOverhangMetrics(&ov)))
+    {
+        m_TextBounds = DirtyRect { 0, 0, m_Width, m_Height };
+        return;
+    }
+
+    // Overhangs are relative to the layout box; 2 px more covers antialiasing.
+    AddTextBounds(D2D1::RectF(
+        position.x - ov.left * scale - 2.0f,
+        position.y - ov.top * scale - 2.0f,
+        position.x + (pLayout->GetMaxWidth() + ov.right) * scale + 2.0f,
+        position.y + (pLayout->GetMaxHeight() + ov.bottom) * scale + 2.0f
+    ));
+}
+
+void Renderer::AddTextBounds(const D2D1_RECT_F& rect)
+{
+    if (rect.right <= rect.left || rect.bottom <= rect.top)
+        return;
+
+    DirtyRect r {};
+    r.x0 = (uint32_t)std::clamp(std::floor(rect.left), 0.0f, (float)m_Width);
+    r.y0 = (uint32_t)std::clamp(std::floor(rect.top), 0.0f, (float)m_Height);
+    r.x1 = (uint32_t)std::clamp(std::ceil(rect.right), (float)r.x0, (float)m_Width);
+    r.y1 = (uint32_t)std::clamp(std::ceil(rect.bottom), (float)r.y0, (float)m_Height);
+    m_TextBounds.Union(r);
 }
 
 void Renderer::CreateTextFormat(const std::wstring& fontFamily, const float& fontSize,
@@ -626,59 +1126,80 @@ void Renderer::CreateTextFormat(const std::wstring& fontFamily, const float& fon
     m_CurrentFontWeight = weight;
 }
 
-void Renderer::DrawHeader()
+void Renderer::DrawHeader(const FrameState& state)
 {
     if (!m_pHeaderLayout)
         return;
 
-    if (m_CurrentScale == 0)
+    if (state.window.scale == 0)
         return;
 
-    float scale = m_pHeaderState ? m_pHeaderState->scale : 1.0f;
-    scale *= m_CurrentScale;
+    const float scale = state.headerScale * state.window.scale;
+    if (scale != 0)
+        DrawHeaderText(m_Header, scale, state.headerOpacity, state.window);
 
-    DWRITE_TEXT_METRICS mheader {};
-    Microsoft::WRL::ComPtr<IDWriteTextLayout> layout = nullptr;
-    float y = m_HeaderPosition.y;
+    if (state.prevHeaderScale != 0)
+        DrawHeaderText(m_PrevHeader, state.prevHeaderScale, state.prevHeaderOpacity, state.window);
+}
 
-    if (scale != 0)
-    {
-        layout = GetTextMetrics(&mheader, m_Header, L"Segoe UI", 60 * scale);
-        m_HeaderPosition.x = (3840 - mheader.width) * 0.5f - mheader.left;
-        m_HeaderPosition.y += mheader.height / 2 * (1.0f - scale);
+void Renderer::DrawHeaderText(const std::wstring& text, const float& scale, const float& opacity, const CompositeParams& window)
+{
+    // Laid out once at full size; the transitions scale it with the transform, which D2D still
+    // rasterizes at the final size.
+    const CachedLayout* pHeader = GetCachedLayout(text, L"Segoe UI", HeaderFontSize);
+    if (!pHeader || !m_pReusableBrush)
+        return;
 
-        m_HeaderPosition.y = 1080 - m_CurrentSize.y * 0.5f + 100 * m_CurrentScale - mheader.height * 0.5f;
+    const DWRITE_TEXT_METRICS& mheader = pHeader->metrics;
+    const D2D1_POINT_2F position = D2D1::Point2F
+    (
+        (m_Width - mheader.width * scale) * 0.5f - mheader.left * scale,
+        m_Height * 0.5f - window.sizeY * 0.5f + 100 * window.scale - mheader.height * scale * 0.5f
+    );
 
-        float opacity = m_pHeaderState ? m_pHeaderState->opacity : 1;
-        DrawTextFromLayout(layout, D2D1::ColorF(0.7059f, 0.7059f, 0.7059f, opacity), m_HeaderPosition);
-    }
+    m_pReusableBrush->SetColor(D2D1::ColorF(0.7059f, 0.7059f, 0.7059f, opacity));
+    m_pD2DContext->SetTransform(D2D1::Matrix3x2F::Scale(scale, scale) * D2D1::Matrix3x2F::Translation(position.x, position.y));
+    m_pD2DContext->DrawTextLayout(D2D1::Point2F(0.0f, 0.0f), pHeader->pLayout.Get(), m_pReusableBrush.Get());
+    m_pD2DContext->SetTransform(D2D1::Matrix3x2F::Identity());
 
-    if (!m_pHeaderState || m_pHeaderState->prevScale == 0)
-    {
-        m_HeaderPosition.y = y;
-        return;
-    }
+    AddTextBounds(position, pHeader->pLayout.Get(), scale);
+}
 
-    layout = GetTextMetrics(&mheader, m_PrevHeader, L"Segoe UI", 60 * m_pHeaderState->prevScale);
-    m_pHeaderState->prevPos.x = (3840 - mheader.width) * 0.5f - mheader.left;
-    m_pHeaderState->prevPos.y = m_HeaderPosition.y;
+const CachedLayout* Renderer::GetCachedLayout(const std::wstring& text, const std::wstring& fontFamily, const float& fontSize)
+{
+    const uint32_t quarterPoints = (uint32_t)std::lround(fontSize * 4.0f);
+    for (size_t i = 0; i < m_LayoutCache.size(); ++i)
+    {
+        const CachedLayout& entry = m_LayoutCache[i];
+        if (entry.quarterPoints != quarterPoints || entry.text != text || entry.fontFamily != fontFamily)
+            continue;
 
-    m_pHeaderState->prevPos.y = 1080 - m_CurrentSize.y * 0.5f + 100 * m_CurrentScale - mheader.height * 0.5f;
+        std::rotate(m_LayoutCache.begin() + i, m_LayoutCache.begin() + i + 1, m_LayoutCache.end());
+        return &m_LayoutCache.back();
+    }
 
-    DrawTextFromLayout(layout, D2D1::ColorF(0.7059f, 0.7059f, 0.7059f, m_pHeaderState->prevOpacity), m_pHeaderState->prevPos);
+    CachedLayout entry;
+    entry.text = text;
+    entry.fontFamily = fontFamily;
+    entry.quarterPoints = quarterPoints;
+    entry.pLayout = GetTextMetrics(&entry.metrics, text, fontFamily, quarterPoints * 0.25f);
+    if (!entry.pLayout)
+        return nullptr;
 
-    m_HeaderPosition.y = y;
+    if (m_LayoutCache.size() >= LayoutCacheSize)
+        m_LayoutCache.erase(m_LayoutCache.begin());
+    m_LayoutCache.push_back(std::move(entry));
+    return &m_LayoutCache.back();
 }
 
-void Renderer::DrawCode()
+void Renderer::DrawCode(const FrameState& state)
 {
-    if (!m_pCodeLayout)
+    if (m_CodeGlyphs.IsEmpty())
         return;
 
-    DrawTextDecoder(D2D1::ColorF(0.7059f, 0.7059f, 0.7059f, 1.0f), m_CodeAnimProgress);
+    DrawTextDecoder(D2D1::ColorF(0.7059f, 0.7059f, 0.7059f, 1.0f), state.codeProgress);
 }
 
-
 void Renderer::DrawTextFromLayout
 (
     const Microsoft::WRL::ComPtr<IDWriteTextLayout>& layout,
@@ -697,6 +1218,8 @@ void Renderer::DrawTextFromLayout
         layout.Get(),
         m_pReusableBrush.Get()
     );
+
+    AddTextBounds(position, layout.Get());
 }
 
 Microsoft::WRL::ComPtr<IDWriteTextLayout> Renderer::GetTextMetrics
@@ -718,8 +1241,8 @@ Microsoft::WRL::ComPtr<IDWriteTextLayout> Renderer::GetTextMetrics
         text.c_str(),
         static_cast<UINT32>(text.size()),
         m_pCurrentTextFormat.Get(),
-        3840 - 100,
-        2160 - 250,
+        m_Width - 100.0f,
+        m_Height - 250.0f,
         &layout
     );
     if (FAILED(hr) || !layout)
@@ -741,70 +1264,120 @@ Microsoft::WRL::ComPtr<IDWriteTextLayout> Renderer::GetTextMetrics
 }
 
 
-bool Renderer::LoadBackgroundTexture()
+bool Renderer::LoadLayers()
 {
+    // Consecutive slides mostly share a background; keep the layers already uploaded.
+    if (m_pSlide->m_BGNo == m_LayerBGNo && m_pSlide->m_BlurRadius == m_LayerBlurRadius
+        && m_pSlide->m_BlurDim == m_LayerBlurDim)
+        return true;
+
     std::wstring file = L"../in/bg";
     file += std::to_wstring(m_pSlide->m_BGNo);
     file += L".png";
 
-    Microsoft::WRL::ComPtr<ID3D11Resource> texRes;
-    HRESULT hr = DirectX::CreateWICTextureFromFile
-    (
-        m_pD3DDevice.Get(),
-        m_pD3DContext.Get(),
-        file.c_str(),
-        texRes.GetAddressOf(),
-        m_pBackgroundSRV.GetAddressOf()
-    );
+    uint64_t contentHash = 0;
+    if (!AssetCache::LoadDecoded(file, m_BackgroundImage, contentHash))
+        return false;
 
-    if (FAILED(hr))
-    {
-        PrintHR("CreateWICTextureFromFile(bg.png)", hr);
+    // The blurred layer is derived from the sharp one instead of shipping as bgN_blurred.png.
+    BlurSettings blur {};
+    blur.radius = m_pSlide->m_BlurRadius;
+    blur.dim = m_pSlide->m_BlurDim;
+
+    if (!AssetCache::LoadBlurred(contentHash, blur, m_BackgroundImage, m_BlurredImage))
         return false;
-    }
 
-    hr = texRes.As(&m_pBackgroundTex);
-    if (FAILED(hr))
+    if (m_Backend != RenderBackend::GPU)
     {
-        PrintHR("Query ID3D11Texture2D", hr);
-        return false;
+        if (m_pCpuCompositor ? !m_pCpuCompositor->SetLayers(m_BackgroundImage, m_BlurredImage) : !CreateCpuCompositor())
+            return false;
+
+        // The incremental composite only rewrites what the window changes, which would leave the
+        // old background everywhere else.
+        m_pCpuCompositor->InvalidateHistory();
+    }
+    else
+    {
+        if (!CreateLayerTexture(m_BackgroundImage, m_pBackgroundTex, m_pBackgroundSRV)) return false;
+        if (!CreateLayerTexture(m_BlurredImage, m_pBlurredTex, m_pBlurredSRV))          return false;
     }
 
+    m_LayerBGNo = m_pSlide->m_BGNo;
+    m_LayerBlurRadius = m_pSlide->m_BlurRadius;
+    m_LayerBlurDim = m_pSlide->m_BlurDim;
     return true;
 }
 
-bool Renderer::LoadBlurredTexture()
+bool Renderer::CreateLayerTexture
+(
+    const CpuImage& image,
+    Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture,
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv
+)
 {
-    std::wstring file = L"../in/bg";
-    file += std::to_wstring(m_pSlide->m_BGNo);
-    file += L"_blurred.png";
+    D3D11_TEXTURE2D_DESC tex {};
+    tex.Width                   = image.width;
+    tex.Height                  = image.height;
+    tex.MipLevels               = 1;
+    tex.ArraySize               = 1;
+    tex.Format                  = DXGI_FORMAT_R8G8B8A8_UNORM;
+    tex.SampleDesc.Count        = 1;
+    tex.SampleDesc.Quality      = 0;
+    tex.Usage                   = D3D11_USAGE_IMMUTABLE;
+    tex.BindFlags               = D3D11_BIND_SHADER_RESOURCE;
+    tex.CPUAccessFlags          = 0;
+    tex.MiscFlags               = 0;
 
-    Microsoft::WRL::ComPtr<ID3D11Resource> texRes;
-    HRESULT hr = DirectX::CreateWICTextureFromFile
-    (
-        m_pD3DDevice.Get(),
-        m_pD3DContext.Get(),
-        file.c_str(),
-        texRes.GetAddressOf(),
-        m_pBlurredSRV.GetAddressOf()
-    );
+    D3D11_SUBRESOURCE_DATA init {};
+    init.pSysMem                = image.pixels.get();
+    init.SysMemPitch            = image.width * sizeof(uint32_t);
 
+    HRESULT hr = m_pD3DDevice->CreateTexture2D(&tex, &init, texture.ReleaseAndGetAddressOf());
     if (FAILED(hr))
     {
-        PrintHR("CreateWICTextureFromFile(bg_blurred.png)", hr);
+        PrintHR("CreateTexture2D(layer)", hr);
         return false;
     }
 
-    hr = texRes.As(&m_pBlurredTex);
+    hr = m_pD3DDevice->CreateShaderResourceView(texture.Get(), nullptr, srv.ReleaseAndGetAddressOf());
     if (FAILED(hr))
     {
-        PrintHR("Query ID3D11Texture2D", hr);
+        PrintHR("CreateShaderResourceView(layer)", hr);
         return false;
     }
 
     return true;
 }
 
+bool Renderer::CreateCpuCompositor()
+{
+    m_pCpuCompositor = std::make_unique<CpuCompositor>(m_Width, m_Height);
+    if (!m_pCpuCompositor->SetLayers(m_BackgroundImage, m_BlurredImage))
+        return false;
+
+    std::cout << "CPU compositor initialized (" << GetSimdLevelName(m_pCpuCompositor->GetSimdLevel()) << ")\n";
+    return true;
+}
+
+
+bool Renderer::BuildCodeGlyphs(GlyphRect& bounds)
+{
+    const std::vector<TokenType>& types = m_pSyntaxHighlighter->GetTypes();
+
+    std::vector<GlyphColor> colors(m_Code.size());
+    for (uint32_t first = 0, last = 0; first < (uint32_t)colors.size(); first = last)
+    {
+        last = first + 1;
+        while (last < colors.size() && types[last] == types[first])
+            ++last;
+
+        const D2D1_COLOR_F color = SyntaxHighlighter::GetBrush(types[first], m_Brushes)->GetColor();
+        std::fill(colors.begin() + first, colors.begin() + last, GlyphColor { color.r, color.g, color.b, color.a });
+    }
+
+    return m_pGlyphSource->Shape(m_Code, colors, L"Consolas ligaturized v3", m_pSlide->m_FontSize,
+        m_Width - 100.0f, m_Height - 250.0f, m_CodeGlyphs, bounds);
+}
 
 void Renderer::InitDecoderStates()
 {
@@ -848,170 +1421,88 @@ void Renderer::InitDecoderStates()
             s.start = lastVisibleStart;
         }
 
+        // Whitespace shows as soon as it starts; anything else once its fade is over.
+        const float done = (s.bIsNewline || s.bIsWhitespace) ? s.start : s.start + DecoderFade;
+        s.shown = m_CharStates.empty() ? done : std::max(done, m_CharStates.back().shown);
+
         m_CharStates.push_back(s);
     }
 }
 
 void Renderer::DrawTextDecoder(const D2D1::ColorF& /*color*/, float animProgress)
 {
-    if (!m_pCodeLayout)
-        return;
-
-    CreateTextFormat(L"Consolas ligaturized v3", m_pSlide->m_FontSize, DWRITE_FONT_WEIGHT_NORMAL);
-    if (!m_pCurrentTextFormat)
-        return;
-
     const uint32_t n = (uint32_t)m_CharStates.size();
-    if (n == 0)
+    if (n == 0 || m_CodeGlyphs.IsEmpty() || !m_pReusableBrush)
         return;
 
-    const float fadeDur = 0.01f;
+    const uint32_t prefixLen = GetCodePrefix(animProgress);
 
-    auto CharProgress01 = [&](uint32_t i) -> float
+    // With the atlas only the bounds are taken now; the glyphs go on after the readback.
+    if (m_pGlyphAtlas)
     {
-        const float s = m_CharStates[i].start;
-
-        if (m_CharStates[i].bIsWhitespace || m_CharStates[i].bIsNewline)
-            return (animProgress >= s) ? 1.0f : 0.0f;
-
-        if (animProgress <= s)
-            return 0.0f;
-
-        float p = (animProgress - s) / fadeDur;
-        return std::clamp(p, 0.0f, 1.0f);
-    };
-
-    uint32_t prefixLen = 0;
-    while (prefixLen < n && CharProgress01(prefixLen) >= 1.0f)
-        ++prefixLen;
-
-    if (prefixLen > 0)
+        m_AtlasPrefix = prefixLen;
+    }
+    else
     {
-        std::wstring prefix = m_Code.substr(0, prefixLen);
-
-        Microsoft::WRL::ComPtr<IDWriteTextLayout> prefixLayout;
-        HRESULT hr = m_pDWriteFactory->CreateTextLayout
-        (
-            prefix.c_str(),
-            prefixLen,
-            m_pCurrentTextFormat.Get(),
-            3840.0f - 100.0f,
-            2160.0f - 250.0f,
-            &prefixLayout
-        );
-
-        if (SUCCEEDED(hr) && prefixLayout)
+        m_CodeGlyphs.GetPrefix(prefixLen, m_CodeRuns);
+        for (const GlyphRun& run : m_CodeRuns)
         {
-            for (const Token& token : m_Tokens)
-            {
-                const uint32_t ts = token.start;
-                const uint32_t te = token.start + token.length;
-
-                if (token.length == 0)
-                    continue;
-                if (ts >= prefixLen)
-                    continue;
-
-                const uint32_t is = ts;
-                const uint32_t ie = std::min(te, prefixLen);
-                if (ie > is)
-                {
-                    DWRITE_TEXT_RANGE r{};
-                    r.startPosition = is;
-                    r.length = ie - is;
-                    prefixLayout->SetDrawingEffect(SyntaxHighlighter::GetBrush(token).Get(), r);
-                }
-            }
-
-            if (m_pReusableBrush)
-            {
-                m_pReusableBrush->SetColor(Colors::Other);
-                m_pD2DContext->DrawTextLayout
-                (
-                    D2D1::Point2F(m_CodePosition.x, m_CodePosition.y),
-                    prefixLayout.Get(),
-                    m_pReusableBrush.Get()
-                );
-            }
+            m_pReusableBrush->SetColor(D2D1::ColorF(run.color.r, run.color.g, run.color.b, run.color.a));
+            m_pGlyphSource->Draw(m_pD2DContext.Get(), m_CodePosition, run, m_pReusableBrush.Get());
         }
     }
+    AddTextBounds(ToRect(m_CodeGlyphs.GetPrefixBounds(m_CodePosition.x, m_CodePosition.y, prefixLen)));
 
-    if (prefixLen >= n)
-        return;
-
-    const float p01 = CharProgress01(prefixLen);
-    if (p01 <= 0.0f)
+    const float alpha = GetCodeFade(prefixLen, animProgress);
+    if (alpha <= 0.0f)
         return;
 
-    const float alpha = EaseOutCubic(p01);
-
-    float hitX = 0.0f, hitY = 0.0f;
-    DWRITE_HIT_TEST_METRICS hit{};
-    HRESULT hr = m_pCodeLayout->HitTestTextPosition(prefixLen, FALSE, &hitX, &hitY, &hit);
-    if (FAILED(hr))
-        return;
-
-    Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> baseBrush;
+    if (m_pGlyphAtlas)
     {
-        Microsoft::WRL::ComPtr<IUnknown> unk = Brushes::Other;
-        for (const Token& token : m_Tokens)
+        m_AtlasFadeIndex = prefixLen;
+        m_AtlasFadeAlpha = alpha;
+    }
+    else
+    {
+        GlyphRun run;
+        if (m_CodeGlyphs.GetCluster(prefixLen, run))
         {
-            const uint32_t ts = token.start;
-            const uint32_t te = token.start + token.length;
-            if (token.length == 0)
-                continue;
-            if (prefixLen >= ts && prefixLen < te)
-            {
-                unk = SyntaxHighlighter::GetBrush(token);
-                break;
-            }
+            m_pReusableBrush->SetColor(D2D1::ColorF(run.color.r, run.color.g, run.color.b, run.color.a * alpha));
+            m_pGlyphSource->Draw(m_pD2DContext.Get(), m_CodePosition, run, m_pReusableBrush.Get());
         }
-
-        unk.As(&baseBrush);
     }
+    AddTextBounds(ToRect(m_CodeGlyphs.GetClusterBounds(m_CodePosition.x, m_CodePosition.y, prefixLen)));
+}
 
-    if (!baseBrush)
-        baseBrush = Brushes::Other;
-
-    if (!baseBrush || !m_pReusableBrush)
-        return;
-
-    D2D1_COLOR_F c = baseBrush->GetColor();
-    c.a *= alpha;
-
-    m_pReusableBrush->SetColor(c);
-
-    const wchar_t ch = m_Code[prefixLen];
-    if (ch == L'\n' || ch == L' ' || ch == L'\t')
-        return;
+uint32_t Renderer::GetCodePrefix(const float& progress) const
+{
+    // `shown` never decreases, so the fully drawn prefix ends at the first character still to come.
+    return (uint32_t)(std::upper_bound(m_CharStates.begin(), m_CharStates.end(), progress,
+        [](const float& p, const CharState& s) { return p < s.shown; }) - m_CharStates.begin());
+}
 
-    const std::wstring one(1, ch);
-    Microsoft::WRL::ComPtr<IDWriteTextLayout> oneLayout;
-    hr = m_pDWriteFactory->CreateTextLayout
-    (
-        one.c_str(),
-        1,
-        m_pCurrentTextFormat.Get(),
-        std::max(1.0f, hit.width),
-        std::max(1.0f, hit.height),
-        &oneLayout
-    );
-    if (FAILED(hr) || !oneLayout)
-        return;
+float Renderer::GetCodeFade(const uint32_t& prefixLen, const float& progress) const
+{
+    if (prefixLen >= m_CharStates.size())
+        return 0.0f;
 
-    DWRITE_TEXT_RANGE r{ 0, 1 };
-    oneLayout->SetDrawingEffect(m_pReusableBrush.Get(), r);
+    const CharState& s = m_CharStates[prefixLen];
+    if (s.bIsNewline || s.bIsWhitespace || progress <= s.start)
+        return 0.0f;
 
-    m_pD2DContext->DrawTextLayout
-    (
-        D2D1::Point2F(m_CodePosition.x + hitX, m_CodePosition.y + hitY),
-        oneLayout.Get(),
-        m_pReusableBrush.Get()
-    );
+    return EaseOutCubic(std::clamp((progress - s.start) / DecoderFade, 0.0f, 1.0f));
 }
 
-
-float Renderer::LerpTime(float time, float offset, float duration)
+TextState Renderer::GetTextState(const FrameState& state) const
 {
-    return (time - offset) / duration;
+    TextState text {};
+    text.headerScale        = state.headerScale;
+    text.headerOpacity      = state.headerOpacity;
+    text.prevHeaderScale    = state.prevHeaderScale;
+    text.prevHeaderOpacity  = state.prevHeaderOpacity;
+    text.windowScale        = state.window.scale;
+    text.windowSizeY        = state.window.sizeY;
+    text.codePrefix         = GetCodePrefix(state.codeProgress);
+    text.codeFade           = GetCodeFade(text.codePrefix, state.codeProgress);
+    return text;
 }
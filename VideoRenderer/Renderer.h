@@ -6,22 +6,45 @@
 #include <d2d1_1.h>
 #include <dwrite.h>
 #include <d3dcompiler.h>
+#include <wincodec.h>
 #include <wrl/client.h>
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "SyntaxHighlighter.h"
 #include "Slide.h"
 #include "EndInfo.h"
+#include "CpuCompositor.h"
+#include "AnimationTimeline.h"
+#include "CodeGlyphs.h"
+#include "DWriteGlyphSource.h"
+#include "DWriteRasterizer.h"
+#include "GlyphAtlas.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "d2d1.lib")
 #pragma comment(lib, "dwrite.lib")
+#pragma comment(lib, "windowscodecs.lib")
 
 
+enum class RenderBackend : uint8_t
+{
+    GPU,    // ShapeCS.hlsl dispatch
+    CPU,        // CpuCompositor, uploaded into the render texture, or with the text blended on in system memory
+    CPUFused,   // CpuCompositor writes P010 directly, D2D text is read back as an overlay
+    CPUTiled    // as CPUFused, but as per-tile jobs over a TiledFrame
+};
+
+enum class TextBackend : uint8_t
+{
+    Direct2D,   // all text drawn by D2D
+    Atlas       // fused backends: code glyphs blended from a GlyphAtlas into the read-back overlay
+};
+
 struct CSConstants
 {
     float Resolution[2];
@@ -29,25 +52,61 @@ struct CSConstants
     float Scale;
     float rSize[2];
     float rSizeInitial[2];
+    float Origin[2];
+    float Padding[2];
 };
 
 struct CharState
 {
     wchar_t c;
     float start;
+    float shown;            // progress from which this and every character before it are fully drawn
     bool bIsWhitespace;
     bool bIsNewline;
 };
 
-struct HeaderState
+// A layout kept across frames and slides, found again by text, font and size in quarter points.
+struct CachedLayout
+{
+    std::wstring text;
+    std::wstring fontFamily;
+    uint32_t quarterPoints = 0;
+    Microsoft::WRL::ComPtr<IDWriteTextLayout> pLayout;
+    DWRITE_TEXT_METRICS metrics {};
+};
+
+// Inputs that decide what the text overlay draws: the header's size, opacity and position, and how
+// far the code is revealed. Frames with equal states draw identical text.
+struct TextState
+{
+    float headerScale = 0.0f;
+    float headerOpacity = 0.0f;
+    float prevHeaderScale = 0.0f;
+    float prevHeaderOpacity = 0.0f;
+    float windowScale = 0.0f;       // the header sits at a fixed offset from the window's top edge
+    float windowSizeY = 0.0f;
+    uint32_t codePrefix = 0;
+    float codeFade = 0.0f;
+
+    bool operator==(const TextState&) const = default;
+};
+
+// One frame in flight for frame-parallel rendering. The text overlay is copied out on the drawing
+// thread, then CompositeSlot fills `p010` on a pool thread. The slot remembers what its buffers last
+// held so only the difference to that frame is recomposited.
+struct RenderSlot
 {
-    D2D1_POINT_2F prevPos;
-    float prevScale = 1;
-    float prevOpacity = 1;
+    P010Frame p010;
+    TiledFrame tiles;
+    TileStats tileStats;
 
-    D2D1_POINT_2F pos;
-    float scale = 0;
-    float opacity = 0;
+    std::vector<uint8_t> overlayPixels;
+    CpuOverlay overlay;
+
+    CompositeParams lastParams;
+    TextState lastText;
+    DirtyRect lastTextBounds;
+    bool bHasHistory = false;
 };
 
 
@@ -56,9 +115,13 @@ class Renderer
     private:
         uint16_t m_Width = 0;
         uint16_t m_Height = 0;
+        RenderBackend m_Backend = RenderBackend::GPU;
+        TextBackend m_TextBackend = TextBackend::Direct2D;
+        bool m_bSystemMemory = false;
         bool m_COMInitialized = false;
 
         Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> m_pReusableBrush;
+        BrushSet m_Brushes;
 
         Microsoft::WRL::ComPtr<ID3D11Device> m_pD3DDevice;
         Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_pD3DContext;
@@ -72,6 +135,11 @@ class Renderer
         Microsoft::WRL::ComPtr<ID2D1Device> m_pD2DDevice;
         Microsoft::WRL::ComPtr<ID2D1DeviceContext> m_pD2DContext;
         Microsoft::WRL::ComPtr<ID2D1Bitmap1> m_pD2DTargetBitmap;
+        Microsoft::WRL::ComPtr<ID2D1Bitmap1> m_pOverlayReadback;
+
+        // Text target without D3D11: D2D's software rasterizer drawing into system memory.
+        Microsoft::WRL::ComPtr<IWICImagingFactory> m_pWICFactory;
+        Microsoft::WRL::ComPtr<IWICBitmap> m_pOverlayBitmap;
 
         Microsoft::WRL::ComPtr<IDWriteFactory> m_pDWriteFactory;
         Microsoft::WRL::ComPtr<IDWriteTextFormat> m_pCurrentTextFormat;
@@ -81,57 +149,120 @@ class Renderer
         Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pBlurredTex;
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pBlurredSRV;
 
+        CpuImage m_BackgroundImage;
+        CpuImage m_BlurredImage;
+        int m_LayerBGNo = -1;
+        float m_LayerBlurRadius = 0.0f;
+        float m_LayerBlurDim = 0.0f;
+
+        std::unique_ptr<CpuCompositor> m_pCpuCompositor;
+        CpuFrame m_CpuFrame;
+        CpuFrame m_OutputFrame;         // m_CpuFrame with the text, when frames stay in system memory
+        P010Frame m_P010Frame;
+        TiledFrame m_TiledFrame;
+        TileStats m_LastTileStats;
+        TileStats m_TotalTileStats;
+
+        std::unique_ptr<DWriteRasterizer> m_pGlyphRasterizer;     // also the font ids of m_pGlyphSource
+        std::unique_ptr<DWriteGlyphSource> m_pGlyphSource;
+        std::unique_ptr<GlyphAtlas> m_pGlyphAtlas;
+        std::vector<uint8_t> m_OverlayPixels;
+        uint32_t m_AtlasPrefix = 0;         // code drawn from the atlas once the overlay is read back
+        uint32_t m_AtlasFadeIndex = 0;
+        float m_AtlasFadeAlpha = 0.0f;
+        CompositeParams m_PendingComposite;
+
+        CompositeParams m_LastComposite;
+        bool m_bHasLastComposite = false;
+        DirtyRect m_TextBounds;
+        DirtyRect m_LastTextBounds;
+        DirtyRect m_CompositeDirty;     // pixels this frame's composite rewrote
+
+        // What each of the last OutputHistory frames changed in m_OutputFrame or m_P010Frame, by serial.
+        static constexpr uint32_t OutputHistory = 32;
+        DirtyRect m_OutputChanges[OutputHistory];
+        uint64_t m_OutputSerial = 0;    // frames EndFrame has written
+        uint64_t m_OutputBase = 1;      // oldest serial the history reaches back to
+        TextState m_LastText;
+        bool m_bHasLastText = false;
+        bool m_bTextChanged = true;     // otherwise the old text is still in place outside m_CompositeDirty
+        bool m_bTextClipped = false;
+
         Microsoft::WRL::ComPtr<IDWriteTextLayout> m_pHeaderLayout;
-        Microsoft::WRL::ComPtr<IDWriteTextLayout> m_pCodeLayout;
+        std::vector<CachedLayout> m_LayoutCache;    // least recently used first
 
         Slide* m_pSlide;
 
         D2D1_POINT_2F m_HeaderPosition;
         std::wstring m_Header;
         std::wstring m_PrevHeader;
-        HeaderState* m_pHeaderState = nullptr;
+        bool m_bHeaderChanged = false;
         std::wstring m_Code;
         float m_CodeDuration = 0.0f;
         D2D1_POINT_2F m_CodePosition;
         D2D1_POINT_2F m_CodeSize;
 
         SyntaxHighlighter* m_pSyntaxHighlighter;
-        std::vector<Token> m_Tokens;
 
         std::wstring m_CurrentFontFamily;
         float m_CurrentFontSize = 72.0f;
         DWRITE_FONT_WEIGHT m_CurrentFontWeight = DWRITE_FONT_WEIGHT_NORMAL;
 
         std::vector<CharState> m_CharStates;
-        float m_CodeAnimProgress = 0.0f;
+        CodeGlyphs m_CodeGlyphs;
+        std::vector<GlyphRun> m_CodeRuns;       // the revealed prefix, reused every frame
 
         float m_Duration        = 0.0f;
         float m_StartScale      = 0.0f;
         float m_EndScale        = 0.0f;
-        float m_CurrentScale    = 0.0f;
         D2D1_POINT_2F m_StartSize;
         D2D1_POINT_2F m_MidSize;
         D2D1_POINT_2F m_EndSize;
-        D2D1_POINT_2F m_CurrentSize;
         float m_StartY  = 1080;
         float m_MidY    = 1080;
         float m_EndY    = 1080;
 
 
     public:
-        Renderer(const uint16_t& width, const uint16_t& height);
+        Renderer(const uint16_t& width, const uint16_t& height, const RenderBackend& backend = RenderBackend::GPU);
         ~Renderer();
     
         bool Initialize(Slide* pSlide);
         bool InitBrushes();
 
-        void RenderCompute(const float& time, const float& progress01);
+        // Before Initialize. Atlas falls back to Direct2D on backends that do not read text back.
+        void SetTextBackend(const TextBackend& backend) { m_TextBackend = backend; }
+        const AtlasStats* GetAtlasStats() const { return m_pGlyphAtlas ? &m_pGlyphAtlas->GetStats() : nullptr; }
+
+        // Before Initialize. The CPU backends then create no D3D11 device: text is drawn by D2D's
+        // software rasterizer into a WIC bitmap and frames are only handed out in system memory, so
+        // the encoder has to be the software one. Ignored by the GPU backend.
+        void SetSystemMemory(const bool& bSystemMemory) { m_bSystemMemory = bSystemMemory; }
+        bool IsSystemMemory() const { return m_bSystemMemory; }
+
+        // Replaces the slide on an initialized renderer, keeping devices and unchanged layers. With
+        // pPrevEnd the slide continues from that end state and the previous slide's header instead
+        // of reading them back from ../in.
+        bool LoadSlide(Slide* pSlide, const EndInfo* pPrevEnd = nullptr);
+        EndInfo GetEndInfo() const { return EndInfo(m_EndSize, m_EndY); }
+
+        AnimationKeys GetAnimationKeys() const;
+        void RenderCompute(const FrameState& state);
+        void BenchmarkCompositor(const uint32_t& iterations);
     
         void BeginFrame();
         void EndFrame();
     
-        void DrawHeader();
-        void DrawCode();
+        void DrawHeader(const FrameState& state);
+        void DrawCode(const FrameState& state);
+
+        // Frame-parallel path, fused backends only. EndFrame(slot) finishes the text and copies it
+        // into the slot instead of compositing; CompositeSlot may then run on any thread, as long as
+        // each slot is used by one call at a time.
+        bool SupportsFrameParallel() const { return IsFused(); }
+        void EndFrame(RenderSlot& slot);
+        void CompositeSlot(const FrameState& state, RenderSlot& slot) const;
+        void AddTileStats(const TileStats& stats) { m_LastTileStats = stats; m_TotalTileStats.Add(stats); }
 
         void DrawTextFromLayout
         (
@@ -150,6 +281,18 @@ class Renderer
         );
     
         ID3D11Texture2D* GetRenderTexture()     { return m_pRenderTex.Get(); }
+        const P010Frame& GetP010Frame() const   { return m_P010Frame; }
+        const CpuFrame& GetCpuFrame() const     { return m_OutputFrame; }     // CPU backend in system memory
+
+        // The frames above are rewritten in place where they change. A copy of output frame `serial`
+        // only needs what GetOutputChanges(serial) covers to match the current one; that is the whole
+        // frame for serial 0, or once the history or a new slide lies in between.
+        uint64_t GetOutputSerial() const { return m_OutputSerial; }
+        DirtyRect GetOutputChanges(const uint64_t& serial) const;
+        bool IsFused() const                    { return m_Backend == RenderBackend::CPUFused || m_Backend == RenderBackend::CPUTiled; }
+
+        const TileStats& GetLastTileStats() const  { return m_LastTileStats; }
+        const TileStats& GetTotalTileStats() const { return m_TotalTileStats; }
         ID3D11Device* GetDevice()               { return m_pD3DDevice.Get(); }
         ID3D11DeviceContext* GetContext()       { return m_pD3DContext.Get(); }
     
@@ -159,16 +302,37 @@ class Renderer
 
     private:
         bool CreateDevices();
+        bool CreateD3DDevice();
         bool CreateRenderTargets();
         bool CreateD2DTargets();
+        bool CreateOverlayTargets();
+        bool CreateSoftwareTargets();
         bool CreateComputePipeline();
-        bool LoadBackgroundTexture();
-        bool LoadBlurredTexture();
+        bool LoadLayers();
+        bool CreateLayerTexture(const CpuImage& image, Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture,
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+        bool CreateCpuCompositor();
         void CreateTextFormat(const std::wstring& fontFamily, const float& fontSize,
             const DWRITE_FONT_WEIGHT& weight);
 
+        void DispatchCompute(const float& time, const CompositeParams& params);
+        void CompositeCpu(const CompositeParams& params);
+        void CompositeFused();
+        void CompositeCpuOverlay();
+        bool ReadOverlay(std::vector<uint8_t>& pixels, CpuOverlay& overlay);
+        bool CopyOverlay(const DirtyRect& bounds, uint8_t* pixels, const size_t& pitch);
+        DirtyRect CollectDirtyRegion(const CompositeParams& params);
+        void AddTextBounds(const D2D1_POINT_2F& position, IDWriteTextLayout* pLayout, const float& scale = 1.0f);
+        void AddTextBounds(const D2D1_RECT_F& rect);
+        TextState GetTextState(const FrameState& state) const;
+        uint32_t GetCodePrefix(const float& progress) const;
+        float GetCodeFade(const uint32_t& prefixLen, const float& progress) const;
+
+        bool BuildCodeGlyphs(GlyphRect& bounds);
         void InitDecoderStates();
         void DrawTextDecoder(const D2D1::ColorF& color, float animProgress);
+        void DrawHeaderText(const std::wstring& text, const float& scale, const float& opacity, const CompositeParams& window);
 
-        static inline float LerpTime(float time, float offset, float duration);
+        // Valid until the next call.
+        const CachedLayout* GetCachedLayout(const std::wstring& text, const std::wstring& fontFamily, const float& fontSize);
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+// Collects items that finish out of order and hands them out strictly by index, starting at
+// `first`. Any thread may Insert; one consumer pops. At most `capacity` indices past the next one
+// to pop may be outstanding, which the caller guarantees by not starting more work than that.
+template <typename T>
+class ReorderBuffer
+{
+    private:
+        struct Entry
+        {
+            T value {};
+            bool bReady = false;
+        };
+
+        std::vector<Entry> m_Entries;
+        uint64_t m_Next = 0;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_ReadyCV;
+
+        uint32_t m_Pending = 0;
+        uint32_t m_MaxPending = 0;
+        uint64_t m_Stalls = 0;
+
+
+    public:
+        ReorderBuffer(const uint32_t& capacity, const uint64_t& first)
+            : m_Entries(capacity)
+            , m_Next(first)
+        {}
+
+        ReorderBuffer(const ReorderBuffer&) = delete;
+        ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+        void Insert(const uint64_t& index, const T& value)
+        {
+            bool bWake = false;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                Entry& entry = m_Entries[index % m_Entries.size()];
+                entry.value = value;
+                entry.bReady = true;
+
+                ++m_Pending;
+                m_MaxPending = std::max(m_MaxPending, m_Pending);
+                bWake = index == m_Next;
+            }
+
+            if (bWake)
+                m_ReadyCV.notify_one();
+        }
+
+        bool TryPop(T& value)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return PopLocked(value);
+        }
+
+        // Blocks until the next index has been inserted.
+        T Pop()
+        {
+            T value {};
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if (!m_Entries[m_Next % m_Entries.size()].bReady)
+            {
+                ++m_Stalls;
+                m_ReadyCV.wait(lock, [this]() { return m_Entries[m_Next % m_Entries.size()].bReady; });
+            }
+
+            PopLocked(value);
+            return value;
+        }
+
+        uint64_t GetNext() const { return m_Next; }
+
+        // Most items held at once, and how often the consumer had to wait for the next one.
+        uint32_t GetMaxPending() const { return m_MaxPending; }
+        uint64_t GetStalls() const { return m_Stalls; }
+
+
+    private:
+        bool PopLocked(T& value)
+        {
+            Entry& entry = m_Entries[m_Next % m_Entries.size()];
+            if (!entry.bReady)
+                return false;
+
+            value = entry.value;
+            entry.bReady = false;
+            --m_Pending;
+            ++m_Next;
+            return true;
+        }
+};
@@ -8,6 +8,8 @@ cbuffer CSConstants : register(b0)
 	float Scale;
 	float2 rSize;
 	float2 rSizeInitial;
+	float2 Origin;
+	float2 Padding;
 };
 
 Texture2D<float4> BackgroundImg : register(t0);
@@ -29,20 +31,21 @@ float sdCircle(float2 p, float2 center, float r)
 [numthreads(32, 32, 1)]
 void CSMain(uint3 tid : SV_DispatchThreadID)
 {
-	if (tid.x >= (uint) Resolution.x || tid.y >= (uint) Resolution.y)
+	uint2 pix = tid.xy + (uint2) Origin;
+	if (pix.x >= (uint) Resolution.x || pix.y >= (uint) Resolution.y)
 		return;
 
-	float2 p = float2(tid.xy);
+	float2 p = float2(pix);
 	float2 uv = (p + 0.5f) / Resolution;
 
-	float4 outp = BackgroundImg.Load(uint3(tid.xy, 0));
+	float4 outp = BackgroundImg.Load(uint3(pix, 0));
 
 	float2 rcenter = Resolution * 0.5f;
 	float cornerRadius = 100.0f * Scale;
 	
 	float dRect = sdRoundRect(p, rcenter, rSize, cornerRadius);
 	if (dRect <= 0.0f)
-		outp = BlurredImg.Load(uint3(tid.xy, 0));
+		outp = BlurredImg.Load(uint3(pix, 0));
 
 	float2 topLeft = rcenter - rSize * 0.5f + cornerRadius;
 
@@ -63,5 +66,5 @@ void CSMain(uint3 tid : SV_DispatchThreadID)
 	if (d <= 0.0f)
 		outp = float4(0.1569f, 0.7882f, 0.2549f, 1.0f);
 
-	Output[tid.xy] = outp;
+	Output[pix] = outp;
 }
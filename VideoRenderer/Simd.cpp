@@ -0,0 +1,79 @@
+#include "Simd.h"
+
+#if VR_SIMD_X86
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+
+#if VR_SIMD_X86
+static void CpuId(int leaf, int subleaf, int regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = (int)a;
+    regs[1] = (int)b;
+    regs[2] = (int)c;
+    regs[3] = (int)d;
+#endif
+}
+
+static uint64_t ReadXCR0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int lo = 0, hi = 0;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+
+SimdLevel DetectSimdLevel()
+{
+#if VR_SIMD_X86
+    int regs[4] {};
+    CpuId(0, 0, regs);
+    const int maxLeaf = regs[0];
+
+    CpuId(1, 0, regs);
+    const bool sse41    = (regs[2] & (1 << 19)) != 0;
+    const bool osxsave  = (regs[2] & (1 << 27)) != 0;
+    const bool avx      = (regs[2] & (1 << 28)) != 0;
+    const bool f16c     = (regs[2] & (1 << 29)) != 0;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7)
+    {
+        CpuId(7, 0, regs);
+        avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+
+    const bool ymmEnabled = osxsave && ((ReadXCR0() & 0x6) == 0x6);
+
+    if (avx && avx2 && f16c && ymmEnabled)
+        return SimdLevel::AVX2;
+    if (sse41)
+        return SimdLevel::SSE41;
+#endif
+
+    return SimdLevel::Scalar;
+}
+
+const char* GetSimdLevelName(const SimdLevel& level)
+{
+    switch (level)
+    {
+        case SimdLevel::AVX2:   return "AVX2";
+        case SimdLevel::SSE41:  return "SSE4.1";
+        default:                return "scalar";
+    }
+}
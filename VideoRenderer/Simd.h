@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define VR_SIMD_X86 1
+    #include <immintrin.h>
+#else
+    #define VR_SIMD_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic; GCC/Clang need the ISA enabled per function so the
+// kernels can live next to their scalar fallbacks and be picked at runtime.
+#if VR_SIMD_X86 && !defined(_MSC_VER)
+    #define VR_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define VR_TARGET_AVX2  __attribute__((target("avx2,f16c")))
+#else
+    #define VR_TARGET_SSE41
+    #define VR_TARGET_AVX2
+#endif
+
+
+enum class SimdLevel : uint8_t
+{
+    Scalar,
+    SSE41,
+    AVX2    // AVX2 + F16C with OS YMM support
+};
+
+
+SimdLevel DetectSimdLevel();
+const char* GetSimdLevelName(const SimdLevel& level);
+
+
+inline uint16_t FloatToHalf(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    const uint32_t absx = x & 0x7FFFFFFFu;
+
+    if (absx >= 0x7F800000u)
+        return (uint16_t)(sign | 0x7C00u | (absx > 0x7F800000u ? 0x200u : 0u));
+    if (absx >= 0x477FF000u)
+        return (uint16_t)(sign | 0x7C00u);
+
+    if (absx < 0x38800000u)
+    {
+        if (absx < 0x33000000u)
+            return (uint16_t)sign;
+
+        const uint32_t mant = (absx & 0x007FFFFFu) | 0x00800000u;
+        const uint32_t shift = 126u - (absx >> 23);
+        uint32_t h = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1u);
+        const uint32_t half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1u)))
+            ++h;
+        return (uint16_t)(sign | h);
+    }
+
+    uint32_t h = ((absx - 0x38000000u) >> 13);
+    const uint32_t rem = absx & 0x1FFFu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u)))
+        ++h;
+    return (uint16_t)(sign | h);
+}
+
+inline float HalfToFloat(uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1Fu;
+    uint32_t mant = h & 0x3FFu;
+    uint32_t x;
+
+    if (exp == 0x1Fu)
+    {
+        x = sign | 0x7F800000u | (mant << 13);
+    }
+    else if (exp != 0)
+    {
+        x = sign | ((exp + 112u) << 23) | (mant << 13);
+    }
+    else if (mant != 0)
+    {
+        exp = 113u;
+        while ((mant & 0x400u) == 0)
+        {
+            mant <<= 1;
+            --exp;
+        }
+        x = sign | (exp << 23) | ((mant & 0x3FFu) << 13);
+    }
+    else
+    {
+        x = sign;
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+inline uint64_t PackHalf4(const float& r, const float& g, const float& b, const float& a)
+{
+    return (uint64_t)FloatToHalf(r)
+        | ((uint64_t)FloatToHalf(g) << 16)
+        | ((uint64_t)FloatToHalf(b) << 32)
+        | ((uint64_t)FloatToHalf(a) << 48);
+}
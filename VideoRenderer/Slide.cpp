@@ -27,6 +27,10 @@ Slide::Slide(const int& n)
             m_CodeDuration = _wtof(AfterPrefix(line, L"CodeDuration = ").c_str());
         else if (line.starts_with(L"FontSize = "))
             m_FontSize = _wtof(AfterPrefix(line, L"FontSize = ").c_str());
+        else if (line.starts_with(L"BlurRadius = "))
+            m_BlurRadius = _wtof(AfterPrefix(line, L"BlurRadius = ").c_str());
+        else if (line.starts_with(L"BlurDim = "))
+            m_BlurDim = _wtof(AfterPrefix(line, L"BlurDim = ").c_str());
         else if (line.starts_with(L"bg = "))
             m_BGNo = _wtoi(AfterPrefix(line, L"bg = ").c_str());
         else if (line.starts_with(L"Open"))
@@ -60,12 +64,19 @@ Slide::Slide(const int& n)
         return;
     }
 
+    // Tabs become four spaces here, once, so every code unit is one column from then on.
     uint32_t i = 0;
     while (getline(codeFile, line))
     {
         if (i != 0)
             m_Code += '\n';
-        m_Code += line;
+        for (const wchar_t c : line)
+        {
+            if (c == L'\t')
+                m_Code += L"    ";
+            else
+                m_Code += c;
+        }
         i++;
     }
 
@@ -20,6 +20,8 @@ class Slide
         int m_SlideNo           = 1;
         int m_BGNo              = 1;
         float m_FontSize        = 72.0f;
+        float m_BlurRadius      = 100.0f;
+        float m_BlurDim         = 0.75f;
 
         std::unordered_set<std::wstring> m_Classes;
         std::unordered_set<std::wstring> m_Macros;
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread. Head and tail
+// are monotonically increasing counters on separate cache lines; a slot is owned by the producer
+// until the tail store publishes it and by the consumer until the head store returns it. The
+// blocking Push/Pop park on the opposite counter with C++20 atomic wait, so a full ring is the
+// backpressure between stages.
+template <typename T>
+class SpscRing
+{
+    private:
+        std::vector<T> m_Slots;
+        size_t m_Mask = 0;
+
+        alignas(64) std::atomic<size_t> m_Head { 0 };   // written by the consumer
+        alignas(64) std::atomic<size_t> m_Tail { 0 };   // written by the producer
+
+        // Producer-owned
+        alignas(64) uint64_t m_Pushes = 0;
+        uint64_t m_FullWaits = 0;
+        uint64_t m_OccupancySum = 0;
+
+        // Consumer-owned
+        alignas(64) uint64_t m_EmptyWaits = 0;
+
+
+    public:
+        explicit SpscRing(const size_t& capacity)
+        {
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+
+            m_Slots.resize(size);
+            m_Mask = size - 1;
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        size_t GetCapacity() const { return m_Slots.size(); }
+        size_t GetSize() const { return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire); }
+
+        bool TryPush(const T& value)
+        {
+            const size_t tail = m_Tail.load(std::memory_order_relaxed);
+            if (tail - m_Head.load(std::memory_order_acquire) == m_Slots.size())
+                return false;
+
+            m_Slots[tail & m_Mask] = value;
+            m_Tail.store(tail + 1, std::memory_order_release);
+            m_Tail.notify_one();
+
+            ++m_Pushes;
+            m_OccupancySum += tail + 1 - m_Head.load(std::memory_order_relaxed);
+            return true;
+        }
+
+        bool TryPop(T& value)
+        {
+            const size_t head = m_Head.load(std::memory_order_relaxed);
+            if (head == m_Tail.load(std::memory_order_acquire))
+                return false;
+
+            value = m_Slots[head & m_Mask];
+            m_Head.store(head + 1, std::memory_order_release);
+            m_Head.notify_one();
+            return true;
+        }
+
+        void Push(const T& value)
+        {
+            while (!TryPush(value))
+            {
+                ++m_FullWaits;
+                const size_t head = m_Head.load(std::memory_order_acquire);
+                if (m_Tail.load(std::memory_order_relaxed) - head == m_Slots.size())
+                    m_Head.wait(head, std::memory_order_acquire);
+            }
+        }
+
+        T Pop()
+        {
+            T value {};
+            while (!TryPop(value))
+            {
+                ++m_EmptyWaits;
+                const size_t tail = m_Tail.load(std::memory_order_acquire);
+                if (tail == m_Head.load(std::memory_order_relaxed))
+                    m_Tail.wait(tail, std::memory_order_acquire);
+            }
+            return value;
+        }
+
+        // Read once both threads are done with the ring.
+        uint64_t GetFullWaits() const { return m_FullWaits; }
+        uint64_t GetEmptyWaits() const { return m_EmptyWaits; }
+        double GetAverageOccupancy() const { return m_Pushes > 0 ? (double)m_OccupancySum / m_Pushes : 0.0; }
+};
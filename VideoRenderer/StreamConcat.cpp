@@ -0,0 +1,245 @@
+#include "StreamConcat.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+
+static void PrintAVError(const char* what, const int& ret)
+{
+    char errbuf[AV_ERROR_MAX_STRING_SIZE]{};
+    av_strerror(ret, errbuf, sizeof(errbuf));
+    std::cerr << what << ": " << errbuf << "\n";
+}
+
+static bool SameExtradata(const AVCodecParameters* a, const AVCodecParameters* b)
+{
+    return a->extradata_size == b->extradata_size
+        && (a->extradata_size == 0 || std::memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+
+bool StreamConcat::Concatenate(const std::vector<ChunkFile>& chunks, const uint8_t& fps, const std::string& outputPath)
+{
+    if (chunks.empty())
+    {
+        std::cerr << "No chunks to concatenate\n";
+        return false;
+    }
+
+    AVFormatContext* pOutput = nullptr;
+    AVCodecParameters* pFirstParams = avcodec_parameters_alloc();
+    if (!pFirstParams)
+        return false;
+
+    const AVRational frameTime { 1, fps };
+    int64_t lastDts = AV_NOPTS_VALUE;
+    uint64_t packets = 0;
+    bool bOk = true;
+
+    AVPacket* pkt = av_packet_alloc();
+    if (!pkt)
+    {
+        avcodec_parameters_free(&pFirstParams);
+        return false;
+    }
+
+    for (size_t c = 0; c < chunks.size() && bOk; ++c)
+    {
+        AVFormatContext* pInput = nullptr;
+        int streamIndex = -1;
+        if (!OpenChunk(chunks[c].path, pInput, streamIndex))
+        {
+            bOk = false;
+            break;
+        }
+
+        const AVStream* pInStream = pInput->streams[streamIndex];
+        if (c == 0)
+        {
+            avcodec_parameters_copy(pFirstParams, pInStream->codecpar);
+            if (!CreateOutput(outputPath, pInStream, pOutput))
+            {
+                avformat_close_input(&pInput);
+                bOk = false;
+                break;
+            }
+        }
+        else if (pInStream->codecpar->codec_id != pFirstParams->codec_id
+            || pInStream->codecpar->width != pFirstParams->width
+            || pInStream->codecpar->height != pFirstParams->height
+            || pInStream->codecpar->format != pFirstParams->format)
+        {
+            std::cerr << chunks[c].path << " was encoded differently from the first chunk\n";
+            avformat_close_input(&pInput);
+            bOk = false;
+            break;
+        }
+        else if (!SameExtradata(pInStream->codecpar, pFirstParams))
+        {
+            // The output carries the first chunk's headers, which would not describe this one.
+            std::cerr << chunks[c].path << " has different codec headers from the first chunk\n";
+            avformat_close_input(&pInput);
+            bOk = false;
+            break;
+        }
+
+        AVStream* pOutStream = pOutput->streams[0];
+        const int64_t offset = av_rescale_q(chunks[c].startFrame, frameTime, pOutStream->time_base);
+
+        int ret = 0;
+        while ((ret = av_read_frame(pInput, pkt)) >= 0)
+        {
+            if (pkt->stream_index != streamIndex)
+            {
+                av_packet_unref(pkt);
+                continue;
+            }
+
+            av_packet_rescale_ts(pkt, pInStream->time_base, pOutStream->time_base);
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts += offset;
+            if (pkt->dts != AV_NOPTS_VALUE)
+                pkt->dts += offset;
+
+            // A chunk with a deeper reorder delay than the one before steps dts back at the seam.
+            // Moving it would change when frames are shown, so the join fails instead.
+            if (lastDts != AV_NOPTS_VALUE && pkt->dts != AV_NOPTS_VALUE && pkt->dts <= lastDts)
+            {
+                std::cerr << "Decode timestamps go back from " << lastDts << " to " << pkt->dts << " in "
+                    << chunks[c].path << "; the chunks need the same reorder delay\n";
+                av_packet_unref(pkt);
+                bOk = false;
+                break;
+            }
+            if (pkt->dts != AV_NOPTS_VALUE)
+                lastDts = pkt->dts;
+
+            pkt->stream_index = 0;
+            pkt->pos = -1;
+
+            ret = av_interleaved_write_frame(pOutput, pkt);
+            av_packet_unref(pkt);
+            if (ret < 0)
+            {
+                PrintAVError("Error writing packet", ret);
+                bOk = false;
+                break;
+            }
+
+            ++packets;
+        }
+
+        avformat_close_input(&pInput);
+    }
+
+    if (pOutput)
+    {
+        if (bOk)
+            av_write_trailer(pOutput);
+        CloseOutput(pOutput);
+
+        // A partial join is not a playable file.
+        if (!bOk)
+            std::filesystem::remove(outputPath);
+    }
+
+    av_packet_free(&pkt);
+    avcodec_parameters_free(&pFirstParams);
+
+    if (bOk)
+        std::cout << "Concatenated " << chunks.size() << " chunks (" << packets << " packets) into " << outputPath << "\n";
+
+    return bOk;
+}
+
+
+bool StreamConcat::OpenChunk(const std::string& path, AVFormatContext*& pInput, int& streamIndex)
+{
+    int ret = avformat_open_input(&pInput, path.c_str(), nullptr, nullptr);
+    if (ret < 0)
+    {
+        PrintAVError(("Failed to open " + path).c_str(), ret);
+        return false;
+    }
+
+    ret = avformat_find_stream_info(pInput, nullptr);
+    if (ret < 0)
+    {
+        PrintAVError(("Failed to read stream info of " + path).c_str(), ret);
+        avformat_close_input(&pInput);
+        return false;
+    }
+
+    streamIndex = av_find_best_stream(pInput, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0)
+    {
+        std::cerr << path << " has no video stream\n";
+        avformat_close_input(&pInput);
+        return false;
+    }
+
+    return true;
+}
+
+bool StreamConcat::CreateOutput(const std::string& path, const AVStream* pSource, AVFormatContext*& pOutput)
+{
+    avformat_alloc_output_context2(&pOutput, nullptr, nullptr, path.c_str());
+    if (!pOutput)
+    {
+        std::cerr << "Failed to allocate output format context\n";
+        return false;
+    }
+
+    AVStream* pStream = avformat_new_stream(pOutput, nullptr);
+    if (!pStream)
+    {
+        std::cerr << "Failed to create video stream\n";
+        CloseOutput(pOutput);
+        return false;
+    }
+
+    int ret = avcodec_parameters_copy(pStream->codecpar, pSource->codecpar);
+    if (ret < 0)
+    {
+        PrintAVError("Failed to copy codec parameters", ret);
+        CloseOutput(pOutput);
+        return false;
+    }
+
+    pStream->codecpar->codec_tag = 0;
+    pStream->time_base = pSource->time_base;
+
+    if (!(pOutput->oformat->flags & AVFMT_NOFILE))
+    {
+        ret = avio_open(&pOutput->pb, path.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0)
+        {
+            PrintAVError("Failed to open output file", ret);
+            CloseOutput(pOutput);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(pOutput, nullptr);
+    if (ret < 0)
+    {
+        PrintAVError("Failed to write header", ret);
+        CloseOutput(pOutput);
+        return false;
+    }
+
+    return true;
+}
+
+void StreamConcat::CloseOutput(AVFormatContext*& pOutput)
+{
+    if (!pOutput)
+        return;
+
+    if (pOutput->pb && !(pOutput->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&pOutput->pb);
+
+    avformat_free_context(pOutput);
+    pOutput = nullptr;
+}
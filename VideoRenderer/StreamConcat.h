@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+}
+
+
+// One independently encoded piece of a video, starting `startFrame` frames into the result.
+struct ChunkFile
+{
+    std::string path;
+    int64_t startFrame = 0;
+};
+
+
+// Joins chunks that each start on a keyframe into one file without re-encoding. Packets are copied
+// as they are; only their timestamps move by each chunk's start frame. All chunks must come from
+// encoders with the same settings: different codec headers, or decode timestamps that do not
+// increase across a seam, fail the join and leave no output file.
+class StreamConcat
+{
+    public:
+        static bool Concatenate(const std::vector<ChunkFile>& chunks, const uint8_t& fps, const std::string& outputPath);
+
+
+    private:
+        static bool OpenChunk(const std::string& path, AVFormatContext*& pInput, int& streamIndex);
+        static bool CreateOutput(const std::string& path, const AVStream* pSource, AVFormatContext*& pOutput);
+        static void CloseOutput(AVFormatContext*& pOutput);
+};
@@ -1,7 +1,7 @@
 #include "SyntaxHighlighter.h"
 
+#include <algorithm>
 #include <cwctype>
-#include <regex>
 
 
 SyntaxHighlighter::SyntaxHighlighter(Slide* pSlide) : m_pSlide(pSlide) {}
@@ -9,7 +9,7 @@ SyntaxHighlighter::SyntaxHighlighter(Slide* pSlide) : m_pSlide(pSlide) {}
 
 std::vector<Token> SyntaxHighlighter::Tokenize()
 {
-	m_pSlide->m_Code = std::regex_replace(m_pSlide->m_Code, std::wregex(L"\t"), L"    ");
+	m_Types.assign(m_pSlide->m_Code.size(), TokenType::Other);
 
 	while (true)
 	{
@@ -17,6 +17,9 @@ std::vector<Token> SyntaxHighlighter::Tokenize()
 		m_Tokens.push_back(token);
 		if (token.type == TokenType::EndOfFile)
 			break;
+
+		// Lexing stops right after the token, which also covers tokens too long for Token::length.
+		std::fill(m_Types.begin() + token.start, m_Types.begin() + m_Position, token.type);
 	}
 
 	return m_Tokens;
@@ -90,29 +93,34 @@ std::wstring SyntaxHighlighter::GetTokenTypeName(const Token& token)
 	}
 }
 
-Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> SyntaxHighlighter::GetBrush(const Token& token)
+Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> SyntaxHighlighter::GetBrush(const Token& token, const BrushSet& brushes)
 {
-	switch (token.type)
+	return GetBrush(token.type, brushes);
+}
+
+Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> SyntaxHighlighter::GetBrush(const TokenType& type, const BrushSet& brushes)
+{
+	switch (type)
 	{
-		case TokenType::Function:			return Brushes::Function;
-		case TokenType::Class:				return Brushes::Class;
-		case TokenType::EnumVal:			return Brushes::EnumVal;
-		case TokenType::Parameter:			return Brushes::Parameter;
-		case TokenType::LocalVar:			return Brushes::LocalVar;
-		case TokenType::MemberVar:			return Brushes::MemberVar;
-
-		case TokenType::Keyword:			return Brushes::Keyword;
-		case TokenType::ControlStatement:	return Brushes::ControlStatement;
-		case TokenType::Preprocessor:		return Brushes::Preprocessor;
-		case TokenType::Comment:			return Brushes::Comment;
-		case TokenType::Macro:				return Brushes::Macro;
-		case TokenType::UEMacro:			return Brushes::UEMacro;
-
-		case TokenType::Number:				return Brushes::Number;
-		case TokenType::StringLiteral:		return Brushes::StringLiteral;
-		case TokenType::CharLiteral:		return Brushes::CharLiteral;
-
-		default:							return Brushes::Other;
+		case TokenType::Function:			return brushes.Function;
+		case TokenType::Class:				return brushes.Class;
+		case TokenType::EnumVal:			return brushes.EnumVal;
+		case TokenType::Parameter:			return brushes.Parameter;
+		case TokenType::LocalVar:			return brushes.LocalVar;
+		case TokenType::MemberVar:			return brushes.MemberVar;
+
+		case TokenType::Keyword:			return brushes.Keyword;
+		case TokenType::ControlStatement:	return brushes.ControlStatement;
+		case TokenType::Preprocessor:		return brushes.Preprocessor;
+		case TokenType::Comment:			return brushes.Comment;
+		case TokenType::Macro:				return brushes.Macro;
+		case TokenType::UEMacro:			return brushes.UEMacro;
+
+		case TokenType::Number:				return brushes.Number;
+		case TokenType::StringLiteral:		return brushes.StringLiteral;
+		case TokenType::CharLiteral:		return brushes.CharLiteral;
+
+		default:							return brushes.Other;
 	}
 }
 
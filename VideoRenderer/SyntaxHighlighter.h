@@ -33,14 +33,16 @@ namespace Colors
 	const D2D1::ColorF Other			(0.7059f, 0.7059f, 0.7059f, 1.0f);
 }
 
-namespace Brushes
+// One brush per color in Colors. Brushes belong to the D2D device that made them, so every
+// renderer creates its own set.
+struct BrushSet
 {
-	inline Microsoft::WRL::ComPtr<ID2D1SolidColorBrush>
+	Microsoft::WRL::ComPtr<ID2D1SolidColorBrush>
 		Function, Class, EnumVal, Parameter, LocalVar, MemberVar,
 		Keyword, ControlStatement, Preprocessor, Comment, Macro, UEMacro,
 		Number, StringLiteral, CharLiteral,
 		Other;
-}
+};
 
 enum class TokenType : uint8_t
 {
@@ -83,6 +85,7 @@ class SyntaxHighlighter
 {
 	private:
 		std::vector<Token> m_Tokens;
+		std::vector<TokenType> m_Types;
 		uint32_t m_Position = 0;
 
 		bool m_bOnlyWhitespaceSinceBol	= true;
@@ -100,8 +103,12 @@ class SyntaxHighlighter
 		std::vector<Token> Tokenize();
 		Token Next();
 
+		// The type of every code unit of the code Tokenize read, Other between tokens.
+		const std::vector<TokenType>& GetTypes() const { return m_Types; }
+
 		static std::wstring GetTokenTypeName(const Token& token);
-		static Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> GetBrush(const Token& token);
+		static Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> GetBrush(const Token& token, const BrushSet& brushes);
+		static Microsoft::WRL::ComPtr<ID2D1SolidColorBrush> GetBrush(const TokenType& type, const BrushSet& brushes);
 
 
 	private:
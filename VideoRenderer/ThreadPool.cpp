@@ -0,0 +1,134 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+
+struct ParallelJob
+{
+    const std::function<void(uint32_t)>* pFn = nullptr;
+    uint32_t count = 0;
+    std::atomic<uint32_t> next { 0 };
+    std::atomic<uint32_t> done { 0 };
+
+    std::mutex mutex;
+    std::condition_variable doneCV;
+
+    void Drain()
+    {
+        uint32_t finished = 0;
+        for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+        {
+            (*pFn)(i);
+            ++finished;
+        }
+
+        if (finished == 0)
+            return;
+
+        if (done.fetch_add(finished) + finished == count)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            doneCV.notify_all();
+        }
+    }
+};
+
+
+ThreadPool::ThreadPool(const uint32_t& threadCount)
+{
+    uint32_t n = threadCount;
+    if (n == 0)
+        n = std::max(1u, std::thread::hardware_concurrency());
+
+    m_Workers.reserve(n - 1);
+    for (uint32_t i = 1; i < n; ++i)
+        m_Workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStopping = true;
+    }
+    m_WakeCV.notify_all();
+
+    for (std::thread& worker : m_Workers)
+        worker.join();
+}
+
+
+ThreadPool& ThreadPool::Get()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+
+void ThreadPool::ParallelFor(const uint32_t& count, const std::function<void(uint32_t)>& fn)
+{
+    if (count == 0)
+        return;
+
+    if (count == 1 || m_Workers.empty())
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    auto job = std::make_shared<ParallelJob>();
+    job->pFn = &fn;
+    job->count = count;
+
+    const uint32_t helpers = std::min<uint32_t>(count - 1, (uint32_t)m_Workers.size());
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (uint32_t i = 0; i < helpers; ++i)
+            m_Tasks.emplace_back([job]() { job->Drain(); });
+    }
+    m_WakeCV.notify_all();
+
+    job->Drain();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->doneCV.wait(lock, [&]() { return job->done.load() == job->count; });
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    // Nobody else would ever pick the task up.
+    if (m_Workers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.emplace_back(std::move(task));
+    }
+    m_WakeCV.notify_one();
+}
+
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeCV.wait(lock, [this]() { return m_bStopping || !m_Tasks.empty(); });
+
+            if (m_Tasks.empty())
+                return;
+
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+
+        task();
+    }
+}
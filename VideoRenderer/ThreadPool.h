@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+    private:
+        std::vector<std::thread> m_Workers;
+        std::deque<std::function<void()>> m_Tasks;
+        std::mutex m_Mutex;
+        std::condition_variable m_WakeCV;
+        bool m_bStopping = false;
+
+
+    public:
+        explicit ThreadPool(const uint32_t& threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        static ThreadPool& Get();
+
+        uint32_t GetThreadCount() const { return (uint32_t)m_Workers.size() + 1; }
+
+        // Runs fn(0..count-1) across the pool. The calling thread takes part and only waits on
+        // indices other threads have already claimed, so nested calls from workers cannot deadlock.
+        void ParallelFor(const uint32_t& count, const std::function<void(uint32_t)>& fn);
+
+        void Submit(std::function<void()> task);
+
+
+    private:
+        void WorkerLoop();
+};
@@ -1,12 +1,106 @@
 #include "VideoEncoder.h"
+#include "ColorConverter.h"
 
 #include <d3dcompiler.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <cstdlib>
 #include <cstring>
+#include <initializer_list>
 
 #pragma comment(lib, "d3dcompiler.lib")
 
 
+static AVPixelFormat ToAVPixelFormat(const OutputFormat& format)
+{
+    switch (format)
+    {
+        case OutputFormat::NV12:        return AV_PIX_FMT_NV12;
+        case OutputFormat::YUV420P10:   return AV_PIX_FMT_YUV420P10LE;
+        case OutputFormat::YUV422P10:   return AV_PIX_FMT_YUV422P10LE;
+        case OutputFormat::YUV444P10:   return AV_PIX_FMT_YUV444P10LE;
+        default:                        return AV_PIX_FMT_P010LE;
+    }
+}
+
+// x264 and x265 take these names. SVT-AV1 takes a number, fastest highest; the names map onto
+// it in the same order, so a preset carries over when the encoder falls back to libsvtav1.
+static const struct { const char* name; int svtav1; } Presets[] =
+{
+    { "ultrafast", 13 }, { "superfast", 12 }, { "veryfast", 10 }, { "faster", 9 }, { "fast", 8 },
+    { "medium", 6 }, { "slow", 4 }, { "slower", 3 }, { "veryslow", 2 }, { "placebo", 0 }
+};
+
+// The value `codec` takes for `preset`; false if it does not take that preset.
+static bool GetCodecPreset(const char* codec, const std::string& preset, std::string& value)
+{
+    const bool bSvtAv1 = std::strcmp(codec, "libsvtav1") == 0;
+    for (const auto& p : Presets)
+    {
+        if (preset == p.name)
+        {
+            value = bSvtAv1 ? std::to_string(p.svtav1) : preset;
+            return true;
+        }
+    }
+
+    char* end = nullptr;
+    const long number = std::strtol(preset.c_str(), &end, 10);
+    if (bSvtAv1 && !preset.empty() && *end == '\0' && number >= -2 && number <= 13)
+    {
+        value = preset;
+        return true;
+    }
+
+    std::cerr << "Unknown " << codec << " preset " << preset << (bSvtAv1
+        ? ", expected ultrafast to placebo or -2 to 13\n" : ", expected ultrafast to placebo\n");
+    return false;
+}
+
+static bool SetCodecOption(AVCodecContext* pCodecCtx, const char* name, const std::string& value)
+{
+    int ret = av_opt_set(pCodecCtx->priv_data, name, value.c_str(), 0);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE]{};
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "Failed to set " << pCodecCtx->codec->name << " option " << name << "=" << value << ": " << errbuf << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+static bool SetCodecOption(AVCodecContext* pCodecCtx, const char* name, const int64_t& value)
+{
+    int ret = av_opt_set_int(pCodecCtx->priv_data, name, value, 0);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE]{};
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "Failed to set " << pCodecCtx->codec->name << " option " << name << "=" << value << ": " << errbuf << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+static bool ContainsFormat(const AVPixelFormat* formats, const AVPixelFormat& format)
+{
+    if (!formats)
+        return false;
+
+    for (const AVPixelFormat* f = formats; *f != AV_PIX_FMT_NONE; ++f)
+    {
+        if (*f == format)
+            return true;
+    }
+
+    return false;
+}
+
+
 VideoEncoder::VideoEncoder
 (
     const std::string& outputPath,
@@ -33,6 +127,51 @@ bool VideoEncoder::Initialize(ID3D11Device* pD3D11Device)
     if (m_Initialized)
         return true;
 
+    bool bReady = false;
+    if (m_Settings.backend != EncoderBackend::Software)
+    {
+        m_bSoftware = false;
+        bReady = InitializeHardware(pD3D11Device);
+        if (!bReady)
+        {
+            Release();
+            if (m_Settings.backend == EncoderBackend::Hardware)
+            {
+                std::cerr << "Failed to initialize hardware encoder\n";
+                return false;
+            }
+
+            std::cout << "Hardware encoder unavailable, falling back to software\n";
+        }
+    }
+
+    if (!bReady)
+    {
+        m_bSoftware = true;
+        if (!InitializeSoftware(pD3D11Device))
+        {
+            std::cerr << "Failed to initialize software encoder\n";
+            Release();
+            return false;
+        }
+    }
+
+    if (!InitializeMuxer())
+    {
+        std::cerr << "Failed to initialize muxer\n";
+        return false;
+    }
+
+    m_Initialized = true;
+    std::cout << "VideoEncoder initialized (" << m_pCodec->name << ", " << GetFormatInfo(m_Format).name << ")\n";
+    return true;
+}
+
+bool VideoEncoder::InitializeHardware(ID3D11Device* pD3D11Device)
+{
+    if (!pD3D11Device)
+        return false;
+
     m_pD3D11Device = pD3D11Device;
     pD3D11Device->GetImmediateContext(&m_pD3D11Context);
 
@@ -44,6 +183,9 @@ bool VideoEncoder::Initialize(ID3D11Device* pD3D11Device)
         return false;
     }
 
+    if (!FindEncoder())
+        return false;
+
     if (!InitializeHardwareContext(pD3D11Device))
     {
         std::cerr << "Failed to initialize hardware context\n";
@@ -62,14 +204,106 @@ bool VideoEncoder::Initialize(ID3D11Device* pD3D11Device)
         return false;
     }
 
-    if (!InitializeMuxer())
+    return true;
+}
+
+bool VideoEncoder::InitializeSoftware(ID3D11Device* pD3D11Device)
+{
+    // The device is only used to read rendered textures back.
+    if (pD3D11Device)
     {
-        std::cerr << "Failed to initialize muxer\n";
+        m_pD3D11Device = pD3D11Device;
+        pD3D11Device->GetImmediateContext(&m_pD3D11Context);
+    }
+
+    if (!FindEncoder())
+        return false;
+
+    if (!SelectOutputFormat())
+        return false;
+
+    if (!InitializeEncoder())
+    {
+        std::cerr << "Failed to initialize encoder\n";
         return false;
     }
 
-    m_Initialized = true;
-    std::cout << "VideoEncoder initialized\n";
+    return true;
+}
+
+bool VideoEncoder::FindEncoder()
+{
+    if (!m_bSoftware)
+    {
+        m_pCodec = avcodec_find_encoder_by_name("hevc_nvenc");
+        if (!m_pCodec)
+        {
+            std::cerr << "hevc_nvenc encoder not found. Ensure FFmpeg was built with NVENC support.\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    for (const char* name : { m_Settings.codec.c_str(), "libx265", "libx264", "libsvtav1" })
+    {
+        m_pCodec = avcodec_find_encoder_by_name(name);
+        if (m_pCodec)
+        {
+            if (m_Settings.codec != name)
+                std::cout << m_Settings.codec << " not found, using " << name << "\n";
+            return true;
+        }
+    }
+
+    std::cerr << "No software encoder found (tried " << m_Settings.codec << ", libx265, libx264, libsvtav1)\n";
+    return false;
+}
+
+bool VideoEncoder::SelectOutputFormat()
+{
+    // The conversion shader writes P010 or NV12 into D3D11 frames; software encoders take planar
+    // 10-bit, or NV12 from 8-bit-only builds.
+    const std::initializer_list<OutputFormat> candidates = m_bSoftware
+        ? std::initializer_list<OutputFormat> { m_RequestedFormat, OutputFormat::YUV420P10, OutputFormat::NV12 }
+        : std::initializer_list<OutputFormat> { m_RequestedFormat, OutputFormat::P010, OutputFormat::NV12 };
+
+    AVHWFramesConstraints* constraints = m_bSoftware ? nullptr
+        : av_hwdevice_get_hwframe_constraints(m_pHWDeviceCtx, nullptr);
+
+    bool bFound = false;
+    for (OutputFormat format : candidates)
+    {
+        if (!m_bSoftware && format != OutputFormat::P010 && format != OutputFormat::NV12)
+            continue;
+
+        const AVPixelFormat pixFmt = ToAVPixelFormat(format);
+        if (constraints && !ContainsFormat(constraints->valid_sw_formats, pixFmt))
+            continue;
+        if (m_pCodec->pix_fmts && !ContainsFormat(m_pCodec->pix_fmts, pixFmt))
+            continue;
+
+        m_Format = format;
+        bFound = true;
+        break;
+    }
+
+    av_hwframe_constraints_free(&constraints);
+
+    if (!bFound)
+    {
+        std::cerr << m_pCodec->name << " accepts none of the supported output formats\n";
+        return false;
+    }
+
+    // P010 and yuv420p10 carry the same samples; only report real changes.
+    const bool bSameSamples = m_RequestedFormat == OutputFormat::P010 && m_Format == OutputFormat::YUV420P10;
+    if (m_Format != m_RequestedFormat && !bSameSamples)
+    {
+        std::cout << GetFormatInfo(m_RequestedFormat).name << " is not supported by " << m_pCodec->name
+            << (m_bSoftware ? "" : " on D3D11 frames") << ", encoding " << GetFormatInfo(m_Format).name << " instead\n";
+    }
+
     return true;
 }
 
@@ -107,6 +341,9 @@ bool VideoEncoder::InitializeHardwareContext(ID3D11Device* pD3D11Device)
         return false;
     }
 
+    if (!SelectOutputFormat())
+        return false;
+
     m_pHWFramesCtx = av_hwframe_ctx_alloc(m_pHWDeviceCtx);
     if (!m_pHWFramesCtx)
     {
@@ -116,7 +353,7 @@ bool VideoEncoder::InitializeHardwareContext(ID3D11Device* pD3D11Device)
 
     AVHWFramesContext* framesCtx    = (AVHWFramesContext*)m_pHWFramesCtx->data;
     framesCtx->format               = AV_PIX_FMT_D3D11;
-    framesCtx->sw_format            = AV_PIX_FMT_P010LE;
+    framesCtx->sw_format            = ToAVPixelFormat(m_Format);
     framesCtx->width                = m_Width;
     framesCtx->height               = m_Height;
     framesCtx->initial_pool_size    = 0;
@@ -136,32 +373,35 @@ bool VideoEncoder::InitializeHardwareContext(ID3D11Device* pD3D11Device)
 
 bool VideoEncoder::InitializeConverter()
 {
+    const bool bEightBit = m_Format == OutputFormat::NV12;
+
     D3D11_TEXTURE2D_DESC texDesc{};
     texDesc.Width               = (UINT)m_Width;
     texDesc.Height              = (UINT)m_Height;
     texDesc.MipLevels           = 1;
     texDesc.ArraySize           = 1;
-    texDesc.Format              = DXGI_FORMAT_P010;
+    texDesc.Format              = bEightBit ? DXGI_FORMAT_NV12 : DXGI_FORMAT_P010;
     texDesc.SampleDesc.Count    = 1;
     texDesc.Usage               = D3D11_USAGE_DEFAULT;
     texDesc.BindFlags           = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
     texDesc.CPUAccessFlags      = 0;
     texDesc.MiscFlags           = 0;
 
-    HRESULT hr = m_pD3D11Device->CreateTexture2D(&texDesc, nullptr, &m_pP010Texture);
+    HRESULT hr = m_pD3D11Device->CreateTexture2D(&texDesc, nullptr, &m_pOutputTexture);
     if (FAILED(hr))
     {
-        std::cerr << "Failed to create P010 texture: 0x" << std::hex << hr << std::dec << "\n";
+        std::cerr << "Failed to create " << GetFormatInfo(m_Format).name << " texture: 0x"
+            << std::hex << hr << std::dec << "\n";
         return false;
     }
 
     D3D11_UNORDERED_ACCESS_VIEW_DESC1 uavY {};
-    uavY.Format                 = DXGI_FORMAT_R16_UINT;
+    uavY.Format                 = bEightBit ? DXGI_FORMAT_R8_UINT : DXGI_FORMAT_R16_UINT;
     uavY.ViewDimension          = D3D11_UAV_DIMENSION_TEXTURE2D;
     uavY.Texture2D.MipSlice     = 0;
     uavY.Texture2D.PlaneSlice   = 0;
 
-    hr = m_pD3D11Device3->CreateUnorderedAccessView1(m_pP010Texture.Get(), &uavY,
+    hr = m_pD3D11Device3->CreateUnorderedAccessView1(m_pOutputTexture.Get(), &uavY,
         m_pOutputUAV_Y.ReleaseAndGetAddressOf());
     if (FAILED(hr))
     {
@@ -170,12 +410,12 @@ bool VideoEncoder::InitializeConverter()
     }
 
     D3D11_UNORDERED_ACCESS_VIEW_DESC1 uavUV {};
-    uavUV.Format                = DXGI_FORMAT_R16G16_UINT;
+    uavUV.Format                = bEightBit ? DXGI_FORMAT_R8G8_UINT : DXGI_FORMAT_R16G16_UINT;
     uavUV.ViewDimension         = D3D11_UAV_DIMENSION_TEXTURE2D;
     uavUV.Texture2D.MipSlice    = 0;
     uavUV.Texture2D.PlaneSlice  = 1;
 
-    hr = m_pD3D11Device3->CreateUnorderedAccessView1(m_pP010Texture.Get(), &uavUV,
+    hr = m_pD3D11Device3->CreateUnorderedAccessView1(m_pOutputTexture.Get(), &uavUV,
         m_pOutputUAV_UV.ReleaseAndGetAddressOf());
     if (FAILED(hr))
     {
@@ -234,6 +474,26 @@ uint PackP010_10bitCode(uint code10)
     return (code10 & 1023u) << 6;
 }
 
+uint EncodeY(precise float y01)
+{
+#if OUTPUT_8BIT
+    precise float v = saturate(y01) * 219.0 + 16.0;
+    return clamp((uint)floor(v + 0.5), 16u, 235u);
+#else
+    return PackP010_10bitCode(QuantizeY10_Limited(y01));
+#endif
+}
+
+uint EncodeC(precise float cMinusHalfToHalf)
+{
+#if OUTPUT_8BIT
+    precise float v = clamp(cMinusHalfToHalf, -0.5, 0.5) * 224.0 + 128.0;
+    return clamp((uint)floor(v + 0.5), 16u, 240u);
+#else
+    return PackP010_10bitCode(QuantizeC10_Limited(cMinusHalfToHalf));
+#endif
+}
+
 void RGBToYCbCr709_Prime(float3 rgbIn, out precise float Y, out precise float Cb, out precise float Cr)
 {
     precise float3 rgbp = saturate(ToRec709Prime(rgbIn));
@@ -261,7 +521,7 @@ void CSMain(uint3 tid : SV_DispatchThreadID)
     precise float Yp, Cb, Cr;
     RGBToYCbCr709_Prime(rgb, Yp, Cb, Cr);
 
-    OutY[uint2(x, y)] = PackP010_10bitCode(QuantizeY10_Limited(Yp));
+    OutY[uint2(x, y)] = EncodeY(Yp);
 
     if (((x & 1) == 0) && ((y & 1) == 0))
     {
@@ -281,9 +541,7 @@ void CSMain(uint3 tid : SV_DispatchThreadID)
         precise float uAvg = (U00 + U10 + U01 + U11) * 0.25;
         precise float vAvg = (V00 + V10 + V01 + V11) * 0.25;
 
-        OutUV[uint2(x >> 1, y >> 1)] =
-            uint2(PackP010_10bitCode(QuantizeC10_Limited(uAvg)),
-                  PackP010_10bitCode(QuantizeC10_Limited(vAvg)));
+        OutUV[uint2(x >> 1, y >> 1)] = uint2(EncodeC(uAvg), EncodeC(vAvg));
     }
 }
 )";
@@ -291,7 +549,13 @@ void CSMain(uint3 tid : SV_DispatchThreadID)
     Microsoft::WRL::ComPtr<ID3DBlob> csBlob;
     Microsoft::WRL::ComPtr<ID3DBlob> errBlob;
 
-    hr = D3DCompile(csCode, std::strlen(csCode), nullptr, nullptr, nullptr,
+    const D3D_SHADER_MACRO defines[] =
+    {
+        { "OUTPUT_8BIT", bEightBit ? "1" : "0" },
+        { nullptr, nullptr }
+    };
+
+    hr = D3DCompile(csCode, std::strlen(csCode), nullptr, defines, nullptr,
         "CSMain", "cs_5_0", 0, 0, &csBlob, &errBlob);
     if (FAILED(hr))
     {
@@ -331,7 +595,8 @@ void CSMain(uint3 tid : SV_DispatchThreadID)
         return false;
     }
 
-    std::cout << "Color converter initialized (RGBA16F -> P010, plane UAVs, cached SRV, immutable constants)\n";
+    std::cout << "Color converter initialized (RGBA16F -> " << GetFormatInfo(m_Format).name
+        << ", plane UAVs, cached SRV, immutable constants)\n";
     return true;
 }
 
@@ -363,7 +628,7 @@ bool VideoEncoder::EnsureInputSRV(ID3D11Texture2D* pRGBATexture)
     return true;
 }
 
-ID3D11Texture2D* VideoEncoder::ConvertToP010(ID3D11Texture2D* pRGBATexture)
+ID3D11Texture2D* VideoEncoder::ConvertToYuv(ID3D11Texture2D* pRGBATexture)
 {
     if (!EnsureInputSRV(pRGBATexture))
         return nullptr;
@@ -393,18 +658,11 @@ ID3D11Texture2D* VideoEncoder::ConvertToP010(ID3D11Texture2D* pRGBATexture)
 
     m_pD3D11Context->CSSetShader(nullptr, nullptr, 0);
 
-    return m_pP010Texture.Get();
+    return m_pOutputTexture.Get();
 }
 
 bool VideoEncoder::InitializeEncoder()
 {
-    m_pCodec = avcodec_find_encoder_by_name("hevc_nvenc");
-    if (!m_pCodec)
-    {
-        std::cerr << "hevc_nvenc encoder not found. Ensure FFmpeg was built with NVENC support.\n";
-        return false;
-    }
-
     m_pCodecCtx = avcodec_alloc_context3(m_pCodec);
     if (!m_pCodecCtx)
     {
@@ -416,20 +674,50 @@ bool VideoEncoder::InitializeEncoder()
     m_pCodecCtx->height             = m_Height;
     m_pCodecCtx->time_base          = AVRational { 1, m_FPS };
     m_pCodecCtx->framerate          = AVRational { m_FPS, 1 };
-    m_pCodecCtx->pix_fmt            = AV_PIX_FMT_D3D11;
-    m_pCodecCtx->bit_rate           = m_Bitrate;
-    m_pCodecCtx->hw_frames_ctx      = av_buffer_ref(m_pHWFramesCtx);
     m_pCodecCtx->color_range        = AVCOL_RANGE_MPEG;
     m_pCodecCtx->colorspace         = AVCOL_SPC_BT709;
     m_pCodecCtx->color_primaries    = AVCOL_PRI_BT709;
     m_pCodecCtx->color_trc          = AVCOL_TRC_BT709;
 
-    av_opt_set(m_pCodecCtx->priv_data, "preset", "p7", 0);
-    av_opt_set(m_pCodecCtx->priv_data, "tune", "hq", 0);
-    av_opt_set(m_pCodecCtx->priv_data, "profile", "main10", 0);
-    av_opt_set(m_pCodecCtx->priv_data, "rc", "vbr", 0);
-    av_opt_set_int(m_pCodecCtx->priv_data, "cq", m_CQ, 0);
-    av_opt_set_int(m_pCodecCtx->priv_data, "rc-lookahead", m_Lookahead, 0);
+    const FormatInfo info = GetFormatInfo(m_Format);
+    m_pCodecCtx->chroma_sample_location = info.siting == ChromaSiting::Center ? AVCHROMA_LOC_CENTER
+        : info.siting == ChromaSiting::Left ? AVCHROMA_LOC_LEFT : AVCHROMA_LOC_UNSPECIFIED;
+
+    if (m_bSoftware)
+    {
+        m_pCodecCtx->pix_fmt        = ToAVPixelFormat(m_Format);
+        m_pCodecCtx->thread_count   = m_Settings.threads;
+
+        std::string preset;
+        if (!GetCodecPreset(m_pCodec->name, m_Settings.preset, preset)
+            || !SetCodecOption(m_pCodecCtx, "preset", preset)
+            || !SetCodecOption(m_pCodecCtx, "crf", (int64_t)m_Settings.crf))
+            return false;
+
+        // libx265 and SVT-AV1 size their own pools and ignore thread_count.
+        if (m_Settings.threads > 0)
+        {
+            const std::string threads = std::to_string(m_Settings.threads);
+            if (std::strcmp(m_pCodec->name, "libx265") == 0 && !SetCodecOption(m_pCodecCtx, "x265-params", "pools=" + threads))
+                return false;
+            if (std::strcmp(m_pCodec->name, "libsvtav1") == 0 && !SetCodecOption(m_pCodecCtx, "svtav1-params", "lp=" + threads))
+                return false;
+        }
+    }
+    else
+    {
+        m_pCodecCtx->pix_fmt        = AV_PIX_FMT_D3D11;
+        m_pCodecCtx->bit_rate       = m_Bitrate;
+        m_pCodecCtx->hw_frames_ctx  = av_buffer_ref(m_pHWFramesCtx);
+
+        if (!SetCodecOption(m_pCodecCtx, "preset", "p7")
+            || !SetCodecOption(m_pCodecCtx, "tune", "hq")
+            || !SetCodecOption(m_pCodecCtx, "profile", info.bitDepth > 8 ? "main10" : "main")
+            || !SetCodecOption(m_pCodecCtx, "rc", "vbr")
+            || !SetCodecOption(m_pCodecCtx, "cq", (int64_t)m_CQ)
+            || !SetCodecOption(m_pCodecCtx, "rc-lookahead", (int64_t)m_Lookahead))
+            return false;
+    }
 
     int ret = avcodec_open2(m_pCodecCtx, m_pCodec, nullptr);
     if (ret < 0)
@@ -538,27 +826,305 @@ bool VideoEncoder::WritePacket(AVPacket* pkt)
     return true;
 }
 
+AVFrame* VideoEncoder::UploadPlanes(const AVPixelFormat& format, uint8_t* const data[2], const int linesize[2])
+{
+    AVFrame* hwFrame = av_frame_alloc();
+    if (!hwFrame)
+        return nullptr;
+
+    int ret = av_hwframe_get_buffer(m_pHWFramesCtx, hwFrame, 0);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE]{};
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "Failed to get hardware frame: " << errbuf << "\n";
+        av_frame_free(&hwFrame);
+        return nullptr;
+    }
+
+    AVFrame* swFrame = av_frame_alloc();
+    if (!swFrame)
+    {
+        av_frame_free(&hwFrame);
+        return nullptr;
+    }
+
+    swFrame->format         = format;
+    swFrame->width          = m_Width;
+    swFrame->height         = m_Height;
+    swFrame->data[0]        = data[0];
+    swFrame->data[1]        = data[1];
+    swFrame->linesize[0]    = linesize[0];
+    swFrame->linesize[1]    = linesize[1];
+
+    ret = av_hwframe_transfer_data(hwFrame, swFrame, 0);
+    av_frame_free(&swFrame);
+
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE]{};
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "Failed to upload " << av_get_pix_fmt_name(format) << " frame: " << errbuf << "\n";
+        av_frame_free(&hwFrame);
+        return nullptr;
+    }
+
+    hwFrame->pts = m_FrameCount++;
+    return hwFrame;
+}
+
 bool VideoEncoder::EncodeFrame(ID3D11Texture2D* pRGBATexture)
 {
     if (!m_Initialized)
         return false;
 
-    ID3D11Texture2D* pP010Texture = ConvertToP010(pRGBATexture);
-    if (!pP010Texture)
+    // Before anything is converted: the hardware path reuses the texture the held frame points at.
+    if (!EndHeldSpan(m_Settings.bRestoreCfr))
+        return false;
+
+    if (m_bSoftware)
+        return ReadbackTexture(pRGBATexture, m_CpuFrame) && EncodeFrame(m_CpuFrame);
+
+    ID3D11Texture2D* pYuvTexture = ConvertToYuv(pRGBATexture);
+    if (!pYuvTexture)
     {
-        std::cerr << "Failed to convert RGBA16F to P010\n";
+        std::cerr << "Failed to convert RGBA16F to " << GetFormatInfo(m_Format).name << "\n";
         return false;
     }
 
-    AVFrame* frame = WrapD3D11Texture(pP010Texture);
+    AVFrame* frame = WrapD3D11Texture(pYuvTexture);
     if (!frame)
     {
         std::cerr << "Failed to wrap D3D11 texture\n";
         return false;
     }
 
+    return SendFrame(frame);
+}
+
+bool VideoEncoder::EncodeFrame(const P010Frame& p010)
+{
+    if (!m_Initialized)
+        return false;
+
+    if (!EndHeldSpan(m_Settings.bRestoreCfr))
+        return false;
+
+    if (p010.width != m_Width || p010.height != m_Height)
+    {
+        std::cerr << "P010 frame is " << p010.width << "x" << p010.height << ", encoder expects "
+            << m_Width << "x" << m_Height << "\n";
+        return false;
+    }
+
+    // D3D11 P010 frames take the planes as they are. The software encoder and the NV12 fallback get
+    // them repacked into the format they were opened with.
+    if (!m_bSoftware && m_Format == OutputFormat::P010)
+    {
+        uint8_t* const data[2] = { (uint8_t*)p010.luma.data(), (uint8_t*)p010.chroma.data() };
+        const int linesize[2] = { (int)p010.GetLumaPitch(), (int)p010.GetChromaPitch() };
+        return SendFrame(UploadPlanes(AV_PIX_FMT_P010LE, data, linesize));
+    }
+
+    if (!ColorConverter::Repack(p010, m_Format, m_YuvFrame))
+    {
+        std::cerr << "Encoder expects " << GetFormatInfo(m_Format).name << " frames, which P010 cannot be repacked into\n";
+        return false;
+    }
+
+    if (m_bSoftware)
+        return EncodeFrame(m_YuvFrame);
+
+    uint8_t* const data[2] = { m_YuvFrame.planes[0].data(), m_YuvFrame.planes[1].data() };
+    const int linesize[2] = { (int)m_YuvFrame.pitches[0], (int)m_YuvFrame.pitches[1] };
+    return SendFrame(UploadPlanes(ToAVPixelFormat(m_Format), data, linesize));
+}
+
+bool VideoEncoder::EncodeFrame(const CpuFrame& frame)
+{
+    if (!m_Initialized)
+        return false;
+
+    if (!m_bSoftware)
+    {
+        std::cerr << "CPU frames need the software encoder\n";
+        return false;
+    }
+
+    if (frame.width != m_Width || frame.height != m_Height)
+    {
+        std::cerr << "CPU frame is " << frame.width << "x" << frame.height << ", encoder expects "
+            << m_Width << "x" << m_Height << "\n";
+        return false;
+    }
+
+    ColorConverter::Convert(frame, m_Format, m_YuvFrame);
+    return EncodeFrame(m_YuvFrame);
+}
+
+bool VideoEncoder::EncodeFrame(const YuvFrame& frame)
+{
+    if (!m_Initialized)
+        return false;
+
+    if (!EndHeldSpan(m_Settings.bRestoreCfr))
+        return false;
+
+    if (!m_bSoftware)
+    {
+        std::cerr << "System-memory frames need the software encoder\n";
+        return false;
+    }
+
+    if (frame.format != m_Format || frame.width != m_Width || frame.height != m_Height)
+    {
+        std::cerr << GetFormatInfo(frame.format).name << ' ' << frame.width << "x" << frame.height
+            << " frame, encoder expects " << GetFormatInfo(m_Format).name << ' ' << m_Width << "x" << m_Height << "\n";
+        return false;
+    }
+
+    return SendFrame(WrapYuvFrame(frame));
+}
+
+AVFrame* VideoEncoder::WrapYuvFrame(const YuvFrame& yuv)
+{
+    // Copied into a reference-counted frame, so it can be kept for RepeatFrame after the caller
+    // reuses its planes. avcodec_send_frame would otherwise make the same copy itself.
+    AVFrame* frame = av_frame_alloc();
+    if (!frame)
+        return nullptr;
+
+    frame->format   = ToAVPixelFormat(yuv.format);
+    frame->width    = (int)yuv.width;
+    frame->height   = (int)yuv.height;
+
+    int ret = av_frame_get_buffer(frame, 0);
+    if (ret < 0)
+    {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE]{};
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "Failed to allocate frame: " << errbuf << "\n";
+        av_frame_free(&frame);
+        return nullptr;
+    }
+
+    for (uint32_t i = 0; i < GetFormatInfo(yuv.format).GetPlaneCount(); ++i)
+    {
+        const int rows = (int)(yuv.planes[i].size() / yuv.pitches[i]);
+        av_image_copy_plane(frame->data[i], frame->linesize[i], yuv.planes[i].data(), (int)yuv.pitches[i],
+            (int)yuv.pitches[i], rows);
+    }
+
+    frame->pts = m_FrameCount++;
+    return frame;
+}
+
+bool VideoEncoder::ReadbackTexture(ID3D11Texture2D* pTexture, CpuFrame& frame)
+{
+    if (!pTexture || !m_pD3D11Device)
+    {
+        std::cerr << "No D3D11 device to read the frame back from\n";
+        return false;
+    }
+
+    if (!m_pStagingTexture)
+    {
+        D3D11_TEXTURE2D_DESC desc {};
+        pTexture->GetDesc(&desc);
+        desc.Usage          = D3D11_USAGE_STAGING;
+        desc.BindFlags      = 0;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        desc.MiscFlags      = 0;
+
+        HRESULT hr = m_pD3D11Device->CreateTexture2D(&desc, nullptr, &m_pStagingTexture);
+        if (FAILED(hr))
+        {
+            std::cerr << "Failed to create readback texture: 0x" << std::hex << hr << std::dec << "\n";
+            return false;
+        }
+    }
+
+    m_pD3D11Context->CopyResource(m_pStagingTexture.Get(), pTexture);
+
+    D3D11_MAPPED_SUBRESOURCE mapped {};
+    HRESULT hr = m_pD3D11Context->Map(m_pStagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr))
+    {
+        std::cerr << "Failed to map readback texture: 0x" << std::hex << hr << std::dec << "\n";
+        return false;
+    }
+
+    frame.Resize(m_Width, m_Height);
+    for (uint32_t y = 0; y < frame.height; ++y)
+        std::memcpy(frame.Row(y), static_cast<const uint8_t*>(mapped.pData) + (size_t)y * mapped.RowPitch, frame.GetPitch());
+
+    m_pD3D11Context->Unmap(m_pStagingTexture.Get(), 0);
+    return true;
+}
+
+bool VideoEncoder::RepeatFrame()
+{
+    if (!m_Initialized)
+        return false;
+
+    if (!m_pLastFrame)
+    {
+        std::cerr << "No frame to repeat\n";
+        return false;
+    }
+
+    ++m_RepeatCount;
+    if (m_Settings.frameRate == FrameRateMode::Variable)
+    {
+        // The mp4 muxer derives each sample's duration from the next timestamp, so skipping this
+        // one stretches the held frame over it.
+        ++m_FrameCount;
+        ++m_HeldFrames;
+        ++m_ElidedCount;
+        return true;
+    }
+
+    AVFrame* frame = av_frame_clone(m_pLastFrame);
+    if (!frame)
+        return false;
+
+    frame->pts = m_FrameCount++;
+    return SendFrame(frame);
+}
+
+bool VideoEncoder::EndHeldSpan(const bool& bResend)
+{
+    if (m_HeldFrames == 0)
+        return true;
+
+    m_HeldFrames = 0;
+    if (!bResend)
+        return true;
+
+    // The held frame again at the last dropped timestamp, so the next frame follows it by exactly
+    // one frame and the stream is back on the CFR grid.
+    AVFrame* frame = av_frame_clone(m_pLastFrame);
+    if (!frame)
+        return false;
+
+    frame->pts = m_FrameCount - 1;
+    --m_ElidedCount;
+    return SendFrame(frame);
+}
+
+bool VideoEncoder::SendFrame(AVFrame* frame)
+{
+    if (!frame)
+        return false;
+
+    using clock = std::chrono::high_resolution_clock;
+    auto t0 = clock::now();
+
     int ret = avcodec_send_frame(m_pCodecCtx, frame);
-    av_frame_free(&frame);
+
+    // The codec holds its own reference; keep ours for RepeatFrame.
+    av_frame_free(&m_pLastFrame);
+    m_pLastFrame = frame;
 
     if (ret < 0)
     {
@@ -603,6 +1169,11 @@ bool VideoEncoder::EncodeFrame(ID3D11Texture2D* pRGBATexture)
     }
 
     av_packet_free(&pkt);
+
+    m_LastEncodeMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    ++m_SentCount;
+    m_TotalEncodeMs += m_LastEncodeMs;
+    m_MaxEncodeMs = std::max(m_MaxEncodeMs, m_LastEncodeMs);
     return true;
 }
 
@@ -611,6 +1182,12 @@ bool VideoEncoder::Finalize()
     if (!m_Initialized)
         return true;
 
+    // A trailing held span always ends on a frame, or the last sample would be one frame long.
+    EndHeldSpan(true);
+
+    using clock = std::chrono::high_resolution_clock;
+    auto t0 = clock::now();
+
     avcodec_send_frame(m_pCodecCtx, nullptr);
 
     AVPacket* pkt = av_packet_alloc();
@@ -626,6 +1203,18 @@ bool VideoEncoder::Finalize()
         av_packet_free(&pkt);
     }
 
+    if (m_FrameCount > 0)
+    {
+        const double flushMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        std::cout << "Encoded " << m_FrameCount << " frames with " << m_pCodec->name << " ("
+            << GetFormatInfo(m_Format).name << "): " << GetAverageEncodeMs() << " ms/frame average, "
+            << m_MaxEncodeMs << " ms worst, " << flushMs << " ms flush\n";
+        if (m_RepeatCount > 0)
+            std::cout << "  " << m_RepeatCount << " of them repeated the previous frame without rendering\n";
+        if (m_ElidedCount > 0)
+            std::cout << "  " << m_ElidedCount << " dropped as variable frame rate, " << m_SentCount << " sent to the codec\n";
+    }
+
     if (m_pFormatCtx)
     {
         av_write_trailer(m_pFormatCtx);
@@ -633,11 +1222,25 @@ bool VideoEncoder::Finalize()
             avio_closep(&m_pFormatCtx->pb);
     }
 
+    Release();
+    m_Initialized = false;
+
+    std::cout << "Encoder finalized\n";
+    return true;
+}
+
+void VideoEncoder::Release()
+{
+    av_frame_free(&m_pLastFrame);
+
     if (m_pCodecCtx)        avcodec_free_context(&m_pCodecCtx);
     if (m_pFormatCtx)       avformat_free_context(m_pFormatCtx);
     if (m_pHWFramesCtx)     av_buffer_unref(&m_pHWFramesCtx);
     if (m_pHWDeviceCtx)     av_buffer_unref(&m_pHWDeviceCtx);
 
+    m_pFormatCtx = nullptr;
+    m_pStream = nullptr;
+
     m_pCachedInputTex.Reset();
     m_pInputSRV.Reset();
 
@@ -645,14 +1248,11 @@ bool VideoEncoder::Finalize()
     m_pOutputUAV_UV.Reset();
     m_pConvertCS.Reset();
     m_pConvertConstants.Reset();
-    m_pP010Texture.Reset();
+    m_pOutputTexture.Reset();
     m_pD3D11Device3.Reset();
 
+    m_pStagingTexture.Reset();
+
     m_pD3D11Context.Reset();
     m_pD3D11Device.Reset();
-
-    m_Initialized = false;
-
-    std::cout << "Encoder finalized\n";
-    return true;
 }
@@ -7,16 +7,47 @@
 #include <cstdint>
 #include <string>
 
+#include "CpuFrame.h"
+
 extern "C"
 {
     #include <libavcodec/avcodec.h>
     #include <libavformat/avformat.h>
     #include <libavutil/hwcontext.h>
     #include <libavutil/hwcontext_d3d11va.h>
+    #include <libavutil/imgutils.h>
     #include <libavutil/opt.h>
 }
 
 
+enum class EncoderBackend : uint8_t
+{
+    Auto,       // NVENC when present, software otherwise
+    Hardware,
+    Software
+};
+
+enum class FrameRateMode : uint8_t
+{
+    Constant,   // repeated frames are encoded again
+    Variable    // repeated frames are dropped; the frame before them lasts until the next change
+};
+
+// `codec`, `preset`, `crf` and `threads` are for the software path. `codec` is tried first, then
+// libx265, libx264 and libsvtav1.
+struct EncoderSettings
+{
+    EncoderBackend backend = EncoderBackend::Auto;
+    std::string codec = "libx265";
+    std::string preset = "medium";     // ultrafast to placebo; SVT-AV1 maps these or takes -2 to 13
+    int crf = 18;
+    int threads = 0;                    // 0 lets the codec decide
+
+    FrameRateMode frameRate = FrameRateMode::Constant;
+    bool bRestoreCfr = false;           // Variable only: resend a held frame once just before the next change
+};
+
+
 struct ConvertConstants
 {
     uint32_t m_Resolution[2];
@@ -36,6 +67,12 @@ class VideoEncoder
         int m_CQ = 18;
         int m_Lookahead = 0;
 
+        OutputFormat m_RequestedFormat = OutputFormat::P010;
+        OutputFormat m_Format = OutputFormat::P010;
+
+        EncoderSettings m_Settings;
+        bool m_bSoftware = false;
+
         AVBufferRef* m_pHWDeviceCtx      = nullptr;
         AVBufferRef* m_pHWFramesCtx      = nullptr;
         const AVCodec* m_pCodec          = nullptr;
@@ -55,7 +92,23 @@ class VideoEncoder
         Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView1> m_pOutputUAV_UV;
 
         Microsoft::WRL::ComPtr<ID3D11Buffer> m_pConvertConstants;
-        Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pP010Texture;
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pOutputTexture;
+
+        // Software path: RGBA16F read back and converted on the CPU.
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pStagingTexture;
+        CpuFrame m_CpuFrame;
+        YuvFrame m_YuvFrame;
+
+        double m_LastEncodeMs = 0.0;
+        double m_TotalEncodeMs = 0.0;
+        double m_MaxEncodeMs = 0.0;
+
+        // Last frame sent, kept referenced so RepeatFrame can send it again without a copy.
+        AVFrame* m_pLastFrame = nullptr;
+        uint32_t m_RepeatCount = 0;
+        uint32_t m_HeldFrames = 0;      // repeats dropped since the last frame sent, in VFR mode
+        uint32_t m_ElidedCount = 0;
+        int32_t m_SentCount = 0;
 
         int32_t m_FrameCount = 0;
         bool m_Initialized = false;
@@ -66,21 +119,54 @@ class VideoEncoder
             const uint8_t& fps, const uint32_t& bitrate);
         ~VideoEncoder();
     
+        // Preferred output format; Initialize falls back to one the encoder and frames context accept.
+        void SetOutputFormat(const OutputFormat& format) { m_RequestedFormat = format; }
+        OutputFormat GetOutputFormat() const { return m_Format; }
+
+        void SetSettings(const EncoderSettings& settings) { m_Settings = settings; }
+        bool IsSoftware() const { return m_bSoftware; }
+        const char* GetCodecName() const { return m_pCodec ? m_pCodec->name : ""; }
+
+        // Wall time spent handing frames to the codec and draining packets, conversion excluded.
+        double GetLastEncodeMs() const { return m_LastEncodeMs; }
+        double GetAverageEncodeMs() const { return m_SentCount > 0 ? m_TotalEncodeMs / m_SentCount : 0.0; }
+
+        // pD3D11Device may be null for the software path when frames only arrive as CPU frames.
         bool Initialize(ID3D11Device* pD3D11Device);
         bool EncodeFrame(ID3D11Texture2D* pTexture);
+        bool EncodeFrame(const P010Frame& frame);
+        bool EncodeFrame(const CpuFrame& frame);
+        bool EncodeFrame(const YuvFrame& frame);
+        // For frames that would render identically to the previous one. In CFR mode the previous
+        // frame is sent again with the next timestamp; in VFR mode only the timestamp advances.
+        bool RepeatFrame();
         bool Finalize();
+
+        // Copies an RGBA16F texture into system memory; software path only. Not thread-safe with
+        // other use of the device's immediate context.
+        bool ReadbackTexture(ID3D11Texture2D* pTexture, CpuFrame& frame);
     
 
     private:
+        bool InitializeHardware(ID3D11Device* pD3D11Device);
+        bool InitializeSoftware(ID3D11Device* pD3D11Device);
+        void Release();
+
+        bool FindEncoder();
+        bool SelectOutputFormat();
         bool InitializeHardwareContext(ID3D11Device* pD3D11Device);
         bool InitializeConverter();
         bool InitializeEncoder();
         bool InitializeMuxer();
     
-        ID3D11Texture2D* ConvertToP010(ID3D11Texture2D* pRGBATexture);
+        ID3D11Texture2D* ConvertToYuv(ID3D11Texture2D* pRGBATexture);
 
         bool EnsureInputSRV(ID3D11Texture2D* pRGBATexture);
     
         AVFrame* WrapD3D11Texture(ID3D11Texture2D* pTexture);
+        AVFrame* UploadPlanes(const AVPixelFormat& format, uint8_t* const data[2], const int linesize[2]);
+        AVFrame* WrapYuvFrame(const YuvFrame& frame);
+        bool EndHeldSpan(const bool& bResend);
+        bool SendFrame(AVFrame* frame);
         bool WritePacket(AVPacket* pkt);
 };
@@ -1,42 +1,157 @@
 #include "Application.h"
+#include "BatchRenderer.h"
+#include "CompositorTest.h"
 #include "Slide.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <fstream>
 
 
-int main()
+// Renders slides [first, last] back to back into one file through one Application.
+static bool RenderRange(const int& first, const int& last, const BatchOptions& options)
+{
+    const std::string output = options.outputDir + "/" + std::to_string(first) + "-" + std::to_string(last) + ".mp4";
+    std::filesystem::create_directories(options.outputDir);
+
+    std::unique_ptr<Slide> pSlide = std::make_unique<Slide>(first);
+
+    Application app(options.width, options.height, options.fps, pSlide->m_Duration, options.backend);
+    BatchRenderer::Configure(app, options, first);
+    app.SetChunking(0, 0);
+    if (!app.Initialize(output, pSlide.get()))
+    {
+        std::cerr << "Failed to initialize application\n";
+        return false;
+    }
+
+    int lastRendered = first - 1;
+    if (app.RenderSlide())
+        lastRendered = first;
+    for (int n = first + 1; n <= last && lastRendered == n - 1; ++n)
+    {
+        std::cout << "\nSlide " << n << "\n";
+
+        // The renderer only holds on to the slide while it is current.
+        pSlide = std::make_unique<Slide>(n);
+        if (options.bDumpTimeline)
+            app.SetTimelineDump(options.outputDir + "/" + std::to_string(n) + "_timeline.csv");
+        if (!app.AppendSlide(pSlide.get()) || !app.RenderSlide())
+            break;
+
+        lastRendered = n;
+    }
+
+    // What was rendered is still finalized into a playable file, but the range did not complete.
+    if (!app.Finish())
+        return false;
+
+    if (lastRendered < last)
+    {
+        std::cerr << "\nVideo truncated after slide " << lastRendered << " of " << first << "-" << last
+            << ", saved to: " << output << "\n\n\n\n";
+        return false;
+    }
+
+    std::cout << "\nVideo saved to: " << output << "\n\n\n\n";
+    return true;
+}
+
+
+int main(int argc, char** argv)
 {
     std::cout << "=== VIDEO RENDERER ===\n\n";
-    
-    int n;
-    const uint16_t width = 3840;
-    const uint16_t height = 2160;
-    const uint8_t fps = 60;
 
+    if (argc == 2 && std::string(argv[1]) == "--test")
+        return CompositorTest::Run() ? 0 : 1;
+
+    BatchOptions options {};
+    options.width = 3840;
+    options.height = 2160;
+    options.fps = 60;
+    options.backend = RenderBackend::GPU;
+    options.textBackend = TextBackend::Direct2D;
+    options.outputFormat = OutputFormat::P010;
+
+    options.encoder.backend = EncoderBackend::Auto;
+    options.encoder.codec = "libx265";
+    options.encoder.preset = "medium";
+    options.encoder.crf = 18;
+    options.encoder.threads = 0;
+    options.encoder.frameRate = FrameRateMode::Constant;   // --vfr drops held frames instead
+    options.encoder.bRestoreCfr = false;
+    options.pipelineDepth = 3;
+    options.framesInFlight = 4;
+    options.chunkFrames = 0;            // > 0 encodes chunks of this many frames in parallel (software encoder)
+    options.chunkWorkers = 4;
+    options.bCompareChunked = false;    // also time the unchunked path for the speedup report (--compare)
+    options.bDumpTimeline = false;
+    options.bBenchmark = false;         // time the CPU compositor on each slide first (--benchmark)
+
+    if (argc > 1)
+    {
+        if (!BatchRenderer::ParseArguments(argc, argv, options))
+        {
+            BatchRenderer::PrintUsage();
+            return -1;
+        }
+
+        if (options.rangeFirst > 0)
+            return RenderRange(options.rangeFirst, options.rangeLast, options) ? 0 : 1;
+
+        return BatchRenderer(options).Run() ? 0 : 1;
+    }
+
+    const bool continuous = false;      // asks for a range and renders it into one render/A-B.mp4, as --continuous does
+
+    int n;
     do
     {
-        std::cout << "Enter slide number: ";
-        std::cin >> n;
+        int last = 0;
+        if (continuous)
+        {
+            std::cout << "Enter first and last slide number: ";
+            std::cin >> n >> last;
+        }
+        else
+        {
+            std::cout << "Enter slide number: ";
+            std::cin >> n;
+        }
 
         if (n <= 0)
             continue;
 
-        std::string output = "render/";
+        if (continuous)
+        {
+            if (!RenderRange(n, std::max(last, n), options))
+                return -1;
+
+            continue;
+        }
+
+        std::string output = options.outputDir + "/";
         output += std::to_string(n);
         output += ".mp4";
 
         Slide* pSlide = new Slide(n);
 
-        Application app(width, height, fps, pSlide->m_Duration);
+        Application app(options.width, options.height, options.fps, pSlide->m_Duration, options.backend);
+        BatchRenderer::Configure(app, options, n);
         if (!app.Initialize(output, pSlide))
         {
             std::cerr << "Failed to initialize application\n";
             return -1;
         }
 
-        app.Run();
+        if (!app.Run())
+        {
+            std::cerr << "Failed to render slide " << n << "\n";
+            return -1;
+        }
 
         std::cout << "\nVideo saved to: " << output << "\n\n\n\n";
 